@@ -24,8 +24,16 @@ def get_doc_classes():
         "LuaAPI",
         "LuaCoroutine",
         "LuaError",
+        "LuaFunction",
         "LuaTuple",
         "LuaCallableExtra",
+        "LuaBytecode",
+        "LuaChunk",
+        "LuaStatePool",
+        "LuaTask",
+        "LuaParallelGroup",
+        "LuaChannel",
+        "LuaScheduler",
     ]
 
 def get_doc_path():
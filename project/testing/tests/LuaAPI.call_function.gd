@@ -13,7 +13,7 @@ func _ready():
 	# testName and testDescription are for any needed context about the test.
 	testName = "LuaAPI.call_function"
 	testDescription = "
-Tests both luaAPI.call_Function and pulling the function as a Callable.
+Tests both luaAPI.call_Function and pulling the function as a LuaFunction.
 "
 
 func fail():
@@ -51,11 +51,15 @@ func _process(delta):
 		errors.append(testCallable)
 		return fail()
 
-	if not testCallable is Callable:
-		errors.append(LuaError.new_error("testCallable is not Callable but is '%d'" % typeof(testCallable), LuaError.ERR_TYPE))
+	if not testCallable is LuaFunction:
+		errors.append(LuaError.new_error("testCallable is not LuaFunction but is '%d'" % typeof(testCallable), LuaError.ERR_TYPE))
 		return fail()
 
-	var cret = testCallable.call([5])
+	if not lua.pull_variant("test") == testCallable:
+		errors.append(LuaError.new_error("pulling the same function twice did not return the same LuaFunction"))
+		return fail()
+
+	var cret = testCallable.invokev([5])
 	if cret is LuaError:
 		errors.append(cret)
 		return fail()
@@ -68,4 +72,9 @@ func _process(delta):
 		errors.append(LuaError.new_error("cret is not 10 but is '%d'" % cret))
 		return fail()
 
+	var vret = testCallable.invoke(5)
+	if not vret == 10:
+		errors.append(LuaError.new_error("vret is not 10 but is '%s'" % str(vret)))
+		return fail()
+
 	done = true
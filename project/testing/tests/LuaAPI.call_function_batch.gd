@@ -0,0 +1,57 @@
+extends UnitTest
+var lua: LuaAPI
+
+func _ready():
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._ready()
+	# id will determine the load order
+	id = 9935
+
+	lua = LuaAPI.new()
+	lua.bind_libraries(["base"])
+
+	# testName and testDescription are for any needed context about the test.
+	testName = "LuaAPI.call_function_batch()"
+	testDescription = "
+Calls a function over Array and packed array argument sets with call_function_batch and call_function_batch_packed.
+Checks the results are in order and that a failing call returns its error without stopping the others.
+"
+
+func fail():
+	status = false
+	done = true
+
+func _process(delta):
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._process(delta)
+
+	var err = lua.do_string("
+	function score(a, b)
+		if a == 0 then error('zero') end
+		return a * 10 + (b or 0)
+	end
+	")
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	var results = lua.call_function_batch("score", [[1, 2], [0, 1], 3])
+	if not results.size() == 3 or not results[0] == 12 or not results[2] == 30:
+		errors.append(LuaError.new_error("call_function_batch returned %s" % str(results)))
+		return fail()
+
+	if not results[1] is LuaError:
+		errors.append(LuaError.new_error("the failing call did not return an error"))
+		return fail()
+
+	results = lua.call_function_batch_packed("score", PackedFloat64Array([1.5, 2.0]))
+	if not results == [15.0, 20.0]:
+		errors.append(LuaError.new_error("call_function_batch_packed returned %s" % str(results)))
+		return fail()
+
+	# The stack must be balanced after a batch
+	if not lua.call_function("score", [4, 1]) == 41:
+		errors.append(LuaError.new_error("call_function failed after a batch"))
+		return fail()
+
+	done = true
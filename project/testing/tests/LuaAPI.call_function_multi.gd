@@ -0,0 +1,63 @@
+extends UnitTest
+var lua: LuaAPI
+
+func _ready():
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._ready()
+	# id will determine the load order
+	id = 9932
+
+	lua = LuaAPI.new()
+	lua.bind_libraries(["base"])
+
+	# testName and testDescription are for any needed context about the test.
+	testName = "LuaAPI.call_function_tuple()"
+	testDescription = "
+Calls a function returning 3 values with call_function_tuple, call_function_into and LuaFunction.invokev_tuple.
+Checks every value comes back in order and that no values gives an empty result.
+"
+
+func fail():
+	status = false
+	done = true
+
+func _process(delta):
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._process(delta)
+
+	var err = lua.do_string("
+	function decide(hp)
+		return 'attack', 'goblin', hp * 2
+	end
+	function nothing() end
+	")
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	var tuple = lua.call_function_tuple("decide", [5])
+	if not tuple is LuaTuple or not tuple.to_array() == ["attack", "goblin", 10]:
+		errors.append(LuaError.new_error("call_function_tuple returned %s" % str(tuple)))
+		return fail()
+
+	var results = ["stale", "values", "here", "too"]
+	err = lua.call_function_into("decide", [2], results)
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+	if not results == ["attack", "goblin", 4]:
+		errors.append(LuaError.new_error("call_function_into wrote %s" % str(results)))
+		return fail()
+
+	err = lua.call_function_into("nothing", [], results)
+	if err is LuaError or not results.is_empty():
+		errors.append(LuaError.new_error("a function returning nothing left %s" % str(results)))
+		return fail()
+
+	var decide = lua.pull_variant("decide")
+	tuple = decide.invokev_tuple([1])
+	if not tuple is LuaTuple or not tuple.size() == 3 or not tuple.get_value(2) == 2:
+		errors.append(LuaError.new_error("invokev_tuple returned %s" % str(tuple)))
+		return fail()
+
+	done = true
@@ -0,0 +1,77 @@
+extends UnitTest
+var lua: LuaAPI
+var sibling: LuaAPI
+
+func _ready():
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._ready()
+	# id will determine the load order
+	id = 9945
+
+	lua = LuaAPI.new()
+	sibling = LuaAPI.new()
+
+	# testName and testDescription are for any needed context about the test.
+	testName = "LuaAPI.do_chunk"
+	testDescription = "
+Compiles a chunk once and runs it repeatedly, in its own state and in a sibling state.
+"
+
+func fail():
+	status = false
+	done = true
+
+func _process(delta):
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._process(delta)
+
+	var chunk = lua.compile_string("counter = (counter or 0) + 1")
+	if chunk is LuaError:
+		errors.append(chunk)
+		return fail()
+
+	if not chunk is LuaChunk:
+		errors.append(LuaError.new_error("compile_string did not return a LuaChunk", LuaError.ERR_TYPE))
+		return fail()
+
+	# compiling must not run the chunk
+	if not lua.pull_variant("counter") == null:
+		errors.append(LuaError.new_error("compile_string ran the chunk"))
+		return fail()
+
+	for i in range(3):
+		var err = lua.do_chunk(chunk)
+		if err is LuaError:
+			errors.append(err)
+			return fail()
+
+	if not lua.pull_variant("counter") == 3:
+		errors.append(LuaError.new_error("counter is not 3 but is '%s'" % str(lua.pull_variant("counter"))))
+		return fail()
+
+	var err = sibling.do_chunk(chunk)
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	# the sibling runs against its own globals
+	if not sibling.pull_variant("counter") == 1:
+		errors.append(LuaError.new_error("sibling counter is not 1 but is '%s'" % str(sibling.pull_variant("counter"))))
+		return fail()
+
+	var fileChunk = lua.compile_file("res://testing/luasrc/LuaAPI/do_file.lua")
+	if not fileChunk is LuaChunk:
+		errors.append(fileChunk if fileChunk is LuaError else LuaError.new_error("compile_file did not return a LuaChunk"))
+		return fail()
+
+	err = sibling.do_chunk(fileChunk)
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	var broken = lua.compile_string("function (")
+	if not broken is LuaError or not broken.type == LuaError.ERR_SYNTAX:
+		errors.append(LuaError.new_error("compiling invalid code did not return a syntax error"))
+		return fail()
+
+	done = true
@@ -0,0 +1,79 @@
+extends UnitTest
+
+const FRAMES = 30
+
+func _ready():
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._ready()
+	# id will determine the load order
+	id = 9750
+
+	# testName and testDescription are for any needed context about the test.
+	testName = "General.allocator_bench"
+	testDescription = "
+Benchmarks the system and pool allocators on an allocation heavy script.
+Prints the mean and standard deviation of the time per frame, and the peak and reserved bytes of each state.
+"
+
+func fail():
+	status = false
+	done = true
+
+# Runs the script FRAMES times on a state using the given allocator, returns false on error
+func bench(allocator: LuaAPI.AllocatorType, label: String) -> bool:
+	LuaAPI.set_default_allocator(allocator)
+	var lua = LuaAPI.new()
+	LuaAPI.set_default_allocator(LuaAPI.ALLOCATOR_SYSTEM)
+	lua.bind_libraries(["base", "table", "string"])
+
+	if not lua.get_allocator() == allocator:
+		errors.append(LuaError.new_error("%s state was created with allocator %d" % [label, lua.get_allocator()]))
+		return false
+
+	var err = lua.do_string("
+	function frame()
+		local objects = {}
+		for i = 1, 20000 do
+			objects[i] = { pos = Vector2(i, i), name = 'obj' .. i, tag = function() return i end }
+		end
+		return #objects
+	end
+	")
+	if err is LuaError:
+		errors.append(err)
+		return false
+
+	var times = []
+	for i in range(FRAMES):
+		var start = Time.get_ticks_usec()
+		var ret = lua.call_function("frame", [])
+		times.append(Time.get_ticks_usec() - start)
+		if ret is LuaError:
+			errors.append(ret)
+			return false
+
+	var mean = 0.0
+	for t in times:
+		mean += t
+	mean /= FRAMES
+
+	var variance = 0.0
+	for t in times:
+		variance += (t - mean) * (t - mean)
+	variance /= FRAMES
+
+	var stats = lua.get_memory_stats()
+	print("%s: %.0f us/frame, stddev %.0f us, peak %d bytes, reserved %d bytes" % [label, mean, sqrt(variance), stats["peak"], stats["reserved"]])
+	return true
+
+func _process(delta):
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._process(delta)
+
+	if not bench(LuaAPI.ALLOCATOR_SYSTEM, "system"):
+		return fail()
+
+	if not bench(LuaAPI.ALLOCATOR_POOL, "pool"):
+		return fail()
+
+	done = true
@@ -0,0 +1,76 @@
+extends UnitTest
+var lua: LuaAPI
+var task: LuaTask
+var completed = false
+var completedResult
+
+func _ready():
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._ready()
+	# id will determine the load order
+	id = 9710
+
+	lua = LuaAPI.new()
+	var err = lua.do_string("
+	function sum(n)
+		local total = 0
+		for i = 1, n do total = total + i end
+		return total
+	end
+	")
+	if err is LuaError:
+		errors.append(err)
+		fail()
+		return
+
+	task = lua.call_function_async("sum", [1000000])
+	task.completed.connect(_on_completed)
+
+	# testName and testDescription are for any needed context about the test.
+	testName = "General.async"
+	testDescription = "
+Runs a lua function on the WorkerThreadPool with call_function_async.
+Checks the result through is_done/get_result and the completed signal, and that do_string_async returns errors.
+Drops a LuaFunction while a task runs, its destructor must wait for the state.
+"
+
+func _on_completed(result):
+	completed = true
+	completedResult = result
+
+func fail():
+	status = false
+	done = true
+
+func _process(delta):
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._process(delta)
+
+	if done or not task.is_done() or not completed:
+		return
+
+	if not task.get_result() == 500000500000:
+		errors.append(LuaError.new_error("get_result is %s instead of 500000500000" % str(task.get_result())))
+		return fail()
+
+	if not completedResult == task.get_result():
+		errors.append(LuaError.new_error("completed got %s" % str(completedResult)))
+		return fail()
+
+	var err = lua.do_string_async("error('async error')").wait()
+	if not err is LuaError:
+		errors.append(LuaError.new_error("do_string_async did not return the error"))
+		return fail()
+
+	var sumFunction = lua.pull_variant("sum")
+	var running = lua.call_function_async("sum", [1000000])
+	sumFunction = null
+	if not running.wait() == 500000500000:
+		errors.append(LuaError.new_error("the task failed while a LuaFunction was freed"))
+		return fail()
+
+	if not lua.call_function("sum", [3]) == 6:
+		errors.append(LuaError.new_error("the state was not usable after the tasks"))
+		return fail()
+
+	done = true
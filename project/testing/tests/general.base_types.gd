@@ -26,10 +26,10 @@ func _process(delta):
 
 	var err = lua.do_string("
 	vec2 = Vector2(1.5, 1.0)
-	vec2Floor = vec2.floor()
+	vec2Floor = vec2:floor()
 
 	vec3 = Vector3(1.5, 1.0, 1.0)
-	vec3Floor = vec3.floor()
+	vec3Floor = vec3:floor()
 	")
 	if err is LuaError:
 		errors.append(err)
@@ -0,0 +1,69 @@
+extends UnitTest
+
+func _ready():
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._ready()
+	# id will determine the load order
+	id = 9740
+
+	# testName and testDescription are for any needed context about the test.
+	testName = "General.bytecode"
+	testDescription = "
+Tests compiling code into a LuaBytecode resource, saving and loading it, and compile errors.
+"
+
+func fail():
+	status = false
+	done = true
+
+func _process(delta):
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._process(delta)
+
+	var code = "
+	local function fib(n)
+		if n < 2 then return n end
+		return fib(n - 1) + fib(n - 2)
+	end
+	result = fib(15)
+	"
+
+	var compiled = LuaBytecode.compile(code, "=bytecode_test")
+	if compiled is LuaError:
+		errors.append(compiled)
+		return fail()
+
+	if not compiled is LuaBytecode:
+		errors.append(LuaError.new_error("compile did not return a LuaBytecode", LuaError.ERR_TYPE))
+		return fail()
+
+	if not compiled.is_compatible() or not compiled.vm == LuaBytecode.get_vm_name():
+		errors.append(LuaError.new_error("bytecode was tagged with vm '%s' instead of '%s'" % [compiled.vm, LuaBytecode.get_vm_name()]))
+		return fail()
+
+	if compiled.bytecode.is_empty() or not compiled.source_hash == code.md5_text():
+		errors.append(LuaError.new_error("bytecode or source hash is missing"))
+		return fail()
+
+	var stripped = LuaBytecode.compile(code, "=bytecode_test", true)
+	if not stripped is LuaBytecode or stripped.bytecode.size() > compiled.bytecode.size():
+		errors.append(LuaError.new_error("stripped bytecode is larger than the unstripped one"))
+		return fail()
+
+	var path = "user://bytecode_test.res"
+	if not ResourceSaver.save(compiled, path) == OK:
+		errors.append(LuaError.new_error("failed to save the bytecode"))
+		return fail()
+
+	var loaded = ResourceLoader.load(path, "", ResourceLoader.CACHE_MODE_IGNORE)
+	if not loaded is LuaBytecode or not loaded.bytecode == compiled.bytecode or not loaded.vm == compiled.vm:
+		errors.append(LuaError.new_error("saved bytecode did not load back the same"))
+		return fail()
+	DirAccess.remove_absolute(path)
+
+	var broken = LuaBytecode.compile("function (", "=broken")
+	if not broken is LuaError or not broken.type == LuaError.ERR_SYNTAX:
+		errors.append(LuaError.new_error("compiling invalid code did not return a syntax error"))
+		return fail()
+
+	done = true
@@ -0,0 +1,78 @@
+extends UnitTest
+var producer: LuaAPI
+var consumer: LuaAPI
+var channel: LuaChannel
+
+func _ready():
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._ready()
+	# id will determine the load order
+	id = 9690
+
+	producer = LuaAPI.new()
+	consumer = LuaAPI.new()
+	producer.bind_libraries(["base"])
+	consumer.bind_libraries(["base"])
+
+	channel = LuaChannel.new()
+	channel.setup(4)
+	producer.push_variant("jobs", channel)
+	consumer.push_variant("jobs", channel)
+
+	# testName and testDescription are for any needed context about the test.
+	testName = "General.channel"
+	testDescription = "
+Sends values from one LuaAPI to another through a LuaChannel bound into both.
+Checks tables round trip, that a full channel refuses values, and that GDScript can send and receive on the same channel.
+"
+
+func fail():
+	status = false
+	done = true
+
+func _process(delta):
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._process(delta)
+
+	var err = producer.do_string("
+	assert(jobs:send({ id = 1, path = { 1, 2, 3 }, name = 'walk' }))
+	assert(jobs:send(nil))
+	assert(jobs:send(2.5))
+	assert(jobs:send('last'))
+	assert(not jobs:send('full'), 'send succeeded on a full channel')
+	")
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	err = consumer.do_string("
+	local ok, job = jobs:try_recv()
+	assert(ok and job.id == 1 and job.name == 'walk', 'table did not round trip')
+	assert(#job.path == 3 and job.path[3] == 3, 'array part did not round trip')
+	ok, job = jobs:try_recv()
+	assert(ok and job == nil, 'nil did not round trip')
+	ok, job = jobs:try_recv()
+	assert(ok and job == 2.5, 'number did not round trip')
+	")
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	if not channel.try_recv() == "last":
+		errors.append(LuaError.new_error("GDScript did not receive the last value"))
+		return fail()
+
+	if not channel.send({"score": 3, "targets": [1, 2]}):
+		errors.append(LuaError.new_error("GDScript send failed"))
+		return fail()
+
+	err = consumer.do_string("
+	local ok, msg = jobs:try_recv()
+	assert(ok and msg.score == 3 and msg.targets[2] == 2, 'GDScript value did not round trip')
+	assert(not jobs:try_recv(), 'try_recv succeeded on an empty channel')
+	")
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	done = true
@@ -0,0 +1,80 @@
+extends UnitTest
+var lua: LuaAPI
+
+func _ready():
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._ready()
+	# id will determine the load order
+	id = 9770
+
+	lua = LuaAPI.new()
+	lua.bind_libraries(["base"])
+
+	# testName and testDescription are for any needed context about the test.
+	testName = "general.execution_limit"
+	testDescription = "
+Tests that set_execution_limit stops runaway scripts with ERR_EXECUTION_LIMIT and that the budget is restarted on the next call.
+"
+
+func fail():
+	status = false
+	done = true
+
+func _process(delta):
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._process(delta)
+
+	lua.set_execution_limit(100000, 0)
+	var err = lua.do_string("while true do end")
+	if not err is LuaError:
+		errors.append(LuaError.new_error("infinite loop was not stopped by the instruction limit"))
+		return fail()
+
+	if not err.type == LuaError.ERR_EXECUTION_LIMIT:
+		errors.append(err)
+		return fail()
+
+	# pcall inside Lua must not be able to swallow the limit
+	err = lua.do_string("while true do pcall(function() while true do end end) end")
+	if not err is LuaError or not err.type == LuaError.ERR_EXECUTION_LIMIT:
+		errors.append(LuaError.new_error("pcall recovered from the execution limit"))
+		return fail()
+
+	# a new call gets a fresh budget
+	err = lua.do_string("
+	function count(n)
+		local total = 0
+		for i = 1, n do total = total + i end
+		return total
+	end
+	")
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	var ret = lua.call_function("count", [100])
+	if not ret is float or not ret == 5050:
+		errors.append(LuaError.new_error("count(100) returned '%s'" % str(ret)))
+		return fail()
+
+	lua.set_execution_limit(0, 10000)
+	err = lua.do_string("while true do end")
+	if not err is LuaError or not err.type == LuaError.ERR_EXECUTION_LIMIT:
+		errors.append(LuaError.new_error("infinite loop was not stopped by the time limit"))
+		return fail()
+
+	lua.set_execution_limit(0, 0)
+	ret = lua.call_function("count", [100000])
+	if ret is LuaError:
+		errors.append(ret)
+		return fail()
+
+	var co = lua.new_coroutine()
+	co.set_execution_limit(100000, 0)
+	co.load_string("while true do end")
+	ret = co.resume([])
+	if not ret is LuaError or not ret.type == LuaError.ERR_EXECUTION_LIMIT:
+		errors.append(LuaError.new_error("coroutine was not stopped by the instruction limit"))
+		return fail()
+
+	done = true
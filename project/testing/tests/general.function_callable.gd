@@ -0,0 +1,82 @@
+extends UnitTest
+var lua: LuaAPI
+
+class Emitter:
+	signal fired(value)
+
+	func apply(callback: Callable, value):
+		return callback.call(value)
+
+class Holder:
+	var handle
+
+func _ready():
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._ready()
+	# id will determine the load order
+	id = 9965
+
+	lua = LuaAPI.new()
+	lua.permissive = true
+
+	# testName and testDescription are for any needed context about the test.
+	testName = "General.function_callable"
+	testDescription = "
+Tests lua functions passed to parameters typed Callable, connecting them to signals
+and calling a GDScript method taking a Callable.
+Also checks that an object holding a LuaFunction does not keep its LuaAPI alive.
+"
+
+func fail():
+	status = false
+	done = true
+
+func _process(delta):
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._process(delta)
+
+	var emitter = Emitter.new()
+	var err = lua.push_variant("emitter", emitter)
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	err = lua.do_string("
+	received = 0
+	emitter:connect('fired', function(value) received = received + value end)
+	emitter.fired:connect(function(value) received = received + value * 10 end)
+	applied = emitter:apply(function(value) return value * 2 end, 21)
+	")
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	emitter.fired.emit(1)
+	if not lua.pull_variant("received") == 11:
+		errors.append(LuaError.new_error("received is not 11 but is '%s'" % str(lua.pull_variant("received"))))
+		return fail()
+
+	if not lua.pull_variant("applied") == 42:
+		errors.append(LuaError.new_error("applied is not 42 but is '%s'" % str(lua.pull_variant("applied"))))
+		return fail()
+
+	# The handle only holds the LuaAPI's id, so storing it in an object pushed to lua forms no cycle
+	var other = LuaAPI.new()
+	var holder = Holder.new()
+	other.push_variant("holder", holder)
+	err = other.do_string("holder.handle = function() end")
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	var otherRef = weakref(other)
+	other = null
+	if otherRef.get_ref() != null:
+		errors.append(LuaError.new_error("the LuaAPI was kept alive by a LuaFunction stored in a pushed object"))
+		return fail()
+
+	if not holder.handle.invoke() is LuaError:
+		errors.append(LuaError.new_error("invoking a LuaFunction of a freed LuaAPI did not return a LuaError"))
+		return fail()
+
+	done = true
@@ -0,0 +1,80 @@
+extends UnitTest
+var lua: LuaAPI
+
+var sizes = [10, 100, 1000, 10000, 100000, 1000000]
+# Results are saved per VM, so running the bench on the Lua 5.4, Lua 5.1 and LuaJIT builds fills in one table
+const RESULTS_PATH = "user://marshalling_bench.cfg"
+
+func _ready():
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._ready()
+	# id will determine the load order
+	id = 9790
+
+	lua = LuaAPI.new()
+	lua.permissive = true
+
+	# testName and testDescription are for any needed context about the test.
+	testName = "General.marshalling_bench"
+	testDescription = "
+Benchmarks pushing and pulling Arrays and Dictionaries from 10 to 1M elements.
+The time per element is printed for each size, it should stay flat as the size grows.
+Results are saved under the VM's name and the results of every VM run so far are printed.
+"
+
+func fail():
+	status = false
+	done = true
+
+# Returns the round trip time per element in nanoseconds
+func round_trip(value, size: int) -> float:
+	var start = Time.get_ticks_usec()
+	var err = lua.push_variant("value", value)
+	if err is LuaError:
+		errors.append(err)
+		return -1
+
+	var pulled = lua.pull_variant("value")
+	var elapsed = Time.get_ticks_usec() - start
+	if not pulled.size() == size:
+		errors.append(LuaError.new_error("pulled size is not %d but is %d" % [size, pulled.size()]))
+		return -1
+
+	return elapsed * 1000.0 / size
+
+func _process(delta):
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._process(delta)
+
+	var results = ConfigFile.new()
+	results.load(RESULTS_PATH)
+	var vm = LuaBytecode.get_vm_name()
+
+	for size in sizes:
+		var array = []
+		array.resize(size)
+		var dict = {}
+		for i in size:
+			array[i] = i
+			dict["key%d" % i] = i
+
+		var arrayCost = round_trip(array, size)
+		var dictCost = round_trip(dict, size)
+		if arrayCost < 0 or dictCost < 0:
+			return fail()
+
+		results.set_value(vm, "array_%d" % size, arrayCost)
+		results.set_value(vm, "dictionary_%d" % size, dictCost)
+
+	# Free the last table before the next bench runs
+	lua.push_variant("value", null)
+	results.save(RESULTS_PATH)
+
+	for section in results.get_sections():
+		print("marshalling on %s:" % section)
+		for size in sizes:
+			if not results.has_section_key(section, "array_%d" % size):
+				continue
+			print("  %d elements: Array %.1f ns/element, Dictionary %.1f ns/element" % [size, results.get_value(section, "array_%d" % size), results.get_value(section, "dictionary_%d" % size)])
+
+	done = true
@@ -0,0 +1,121 @@
+extends UnitTest
+var lua: LuaAPI
+
+func _ready():
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._ready()
+	# id will determine the load order
+	id = 9760
+
+	lua = LuaAPI.new()
+	lua.bind_libraries(["base", "table", "string"])
+
+	# testName and testDescription are for any needed context about the test.
+	testName = "general.memory_limit"
+	testDescription = "
+Tests the memory statistics and that memory_limit fails allocations with ERR_MEMORY without breaking the state.
+Checks that a call passing a large Dictionary at the limit succeeds, since pushes from Godot are not capped.
+Checks the same for push_variant called from a callback of a protected call.
+"
+
+func fail():
+	status = false
+	done = true
+
+func _process(delta):
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._process(delta)
+
+	var stats = lua.get_memory_stats()
+	if not stats["current"] > 0 or not stats["peak"] >= stats["current"]:
+		errors.append(LuaError.new_error("unexpected memory stats '%s'" % str(stats)))
+		return fail()
+
+	var histogram: PackedInt64Array = stats["histogram"]
+	var total = 0
+	for count in histogram:
+		total += count
+	if not total == stats["allocations"]:
+		errors.append(LuaError.new_error("histogram counts %d allocations but stats report %d" % [total, stats["allocations"]]))
+		return fail()
+
+	lua.memory_limit = stats["current"] + 1024 * 1024
+	var err = lua.do_string("
+	local t = {}
+	for i = 1, 10000000 do
+		t[i] = string.rep('x', 64) .. i
+	end
+	")
+	if not err is LuaError or not err.type == LuaError.ERR_MEMORY:
+		errors.append(LuaError.new_error("allocating past memory_limit did not fail with ERR_MEMORY"))
+		return fail()
+
+	if not lua.get_memory_stats()["failed"] > 0:
+		errors.append(LuaError.new_error("failed allocations were not counted"))
+		return fail()
+
+	# the table is garbage now, the state must keep working under the limit
+	lua.configure_gc(LuaAPI.GC_COLLECT, 0)
+	err = lua.do_string("result = #string.rep('y', 1000)")
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	if not lua.pull_variant("result") == 1000:
+		errors.append(LuaError.new_error("state is broken after a memory error"))
+		return fail()
+
+	if not lua.get_memory_stats()["peak"] <= lua.memory_limit:
+		errors.append(LuaError.new_error("peak went past memory_limit"))
+		return fail()
+
+	err = lua.do_string("function count(t) local n = 0 for _ in pairs(t) do n = n + 1 end return n end")
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	# arguments pushed from Godot are not capped, a call at the limit must not make lua panic
+	var big = {}
+	for i in range(100000):
+		big[i] = "value %d" % i
+	lua.configure_gc(LuaAPI.GC_COLLECT, 0)
+	# the Dictionary alone takes megabytes, the headroom is for the call itself
+	lua.memory_limit = lua.get_memory_stats()["current"] + 64 * 1024
+	var result = lua.call_function("count", [big])
+	if result is LuaError:
+		errors.append(result)
+		return fail()
+
+	if not result == big.size():
+		errors.append(LuaError.new_error("expected %d entries, counted %s" % [big.size(), str(result)]))
+		return fail()
+
+	# entry points reached from a callback run unprotected, push_variant there must not make lua panic either
+	err = lua.push_variant("push_big", func(): return lua.push_variant("pushed", big))
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	lua.configure_gc(LuaAPI.GC_COLLECT, 0)
+	lua.memory_limit = lua.get_memory_stats()["current"] + 64 * 1024
+	err = lua.do_string("assert(push_big() == nil)")
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	var pushed = lua.pull_variant("pushed")
+	if not pushed is Dictionary or not pushed.size() == big.size():
+		errors.append(LuaError.new_error("the Dictionary pushed from the callback was not stored: '%s'" % str(pushed).left(64)))
+		return fail()
+
+	lua.push_variant("pushed", null)
+	lua.configure_gc(LuaAPI.GC_COLLECT, 0)
+	lua.memory_limit = lua.get_memory_stats()["current"] + 64 * 1024
+
+	# the limit still applies to the code the call runs
+	err = lua.do_string("local s = string.rep('z', 1000000)")
+	if not err is LuaError or not err.type == LuaError.ERR_MEMORY:
+		errors.append(LuaError.new_error("allocating past memory_limit after a large call did not fail with ERR_MEMORY"))
+		return fail()
+
+	done = true
@@ -0,0 +1,101 @@
+extends UnitTest
+var lua: LuaAPI
+
+const ITERATIONS = 100000
+# Each case is timed this many times and the fastest run is kept, the others include scheduler and GC noise
+const RUNS = 5
+# The previous run's results per VM, printed next to this run's to compare two builds
+const RESULTS_PATH = "user://metamethod_bench.cfg"
+
+class BenchObject:
+	func method():
+		return 1
+
+func _ready():
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._ready()
+	# id will determine the load order
+	id = 9780
+
+	lua = LuaAPI.new()
+	lua.permissive = true
+	lua.bind_libraries(["base"])
+
+	# testName and testDescription are for any needed context about the test.
+	testName = "General.metamethod_bench"
+	testDescription = "
+Benchmarks the per call cost of v.x, v + w, obj:method() and calling a pushed Callable from lua.
+The cost of an empty loop is subtracted and the fastest of several runs is printed as the time per call.
+Results are saved per VM, the next run prints them as the baseline. Run it on the old build, then on the new one for a before/after.
+"
+
+func fail():
+	status = false
+	done = true
+
+# Returns the fastest time per iteration of body in nanoseconds
+func time_loop(body: String) -> float:
+	var fastest = INF
+	for run in RUNS:
+		var start = Time.get_ticks_usec()
+		var err = lua.do_string("for i = 1, %d do %s end" % [ITERATIONS, body])
+		var elapsed = Time.get_ticks_usec() - start
+		if err is LuaError:
+			errors.append(err)
+			return -1
+
+		fastest = min(fastest, elapsed * 1000.0 / ITERATIONS)
+	return fastest
+
+# Names the VM from lua, the bench also has to run on old builds which lack LuaBytecode.get_vm_name()
+func vm_name() -> String:
+	lua.do_string("vm = _VERSION if vm == 'Lua 5.1' and loadstring('goto a ::a::') then vm = 'LuaJIT' end")
+	return str(lua.pull_variant("vm"))
+
+func _process(delta):
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._process(delta)
+
+	var obj = BenchObject.new()
+	var err = lua.push_variant("obj", obj)
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	err = lua.push_variant("callable", Callable(obj, "method"))
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	err = lua.do_string("v = Vector2(1, 2) w = Vector2(3, 4) sink = nil")
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	var results = ConfigFile.new()
+	results.load(RESULTS_PATH)
+	var vm = vm_name()
+
+	var baseline = time_loop("sink = i")
+	var cases = {
+		"v.x": "sink = v.x",
+		"v + w": "sink = v + w",
+		"obj:method()": "sink = obj:method()",
+		"callable()": "sink = callable()",
+	}
+
+	for name in cases:
+		var cost = time_loop(cases[name])
+		if cost < 0 or baseline < 0:
+			return fail()
+
+		cost = max(cost - baseline, 0.0)
+		if results.has_section_key(vm, name):
+			var before = results.get_value(vm, name)
+			print("%s on %s: %.1f ns/call, previous run %.1f ns/call" % [name, vm, cost, before])
+		else:
+			print("%s on %s: %.1f ns/call" % [name, vm, cost])
+		results.set_value(vm, name, cost)
+
+	results.save(RESULTS_PATH)
+	done = true
@@ -0,0 +1,86 @@
+extends UnitTest
+var lua: LuaAPI
+
+class FieldObject:
+	var shown = "shown"
+	var secret = "secret"
+
+	func get_shown():
+		return shown
+
+	func lua_fields():
+		return ["secret"]
+
+class GuardedObject:
+	func get_shown():
+		return "guarded"
+
+	func __index(_api, _key):
+		return null
+
+func _ready():
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._ready()
+	# id will determine the load order
+	id = 9799
+
+	lua = LuaAPI.new()
+	lua.bind_libraries(["base", "string"])
+	lua.permissive = true
+
+	# testName and testDescription are for any needed context about the test.
+	testName = "General.object_fields"
+	testDescription = "
+Tests lua_fields as a blacklist in permissive mode and a whitelist otherwise.
+Field lookups are cached per class, so this also checks the cache is cleared when permissive changes.
+Checks shared method closures refuse receivers they were not taken from and objects overriding __index.
+"
+
+func fail():
+	status = false
+	done = true
+
+func check(code: String, expected) -> bool:
+	var err = lua.do_string("result = " + code)
+	if err is LuaError:
+		errors.append(err)
+		return false
+
+	var result = lua.pull_variant("result")
+	if not result == expected:
+		errors.append(LuaError.new_error("%s is not %s but is %s" % [code, str(expected), str(result)]))
+		return false
+	return true
+
+func _process(delta):
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._process(delta)
+
+	var err = lua.push_variant("obj", FieldObject.new())
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	# Access twice so the second lookup is served from the cache
+	for i in 2:
+		if not check("obj.shown", "shown") or not check("obj:get_shown()", "shown") or not check("obj.secret", null):
+			return fail()
+
+	err = lua.push_variant("guarded", GuardedObject.new())
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	# calling with '.' passes the argument as the receiver
+	if not check("select(2, pcall(obj.get_shown, 5)):find(\"use ':'\", 1, true) ~= nil", true):
+		return fail()
+
+	# a closure taken from obj must not call methods guarded's __index hides
+	if not check("select(2, pcall(obj.get_shown, guarded)):find('not accessible', 1, true) ~= nil", true):
+		return fail()
+
+	lua.permissive = false
+	if not check("obj.shown", null) or not check("obj.secret", "secret"):
+		return fail()
+
+	done = true
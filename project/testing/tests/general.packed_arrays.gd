@@ -0,0 +1,122 @@
+extends UnitTest
+var lua: LuaAPI
+
+func _ready():
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._ready()
+	# id will determine the load order
+	id = 9810
+
+	lua = LuaAPI.new()
+	lua.permissive = true
+	lua.bind_libraries(["base"])
+	lua.memory_limit = 16 * 1024 * 1024
+
+	# testName and testDescription are for any needed context about the test.
+	testName = "General.packed_arrays"
+	testDescription = "
+Tests packed arrays being passed to lua as views over their buffer.
+Lua reads, writes and appends to a pushed PackedFloat32Array,
+and creates a PackedInt32Array which is pulled back to GDScript.
+Bad writes, foreign receivers and oversized arrays raise errors.
+"
+
+func fail():
+	status = false
+	done = true
+
+func _process(delta):
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._process(delta)
+
+	var positions = PackedFloat32Array([1.0, 2.0, 3.0])
+	var err = lua.push_variant("positions", positions)
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	err = lua.do_string("
+	size = #positions
+	second = positions[2]
+	positions[2] = 5
+	positions[#positions + 1] = 7
+	outOfRange = positions[10]
+
+	made = PackedInt32Array({1, 2, 3})
+	made[1] = 10
+
+	-- Bad writes raise instead of storing 0
+	badString = pcall(function() made[1] = \"abc\" end)
+	badTable = pcall(function() made[1] = {} end)
+
+	-- The metamethods are reachable through getmetatable and must reject other receivers
+	local mt = getmetatable(PackedInt32Array(1))
+	foreignLen = pcall(mt.__len, Vector2(1, 2))
+	foreignGC = pcall(mt.__gc, Vector2(1, 2))
+	local collected = PackedInt32Array(1)
+	firstGC = pcall(mt.__gc, collected)
+	secondGC = pcall(mt.__gc, collected)
+	collected = nil
+	collectgarbage()
+
+	negative = pcall(PackedFloat64Array, -1)
+	overLimit = pcall(PackedFloat64Array, 2^40)
+	")
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	var rejected = {
+		"badString": false,
+		"badTable": false,
+		"foreignLen": false,
+		"foreignGC": false,
+		"firstGC": true,
+		"secondGC": false,
+		"negative": false,
+		"overLimit": false,
+	}
+	for key in rejected:
+		var value = lua.pull_variant(key)
+		if not value == rejected[key]:
+			errors.append(LuaError.new_error("%s is not %s but is %s" % [key, str(rejected[key]), str(value)]))
+			return fail()
+
+	var size = lua.pull_variant("size")
+	if not size == 3:
+		errors.append(LuaError.new_error("size is not 3 but is '%d'" % size))
+		return fail()
+
+	var second = lua.pull_variant("second")
+	if not second == 2:
+		errors.append(LuaError.new_error("second is not 2 but is '%f'" % second))
+		return fail()
+
+	if not lua.pull_variant("outOfRange") == null:
+		errors.append(LuaError.new_error("outOfRange is not null"))
+		return fail()
+
+	var pulled = lua.pull_variant("positions")
+	if not pulled is PackedFloat32Array:
+		errors.append(LuaError.new_error("positions is not PackedFloat32Array but is '%d'" % typeof(pulled), LuaError.ERR_TYPE))
+		return fail()
+
+	if not pulled == PackedFloat32Array([1.0, 5.0, 3.0, 7.0]):
+		errors.append(LuaError.new_error("positions is not [1, 5, 3, 7] but is '%s'" % str(pulled)))
+		return fail()
+
+	# Packed arrays are passed by value, lua's writes must not change ours.
+	if not positions == PackedFloat32Array([1.0, 2.0, 3.0]):
+		errors.append(LuaError.new_error("the original array was modified: '%s'" % str(positions)))
+		return fail()
+
+	var made = lua.pull_variant("made")
+	if not made is PackedInt32Array:
+		errors.append(LuaError.new_error("made is not PackedInt32Array but is '%d'" % typeof(made), LuaError.ERR_TYPE))
+		return fail()
+
+	if not made == PackedInt32Array([10, 2, 3]):
+		errors.append(LuaError.new_error("made is not [10, 2, 3] but is '%s'" % str(made)))
+		return fail()
+
+	done = true
@@ -0,0 +1,63 @@
+extends UnitTest
+var group: LuaParallelGroup
+
+func _ready():
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._ready()
+	# id will determine the load order
+	id = 9700
+
+	group = LuaParallelGroup.new()
+	group.setup(4, ["base", "math"])
+
+	# testName and testDescription are for any needed context about the test.
+	testName = "General.parallel_group"
+	testDescription = "
+Loads a function into every state of a LuaParallelGroup and calls it over Array and packed array argument sets.
+Checks the results come back in input order and that failed calls return their error in place.
+"
+
+func fail():
+	status = false
+	done = true
+
+func _process(delta):
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._process(delta)
+
+	var err = group.do_string("
+	function cost(x, y)
+		if x < 0 then error('negative') end
+		return x * 2 + (y or 0)
+	end
+	")
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	var argSets = []
+	for i in range(1000):
+		argSets.append([i, 1])
+	argSets[500] = [-1, 1]
+
+	var results = group.call_function("cost", argSets)
+	if not results.size() == 1000:
+		errors.append(LuaError.new_error("got %d results instead of 1000" % results.size()))
+		return fail()
+
+	for i in range(1000):
+		if i == 500:
+			if not results[i] is LuaError:
+				errors.append(LuaError.new_error("the failed call did not return an error"))
+				return fail()
+		elif not results[i] == i * 2 + 1:
+			errors.append(LuaError.new_error("result %d is %s" % [i, str(results[i])]))
+			return fail()
+
+	var packed = PackedInt64Array([1, 2, 3])
+	results = group.call_function("cost", packed)
+	if not results == [2, 4, 6]:
+		errors.append(LuaError.new_error("packed results are %s" % str(results)))
+		return fail()
+
+	done = true
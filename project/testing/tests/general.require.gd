@@ -0,0 +1,94 @@
+extends UnitTest
+var lua: LuaAPI
+var sibling: LuaAPI
+
+const MODULE_DIR = "user://require_test"
+
+func _ready():
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._ready()
+	# id will determine the load order
+	id = 9730
+
+	# testName and testDescription are for any needed context about the test.
+	testName = "General.require"
+	testDescription = "
+Tests require through the native searcher, for dotted names, init.lua packages and missing modules, from two states sharing the module cache.
+Checks a module edited on disk is compiled again for new states.
+"
+
+func fail():
+	status = false
+	done = true
+
+func write_file(path: String, code: String) -> bool:
+	var file = FileAccess.open(path, FileAccess.WRITE)
+	if file == null:
+		errors.append(LuaError.new_error("could not write '%s'" % path, LuaError.ERR_FILE))
+		return false
+	file.store_string(code)
+	return true
+
+func new_state() -> LuaAPI:
+	var state = LuaAPI.new()
+	state.bind_libraries(["base", "package"])
+	state.module_path = MODULE_DIR + "/?.lua;" + MODULE_DIR + "/?/init.lua"
+	return state
+
+func _process(delta):
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._process(delta)
+
+	DirAccess.make_dir_recursive_absolute(MODULE_DIR + "/util")
+	DirAccess.make_dir_recursive_absolute(MODULE_DIR + "/pkg")
+	if not write_file(MODULE_DIR + "/util/math.lua", "return { double = function(x) return x * 2 end }"):
+		return fail()
+	if not write_file(MODULE_DIR + "/pkg/init.lua", "return { name = 'pkg' }"):
+		return fail()
+
+	# The files were just written, the index must not be stale
+	LuaAPI.clear_module_cache()
+	lua = new_state()
+	sibling = new_state()
+
+	var code = "
+	local m = require('util.math')
+	doubled = m.double(21)
+	pkgName = require('pkg').name
+	same = require('util.math') == m
+	"
+	for state in [lua, sibling]:
+		var err = state.do_string(code)
+		if err is LuaError:
+			errors.append(err)
+			return fail()
+
+		if not state.pull_variant("doubled") == 42 or not state.pull_variant("pkgName") == "pkg" or not state.pull_variant("same"):
+			errors.append(LuaError.new_error("modules did not load as expected"))
+			return fail()
+
+	var err = lua.do_string("require('does.not.exist')")
+	if not err is LuaError or not err.message.contains("does.not.exist"):
+		errors.append(LuaError.new_error("requiring a missing module did not fail"))
+		return fail()
+
+	# Modification times have a resolution of a second
+	OS.delay_msec(1100)
+	if not write_file(MODULE_DIR + "/util/math.lua", "return { double = function(x) return x * 3 end }"):
+		return fail()
+
+	var edited = new_state()
+	err = edited.do_string("doubled = require('util.math').double(21)")
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	if not edited.pull_variant("doubled") == 63:
+		errors.append(LuaError.new_error("edited module was loaded from the stale cache"))
+		return fail()
+
+	for file in [MODULE_DIR + "/util/math.lua", MODULE_DIR + "/pkg/init.lua", MODULE_DIR + "/util", MODULE_DIR + "/pkg", MODULE_DIR]:
+		DirAccess.remove_absolute(file)
+	LuaAPI.clear_module_cache()
+
+	done = true
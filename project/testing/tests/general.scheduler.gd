@@ -0,0 +1,111 @@
+extends UnitTest
+var lua: LuaAPI
+var scheduler: LuaScheduler
+var finished := 0
+var failed := 0
+var frames := 0
+
+func _ready():
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._ready()
+	# id will determine the load order
+	id = 9670
+
+	lua = LuaAPI.new()
+	lua.bind_libraries(["base"])
+	scheduler = LuaScheduler.new()
+	scheduler.bind(lua)
+	scheduler.task_finished.connect(_on_task_finished)
+	scheduler.task_failed.connect(_on_task_failed)
+
+	var err = lua.do_string("
+	counter = 0
+	flag = false
+	function sleeper(seconds)
+		wait(seconds)
+		counter = counter + 1
+	end
+	function stepper(n)
+		wait_frames(n)
+		counter = counter + 1
+	end
+	function waiter()
+		wait_until(function() return flag end)
+		counter = counter + 1
+	end
+	function broken()
+		wait_frames(1)
+		error('broken task')
+	end
+	")
+	if err is LuaError:
+		errors.append(err)
+
+	for i in range(1000):
+		scheduler.spawn("sleeper", [0.05 * (i % 4)])
+	scheduler.spawn("stepper", [3])
+	scheduler.spawn("waiter", [])
+	scheduler.spawn("broken", [])
+	var cancelled = scheduler.spawn("sleeper", [0.0])
+	scheduler.cancel(cancelled)
+
+	# testName and testDescription are for any needed context about the test.
+	testName = "General.scheduler"
+	testDescription = "
+Spawns a thousand tasks sleeping with wait, plus tasks using wait_frames and wait_until, and ticks the scheduler every frame.
+Checks the tasks wake up, that errors and cancellation are reported, and the per tick stats.
+"
+
+func _on_task_finished(_id):
+	finished += 1
+
+func _on_task_failed(_id, _err):
+	failed += 1
+
+func fail():
+	status = false
+	done = true
+
+func _process(delta):
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._process(delta)
+	if not errors.is_empty():
+		return fail()
+
+	var err = scheduler.tick(0.05)
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	frames += 1
+	var stats = scheduler.get_stats()
+	if frames == 1:
+		# Every task runs until its first wait
+		if stats["resumed"] != 1003:
+			errors.append(LuaError.new_error("Expected 1003 tasks resumed on the first tick, got %d" % stats["resumed"]))
+			return fail()
+		if stats["polling"] != 1:
+			errors.append(LuaError.new_error("Expected 1 polling task, got %d" % stats["polling"]))
+			return fail()
+		return
+
+	if frames == 6:
+		lua.push_variant("flag", true)
+		return
+
+	if frames < 8:
+		return
+
+	if failed != 1:
+		errors.append(LuaError.new_error("Expected 1 failed task, got %d" % failed))
+		return fail()
+
+	if finished != 1002 or lua.pull_variant("counter") != 1002:
+		errors.append(LuaError.new_error("Expected 1002 finished tasks, got %d" % finished))
+		return fail()
+
+	if scheduler.get_task_count() != 0 or stats["tasks"] != 0:
+		errors.append(LuaError.new_error("Expected no tasks left"))
+		return fail()
+
+	done = true
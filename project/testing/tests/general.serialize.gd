@@ -0,0 +1,97 @@
+extends UnitTest
+var lua: LuaAPI
+var other: LuaAPI
+
+func _ready():
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._ready()
+	# id will determine the load order
+	id = 9680
+
+	lua = LuaAPI.new()
+	other = LuaAPI.new()
+	lua.bind_libraries(["base"])
+	other.bind_libraries(["base"])
+
+	# testName and testDescription are for any needed context about the test.
+	testName = "General.serialize"
+	testDescription = "
+Serializes a table with shared references, a cycle and builtin types with pull_serialized and loads it into another LuaAPI with push_serialized.
+Also round trips a value through lua_serialize and lua_deserialize and checks corrupt data is rejected.
+Checks the data starts with the magic and version header, is little-endian, and that other versions are rejected.
+"
+
+func fail():
+	status = false
+	done = true
+
+func _process(delta):
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._process(delta)
+
+	var err = lua.do_string("
+	local shared = { hp = 10 }
+	save = {
+		a = shared,
+		b = shared,
+		list = { 1, 2.5, 'three', true },
+		pos = Vector2(1, 2),
+		tint = Color(1, 0, 0, 1),
+		ints = PackedInt32Array(3),
+	}
+	save.self = save
+	")
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	var bytes = lua.pull_serialized("save")
+	if not bytes is PackedByteArray:
+		errors.append(bytes if bytes is LuaError else LuaError.new_error("pull_serialized did not return bytes"))
+		return fail()
+
+	# "LAPS", version 1
+	if not bytes.slice(0, 5) == PackedByteArray([0x4C, 0x41, 0x50, 0x53, 1]):
+		errors.append(LuaError.new_error("unexpected header '%s'" % str(bytes.slice(0, 5))))
+		return fail()
+
+	err = lua.do_string("number = lua_serialize(0.5)")
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	# the number tag, then 0.5 as a little-endian double
+	var number: PackedByteArray = lua.pull_variant("number")
+	if not number.slice(6) == PackedByteArray([0, 0, 0, 0, 0, 0, 0xE0, 0x3F]):
+		errors.append(LuaError.new_error("numbers are not little-endian: '%s'" % str(number)))
+		return fail()
+
+	var newer = bytes.duplicate()
+	newer[4] = 2
+	if not other.push_serialized("save", newer) is LuaError:
+		errors.append(LuaError.new_error("data of another version was accepted"))
+		return fail()
+
+	err = other.push_serialized("save", bytes)
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	err = other.do_string("
+	assert(save.a == save.b and save.a.hp == 10, 'shared table was duplicated')
+	assert(save.self == save, 'cycle was lost')
+	assert(save.list[2] == 2.5 and save.list[3] == 'three' and save.list[4] == true, 'list did not round trip')
+	assert(save.pos.x == 1 and save.pos.y == 2, 'Vector2 did not round trip')
+	assert(save.tint.r == 1 and save.tint.g == 0, 'Color did not round trip')
+	assert(#save.ints == 3, 'packed array did not round trip')
+
+	local copy = lua_deserialize(lua_serialize({ x = { 1, 2 } }))
+	assert(copy.x[2] == 2, 'lua_serialize did not round trip')
+	assert(not pcall(lua_serialize, print), 'functions were serialized')
+	assert(not pcall(lua_deserialize, 'garbage'), 'corrupt data was accepted')
+	")
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	done = true
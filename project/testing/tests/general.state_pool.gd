@@ -0,0 +1,100 @@
+extends UnitTest
+var pool: LuaStatePool
+
+func _ready():
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._ready()
+	# id will determine the load order
+	id = 9720
+
+	pool = LuaStatePool.new()
+	pool.setup(2, ["base", "string"])
+
+	# testName and testDescription are for any needed context about the test.
+	testName = "General.state_pool"
+	testDescription = "
+Tests that LuaStatePool hands out prewarmed states and that released states come back with pristine globals and libraries.
+Also poisons the string metatable and a native type's metatable, which are not reachable from _G.
+Checks that a state is not released while a LuaFunction pulled from it is alive.
+"
+
+func fail():
+	status = false
+	done = true
+
+func _process(delta):
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._process(delta)
+
+	if not pool.get_available_count() == 2:
+		errors.append(LuaError.new_error("pool has %d states instead of 2" % pool.get_available_count()))
+		return fail()
+
+	var lua = pool.acquire()
+	if not pool.get_available_count() == 1:
+		errors.append(LuaError.new_error("acquire did not take a pooled state"))
+		return fail()
+
+	var err = lua.do_string("
+	leaked = 'yes'
+	string.rep = nil
+	string.extra = true
+	print = nil
+	setmetatable(_G, { __index = function() return 'bad' end })
+	getmetatable('').__index = { upper = function() return 'bad' end }
+	getmetatable(Vector2(0, 0)).__add = function() return 'bad' end
+	")
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	lua.permissive = false
+	lua.set_execution_limit(10, 0)
+
+	if not pool.release(lua):
+		errors.append(LuaError.new_error("release failed"))
+		return fail()
+
+	if pool.release(lua):
+		errors.append(LuaError.new_error("releasing twice succeeded"))
+		return fail()
+
+	if pool.release(LuaAPI.new()):
+		errors.append(LuaError.new_error("releasing a state from outside the pool succeeded"))
+		return fail()
+
+	# Either state may be handed out first, check both
+	var states = [pool.acquire(), pool.acquire()]
+	for state in states:
+		err = state.do_string("
+		assert(leaked == nil, 'global leaked')
+		assert(string.rep('a', 3) == 'aaa', 'string.rep not restored')
+		assert(string.extra == nil, 'string.extra leaked')
+		assert(print ~= nil, 'print not restored')
+		assert(getmetatable(_G) == nil, 'metatable of _G leaked')
+		assert(('a'):upper() == 'A', 'string metatable not restored')
+		assert((Vector2(1, 2) + Vector2(1, 1)).x == 2, 'Vector2 metatable not restored')
+		for i = 1, 1000 do end
+		")
+		if err is LuaError:
+			errors.append(err)
+			return fail()
+
+		if not state.permissive:
+			errors.append(LuaError.new_error("permissive was not reset"))
+			return fail()
+
+	# a handle would keep seeing the globals of whoever acquires the state next
+	var held = states[0]
+	held.do_string("function keep() return leaked end")
+	var fn = held.pull_variant("keep")
+	if pool.release(held):
+		errors.append(LuaError.new_error("released a state with a live LuaFunction"))
+		return fail()
+
+	fn = null
+	for state in states:
+		if not pool.release(state):
+			errors.append(LuaError.new_error("release failed after the LuaFunction was dropped"))
+			return fail()
+	done = true
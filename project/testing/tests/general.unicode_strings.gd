@@ -0,0 +1,63 @@
+extends UnitTest
+var lua: LuaAPI
+
+func _ready():
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._ready()
+	# id will determine the load order
+	id = 9820
+
+	lua = LuaAPI.new()
+	lua.permissive = true
+
+	# testName and testDescription are for any needed context about the test.
+	testName = "General.unicode_strings"
+	testDescription = "
+Tests non ASCII strings being passed to and from lua as UTF-8.
+This includes string values, global names and strings created by lua.
+"
+
+func fail():
+	status = false
+	done = true
+
+func _process(delta):
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._process(delta)
+
+	var text = "héllo wörld ✓"
+	var err = lua.push_variant("text", text)
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	err = lua.push_variant("grüße", "ok")
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	err = lua.do_string("
+	result = text .. ' ñ'
+	bytes = #text
+	greeting = _G['grüße']
+	")
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	var result = lua.pull_variant("result")
+	if not result == text + " ñ":
+		errors.append(LuaError.new_error("result is not '%s' but is '%s'" % [text + " ñ", result]))
+		return fail()
+
+	var bytes = lua.pull_variant("bytes")
+	if not bytes == text.to_utf8_buffer().size():
+		errors.append(LuaError.new_error("bytes is not %d but is %d" % [text.to_utf8_buffer().size(), bytes]))
+		return fail()
+
+	var greeting = lua.pull_variant("greeting")
+	if not greeting == "ok":
+		errors.append(LuaError.new_error("greeting is not 'ok' but is '%s'" % str(greeting)))
+		return fail()
+
+	done = true
@@ -0,0 +1,78 @@
+extends UnitTest
+var lua: LuaAPI
+
+func _ready():
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._ready()
+	# id will determine the load order
+	id = 9824
+
+	lua = LuaAPI.new()
+	lua.permissive = true
+	lua.bind_libraries(["base"])
+
+	# testName and testDescription are for any needed context about the test.
+	testName = "General.value_types"
+	testDescription = "
+Tests native field access and arithmetic on Vector2, Vector3, Color, Rect2 and Plane.
+"
+
+func fail():
+	status = false
+	done = true
+
+func _process(delta):
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._process(delta)
+
+	var err = lua.push_variant("pushed", Rect2(1, 2, 3, 4))
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	err = lua.do_string("
+	v = Vector2(1, 2)
+	v.x = 3
+	scaled = 2 * v + Vector2(1, 1)
+	halved = Vector3(2, 4, 6) / 2
+	col = Color(1, 0, 0)
+	col.a = 0.5
+	rect = Rect2(Vector2(1, 1), Vector2(2, 2))
+	rect.size = Vector2(5, 5)
+	position = pushed.position
+	normal = Plane(Vector3(0, 1, 0), 2).normal
+	same = Vector2(1, 1) == Vector2(1, 1)
+
+	-- The metamethods are reachable through getmetatable and must reject other receivers
+	local mt = getmetatable(Vector2(0, 0))
+	tableIndex = pcall(mt.__index, {}, \"x\")
+	foreignNewIndex = pcall(mt.__newindex, Vector3(0, 0, 0), \"x\", 1.0)
+	")
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	var expected = {
+		"v": Vector2(3, 2),
+		"scaled": Vector2(7, 5),
+		"halved": Vector3(1, 2, 3),
+		"col": Color(1, 0, 0, 0.5),
+		"rect": Rect2(1, 1, 5, 5),
+		"position": Vector2(1, 2),
+		"normal": Vector3(0, 1, 0),
+		"same": true,
+		"tableIndex": false,
+		"foreignNewIndex": false,
+	}
+
+	for key in expected:
+		var value = lua.pull_variant(key)
+		if value is LuaError:
+			errors.append(value)
+			return fail()
+
+		if not value == expected[key]:
+			errors.append(LuaError.new_error("%s is not %s but is %s" % [key, str(expected[key]), str(value)]))
+			return fail()
+
+	done = true
@@ -0,0 +1,71 @@
+extends UnitTest
+var lua: LuaAPI
+
+func _ready():
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._ready()
+	# id will determine the load order
+	id = 9985
+
+	lua = LuaAPI.new()
+
+	# testName and testDescription are for any needed context about the test.
+	testName = "LuaAPI.do_file() streaming"
+	testDescription = "
+Loads files from user:// larger than one read block, with a UTF-8 BOM and a # first line, and checks line numbers are kept.
+"
+
+func fail():
+	status = false
+	done = true
+
+func write_file(path: String, bytes: PackedByteArray) -> bool:
+	var file = FileAccess.open(path, FileAccess.WRITE)
+	if file == null:
+		errors.append(LuaError.new_error("could not write '%s'" % path, LuaError.ERR_FILE))
+		return false
+	file.store_buffer(bytes)
+	return true
+
+func _process(delta):
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._process(delta)
+
+	# Spans several 4 KiB blocks
+	var code = "#!/usr/bin/env lua\ntotal = 0\n"
+	for i in range(1000):
+		code += "total = total + %d\n" % i
+
+	var bytes = PackedByteArray([0xEF, 0xBB, 0xBF])
+	bytes.append_array(code.to_utf8_buffer())
+	var path = "user://do_file_stream.lua"
+	if not write_file(path, bytes):
+		return fail()
+
+	var err = lua.do_file(path)
+	DirAccess.remove_absolute(path)
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	if not lua.pull_variant("total") == 499500:
+		errors.append(LuaError.new_error("total is not 499500 but is '%s'" % str(lua.pull_variant("total"))))
+		return fail()
+
+	# the skipped first line still counts
+	path = "user://do_file_stream_error.lua"
+	if not write_file(path, "#!/usr/bin/env lua\nlocal a = 1\nerror('line three')\n".to_utf8_buffer()):
+		return fail()
+
+	err = lua.do_file(path)
+	DirAccess.remove_absolute(path)
+	if not err is LuaError or not err.message.contains(":3:"):
+		errors.append(LuaError.new_error("error was not reported on line 3: '%s'" % (err.message if err is LuaError else "no error")))
+		return fail()
+
+	err = lua.do_file("user://does_not_exist.lua")
+	if not err is LuaError or not err.type == LuaError.ERR_FILE:
+		errors.append(LuaError.new_error("loading a missing file did not return ERR_FILE"))
+		return fail()
+
+	done = true
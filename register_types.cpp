@@ -1,9 +1,23 @@
 #include "register_types.h"
 #include "src/classes/luaAPI.h"
+#include "src/classes/luaBytecode.h"
 #include "src/classes/luaCallableExtra.h"
+#include "src/classes/luaChannel.h"
+#include "src/classes/luaChunk.h"
 #include "src/classes/luaCoroutine.h"
 #include "src/classes/luaError.h"
+#include "src/classes/luaFunction.h"
+#include "src/classes/luaParallelGroup.h"
+#include "src/classes/luaScheduler.h"
+#include "src/classes/luaStatePool.h"
+#include "src/classes/luaTask.h"
 #include "src/classes/luaTuple.h"
+#include "src/luaBytecodeImporter.h"
+#include "src/luaModuleCache.h"
+
+#if defined(TOOLS_ENABLED) && !defined(LAPI_GDEXTENSION)
+#include "core/config/engine.h"
+#endif
 
 #ifdef LAPI_GDEXTENSION
 using namespace godot;
@@ -17,14 +31,34 @@ void initialize_luaAPI_module(ModuleInitializationLevel p_level) {
 	ClassDB::register_class<LuaAPI>();
 	ClassDB::register_class<LuaCoroutine>();
 	ClassDB::register_class<LuaError>();
+	ClassDB::register_class<LuaFunction>();
 	ClassDB::register_class<LuaTuple>();
 	ClassDB::register_class<LuaCallableExtra>();
+	ClassDB::register_class<LuaBytecode>();
+	ClassDB::register_class<LuaChunk>();
+	ClassDB::register_class<LuaStatePool>();
+	ClassDB::register_class<LuaTask>();
+	ClassDB::register_class<LuaParallelGroup>();
+	ClassDB::register_class<LuaChannel>();
+	ClassDB::register_class<LuaScheduler>();
+
+	LuaModuleCache::initialize();
+
+#if defined(TOOLS_ENABLED) && !defined(LAPI_GDEXTENSION)
+	if (Engine::get_singleton()->is_editor_hint()) {
+		Ref<ResourceImporterLuaBytecode> importer;
+		importer.instantiate();
+		ResourceFormatImporter::get_singleton()->add_importer(importer);
+	}
+#endif
 }
 
 void uninitialize_luaAPI_module(ModuleInitializationLevel p_level) {
 	if (p_level != MODULE_INITIALIZATION_LEVEL_SCENE) {
 		return;
 	}
+
+	LuaModuleCache::finalize();
 }
 
 #ifdef LAPI_GDEXTENSION
@@ -1,17 +1,58 @@
 #include "luaAPI.h"
 
+#include "luaBytecode.h"
+#include "luaChunk.h"
 #include "luaCoroutine.h"
+#include "luaTask.h"
+#include "luaTuple.h"
 
+#include <luaModuleCache.h>
+#include <luaSerializer.h>
 #include <luaState.h>
 
-#ifdef LAPI_GDEXTENSION
+#ifndef LAPI_GDEXTENSION
+#include "core/object/worker_thread_pool.h"
+#include "core/os/thread.h"
+#else
 #include <godot_cpp/classes/file_access.hpp>
+#include <godot_cpp/classes/os.hpp>
+#include <godot_cpp/classes/worker_thread_pool.hpp>
+#include <godot_cpp/templates/vector.hpp>
+#endif
+
+LuaAPI::AllocatorType LuaAPI::defaultAllocator = LuaAPI::ALLOCATOR_SYSTEM;
+
+static inline uint64_t getCallerId() {
+#ifndef LAPI_GDEXTENSION
+	return Thread::get_caller_id();
+#else
+	return OS::get_singleton()->get_thread_caller_id();
 #endif
+}
 
 LuaAPI::LuaAPI() {
-	lState = luaL_newstate();
+	for (int i = 0; i < METATABLE_MAX; i++) {
+		metatableRefs[i] = LUA_NOREF;
+	}
+
+	allocator.setBackend((LuaAllocator::Backend)defaultAllocator);
+	lState = lua_newstate(LuaAllocator::alloc, &allocator);
+#ifdef LAPI_LUAJIT
+	// 64 bit LuaJIT without GC64 can't use a custom allocator, the state is then neither tracked nor capped
+	if (lState == nullptr) {
+		allocator.setBackend(LuaAllocator::BACKEND_SYSTEM);
+		lState = luaL_newstate();
+	}
+#endif
+	// luaL_newstate would have set it
+	lua_atpanic(lState, LuaState::luaPanic);
 	// Creating lua state instance
 	state.setState(lState, this, true);
+
+#ifdef LAPI_GDEXTENSION
+	ownerMutex.instantiate();
+	ownerReleased.instantiate();
+#endif
 }
 
 LuaAPI::~LuaAPI() {
@@ -22,30 +63,61 @@ LuaAPI::~LuaAPI() {
 void LuaAPI::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("do_file", "FilePath"), &LuaAPI::doFile);
 	ClassDB::bind_method(D_METHOD("do_string", "Code"), &LuaAPI::doString);
+	ClassDB::bind_method(D_METHOD("do_chunk", "Chunk"), &LuaAPI::doChunk);
+	ClassDB::bind_method(D_METHOD("compile_string", "Code"), &LuaAPI::compileString);
+	ClassDB::bind_method(D_METHOD("compile_file", "FilePath"), &LuaAPI::compileFile);
+	ClassDB::bind_method(D_METHOD("call_function_async", "LuaFunctionName", "Args"), &LuaAPI::callFunctionAsync);
+	ClassDB::bind_method(D_METHOD("do_string_async", "Code"), &LuaAPI::doStringAsync);
+	ClassDB::bind_method(D_METHOD("do_file_async", "FilePath"), &LuaAPI::doFileAsync);
+	// Only bound so it can be used as a callable, it is not part of the API
+	ClassDB::bind_method(D_METHOD("_run_tasks"), &LuaAPI::_runTasks);
 
 	ClassDB::bind_method(D_METHOD("bind_libraries", "Array"), &LuaAPI::bindLibraries);
 	ClassDB::bind_method(D_METHOD("set_hook", "Hook", "HookMask", "Count"), &LuaAPI::setHook);
+	ClassDB::bind_method(D_METHOD("set_execution_limit", "Instructions", "Usec"), &LuaAPI::setExecutionLimit);
 	ClassDB::bind_method(D_METHOD("configure_gc", "What", "Data"), &LuaAPI::configure_gc);
 	ClassDB::bind_method(D_METHOD("push_variant", "Name", "var"), &LuaAPI::pushGlobalVariant);
 	ClassDB::bind_method(D_METHOD("pull_variant", "Name"), &LuaAPI::pullVariant);
+	ClassDB::bind_method(D_METHOD("push_serialized", "Name", "Bytes"), &LuaAPI::pushSerialized);
+	ClassDB::bind_method(D_METHOD("pull_serialized", "Name"), &LuaAPI::pullSerialized);
 	ClassDB::bind_method(D_METHOD("expose_constructor", "LuaConstructorName", "Object"), &LuaAPI::exposeObjectConstructor);
 	ClassDB::bind_method(D_METHOD("call_function", "LuaFunctionName", "Args"), &LuaAPI::callFunction);
-	ClassDB::bind_method(D_METHOD("call_function_ref", "Args", "LuaFunctionRef"), &LuaAPI::callFunctionRef);
+	ClassDB::bind_method(D_METHOD("call_function_tuple", "LuaFunctionName", "Args"), &LuaAPI::callFunctionTuple);
+	ClassDB::bind_method(D_METHOD("call_function_into", "LuaFunctionName", "Args", "Results"), &LuaAPI::callFunctionInto);
+	ClassDB::bind_method(D_METHOD("call_function_batch", "LuaFunctionName", "ArgSets"), &LuaAPI::callFunctionBatch);
+	ClassDB::bind_method(D_METHOD("call_function_batch_packed", "LuaFunctionName", "Args"), &LuaAPI::callFunctionBatchPacked);
 	ClassDB::bind_method(D_METHOD("function_exists", "LuaFunctionName"), &LuaAPI::luaFunctionExists);
 
 	ClassDB::bind_method(D_METHOD("new_coroutine"), &LuaAPI::newCoroutine);
 	ClassDB::bind_method(D_METHOD("get_running_coroutine"), &LuaAPI::getRunningCoroutine);
 
+	ClassDB::bind_method(D_METHOD("get_memory_stats"), &LuaAPI::getMemoryStats);
+	ClassDB::bind_method(D_METHOD("get_allocator"), &LuaAPI::getAllocator);
+	ClassDB::bind_static_method("LuaAPI", D_METHOD("set_default_allocator", "Allocator"), &LuaAPI::setDefaultAllocator);
+	ClassDB::bind_static_method("LuaAPI", D_METHOD("get_default_allocator"), &LuaAPI::getDefaultAllocator);
+	ClassDB::bind_method(D_METHOD("set_memory_limit", "value"), &LuaAPI::setMemoryLimit);
+	ClassDB::bind_method(D_METHOD("get_memory_limit"), &LuaAPI::getMemoryLimit);
+
+	ClassDB::bind_method(D_METHOD("set_module_path", "value"), &LuaAPI::setModulePath);
+	ClassDB::bind_method(D_METHOD("get_module_path"), &LuaAPI::getModulePath);
+	ClassDB::bind_static_method("LuaAPI", D_METHOD("clear_module_cache"), &LuaAPI::clearModuleCache);
+
 	ClassDB::bind_method(D_METHOD("set_permissive", "value"), &LuaAPI::setPermissive);
 	ClassDB::bind_method(D_METHOD("get_permissive"), &LuaAPI::getPermissive);
+	ClassDB::bind_method(D_METHOD("clear_binding_cache"), &LuaAPI::clearBindingCache);
 
 	ADD_PROPERTY(PropertyInfo(Variant::INT, "permissive"), "set_permissive", "get_permissive");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "memory_limit"), "set_memory_limit", "get_memory_limit");
+	ADD_PROPERTY(PropertyInfo(Variant::STRING, "module_path"), "set_module_path", "get_module_path");
 
 	BIND_ENUM_CONSTANT(HOOK_MASK_CALL);
 	BIND_ENUM_CONSTANT(HOOK_MASK_RETURN);
 	BIND_ENUM_CONSTANT(HOOK_MASK_LINE);
 	BIND_ENUM_CONSTANT(HOOK_MASK_COUNT);
 
+	BIND_ENUM_CONSTANT(ALLOCATOR_SYSTEM);
+	BIND_ENUM_CONSTANT(ALLOCATOR_POOL);
+
 	BIND_ENUM_CONSTANT(GC_STOP);
 	BIND_ENUM_CONSTANT(GC_RESTART);
 	BIND_ENUM_CONSTANT(GC_COLLECT);
@@ -56,90 +128,451 @@ void LuaAPI::_bind_methods() {
 	BIND_ENUM_CONSTANT(GC_SETSTEPMUL);
 }
 
+LuaAPI::AllocatorType LuaAPI::getAllocator() const {
+	return (AllocatorType)allocator.getBackend();
+}
+
+void LuaAPI::clearModuleCache() {
+	LuaModuleCache::clear();
+}
+
+// Only states created afterwards use the new allocator
+void LuaAPI::setDefaultAllocator(AllocatorType type) {
+	defaultAllocator = type;
+}
+
+LuaAPI::AllocatorType LuaAPI::getDefaultAllocator() {
+	return defaultAllocator;
+}
+
 // Calls LuaState::bindLibs()
 void LuaAPI::bindLibraries(Array libs) {
+	LuaStateLock lock(this);
+	ERR_FAIL_COND_MSG(!lock.isLocked(), "LuaAPI is in use by another thread.");
 	state.bindLibraries(libs);
 }
 
 void LuaAPI::setHook(Callable hook, int mask, int count) {
+	LuaStateLock lock(this);
+	ERR_FAIL_COND_MSG(!lock.isLocked(), "LuaAPI is in use by another thread.");
 	return state.setHook(hook, mask, count);
 }
 
+void LuaAPI::setExecutionLimit(int64_t instructions, int64_t usec) {
+	LuaStateLock lock(this);
+	ERR_FAIL_COND_MSG(!lock.isLocked(), "LuaAPI is in use by another thread.");
+	state.setExecutionLimit(instructions, usec);
+}
+
+// Lua reads the binding cache and the module path while it runs, so they are only changed while holding the state
+void LuaAPI::setPermissive(bool value) {
+	LuaStateLock lock(this);
+	ERR_FAIL_COND_MSG(!lock.isLocked(), "LuaAPI is in use by another thread.");
+	permissive = value;
+	// Bindings are resolved against the permissive mode
+	bindingCache.clear();
+}
+
+void LuaAPI::setModulePath(String value) {
+	LuaStateLock lock(this);
+	ERR_FAIL_COND_MSG(!lock.isLocked(), "LuaAPI is in use by another thread.");
+	modulePath = value;
+}
+
+// Connected to the "changed" signal of scripts, which may be emitted while another thread runs lua.
+// The cache is then cleared by that thread on its next lookup instead of being left stale.
+void LuaAPI::clearBindingCache() {
+	LuaStateLock lock(this);
+	if (!lock.isLocked()) {
+		bindingCacheStale.set();
+		return;
+	}
+	bindingCache.clear();
+}
+
+int LuaAPI::configure_gc(int what, int data) {
+	LuaStateLock lock(this);
+	ERR_FAIL_COND_V_MSG(!lock.isLocked(), -1, "LuaAPI is in use by another thread.");
+	return lua_gc(lState, what, data);
+}
+
 // Calls LuaState::luaFunctionExists()
 bool LuaAPI::luaFunctionExists(String functionName) {
+	LuaStateLock lock(this);
+	if (!lock.isLocked()) {
+		return false;
+	}
+
 	return state.luaFunctionExists(functionName);
 }
 
 // Calls LuaState::pullVariant()
 Variant LuaAPI::pullVariant(String name) {
+	LuaStateLock lock(this);
+	if (!lock.isLocked()) {
+		return newBusyError();
+	}
+
 	return state.pullVariant(name);
 }
 
 // Calls LuaState::callFunction()
 Variant LuaAPI::callFunction(String functionName, Array args) {
+	LuaStateLock lock(this);
+	if (!lock.isLocked()) {
+		return newBusyError();
+	}
+
 	return state.callFunction(functionName, args);
 }
 
-// Invokes the passed lua reference
-Variant LuaAPI::callFunctionRef(Array args, int funcRef) {
-	lua_pushcfunction(lState, LuaState::luaErrorHandler);
+// Calls LuaState::callFunctionMulti(), returns every value as a LuaTuple or a LuaError
+Variant LuaAPI::callFunctionTuple(String functionName, Array args) {
+	LuaStateLock lock(this);
+	if (!lock.isLocked()) {
+		return newBusyError();
+	}
 
-	// Getting the lua function via the reference stored in funcRef
-	lua_rawgeti(lState, LUA_REGISTRYINDEX, funcRef);
+	Array results;
+	LuaError *err = state.callFunctionMulti(functionName, args, results);
+	if (err != nullptr) {
+		return err;
+	}
+	// The tuple takes the Array over, it is not copied
+	return LuaTuple::fromArray(results);
+}
 
-	// Push all the argument on to the stack
-	for (int i = 0; i < args.size(); i++) {
-		LuaState::pushVariant(lState, args[i]);
+// Calls LuaState::callFunctionMulti() writing every value into results, which is resized to fit
+LuaError *LuaAPI::callFunctionInto(String functionName, Array args, Array results) {
+	LuaStateLock lock(this);
+	if (!lock.isLocked()) {
+		return newBusyError();
 	}
 
-	Variant toReturn;
-	// execute the function using a protected call.
-	int ret = lua_pcall(lState, args.size(), 1, -2 - args.size());
-	if (ret != LUA_OK) {
-		toReturn = LuaState::handleError(lState, ret);
-	} else {
-		toReturn = LuaState::getVariant(lState, -1, this);
+	return state.callFunctionMulti(functionName, args, results);
+}
+
+// Calls LuaState::callFunctionBatch() for every argument set
+Array LuaAPI::callFunctionBatch(String functionName, Array argSets) {
+	Vector<Variant> results;
+	results.resize(argSets.size());
+	callFunctionRange(functionName, argSets, 0, argSets.size(), results.ptrw());
+
+	Array ret;
+	ret.resize(results.size());
+	for (int i = 0; i < results.size(); i++) {
+		ret[i] = results[i];
 	}
+	return ret;
+}
 
-	lua_pop(lState, 1);
-	return toReturn;
+// Calls LuaState::callFunctionBatchPacked()
+Array LuaAPI::callFunctionBatchPacked(String functionName, Variant args) {
+	Array ret;
+	switch (args.get_type()) {
+		case Variant::PACKED_INT32_ARRAY:
+		case Variant::PACKED_INT64_ARRAY:
+		case Variant::PACKED_FLOAT32_ARRAY:
+		case Variant::PACKED_FLOAT64_ARRAY:
+		case Variant::PACKED_STRING_ARRAY:
+		case Variant::PACKED_VECTOR2_ARRAY:
+		case Variant::PACKED_VECTOR3_ARRAY:
+		case Variant::PACKED_COLOR_ARRAY:
+			break;
+		default:
+			ret.append(LuaError::newError("Args must be a packed array", LuaError::ERR_TYPE));
+			return ret;
+	}
+
+	int count = args.call("size");
+	Vector<Variant> results;
+	results.resize(count);
+
+	LuaStateLock lock(this);
+	if (!lock.isLocked()) {
+		ret.append(newBusyError());
+		return ret;
+	}
+	state.callFunctionBatchPacked(functionName, args, results.ptrw());
+
+	ret.resize(count);
+	for (int i = 0; i < count; i++) {
+		ret[i] = results[i];
+	}
+	return ret;
+}
+
+// Writes the results of the calls for argSets[from, to) to results[from, to), which the caller owns.
+// Used by LuaParallelGroup, each worker fills its own range.
+void LuaAPI::callFunctionRange(const String &functionName, const Array &argSets, int from, int to, Variant *results) {
+	LuaStateLock lock(this);
+	if (!lock.isLocked()) {
+		for (int i = from; i < to; i++) {
+			results[i] = newBusyError();
+		}
+		return;
+	}
+
+	state.callFunctionBatch(functionName, argSets, from, to, results);
+}
+
+// Claims the state for the calling thread. The thread holding it may claim it again, e.g. when Lua calls GDScript
+// which calls back into this LuaAPI. Other threads fail, or block until it is released when wait is true.
+bool LuaAPI::lock(bool wait) {
+	uint64_t current = getCallerId();
+#ifndef LAPI_GDEXTENSION
+	MutexLock guard(ownerMutex);
+	while (ownerDepth > 0 && owner != current) {
+		if (!wait) {
+			return false;
+		}
+		ownerReleased.wait(guard);
+	}
+#else
+	MutexLock guard(*ownerMutex.ptr());
+	while (ownerDepth > 0 && owner != current) {
+		if (!wait) {
+			return false;
+		}
+
+		ownerWaiters++;
+		ownerMutex->unlock();
+		ownerReleased->wait();
+		ownerMutex->lock();
+		ownerWaiters--;
+	}
+#endif
+
+	owner = current;
+	ownerDepth++;
+	return true;
+}
+
+void LuaAPI::unlock() {
+	MutexLock guard(getOwnerMutex());
+	if (ownerDepth == 1) {
+		freePendingRefs();
+	}
+
+#ifndef LAPI_GDEXTENSION
+	if (--ownerDepth == 0) {
+		ownerReleased.notify_one();
+	}
+#else
+	if (--ownerDepth == 0 && ownerWaiters > 0) {
+		ownerReleased->post();
+	}
+#endif
+}
+
+// Frees a registry reference from any thread without waiting for the state. If another thread holds it, that
+// thread frees the reference when it releases the state.
+void LuaAPI::releaseRef(int ref) {
+	MutexLock guard(getOwnerMutex());
+	if (ownerDepth > 0 && owner != getCallerId()) {
+		pendingUnrefs.push_back(ref);
+		return;
+	}
+
+	// Nobody else can claim the state while ownerMutex is held
+	luaL_unref(lState, LUA_REGISTRYINDEX, ref);
+}
+
+// Expects ownerMutex to be held by the thread owning the state
+void LuaAPI::freePendingRefs() {
+	for (int ref : pendingUnrefs) {
+		luaL_unref(lState, LUA_REGISTRYINDEX, ref);
+	}
+	pendingUnrefs.clear();
+}
+
+// Adds task to the queue of this state, starting a worker on the WorkerThreadPool if none runs it.
+// Queued tasks run one after another, so at most one pool thread waits for the state.
+void LuaAPI::queueTask(LuaTask *task) {
+	MutexLock guard(getOwnerMutex());
+	tasks.push_back(task);
+	if (taskWorker == -1) {
+		taskWorker = WorkerThreadPool::get_singleton()->add_task(Callable(this, "_run_tasks"), false, "LuaTask");
+	}
+}
+
+// Runs on the worker started by queueTask() until the queue is empty
+void LuaAPI::_runTasks() {
+	int64_t worker = -1;
+	LuaTask *task = nextTask(worker);
+	while (task != nullptr) {
+		task->execute();
+		LuaTask *next = nextTask(worker);
+		// The last task waits for the worker, which keeps this LuaAPI alive until the worker returned
+		task->finish(next == nullptr ? worker : -1);
+		task = next;
+	}
+}
+
+// Takes the next queued task. Returns nullptr and the worker's id once the queue is empty, the worker stops then.
+LuaTask *LuaAPI::nextTask(int64_t &worker) {
+	MutexLock guard(getOwnerMutex());
+	if (tasks.is_empty()) {
+		worker = taskWorker;
+		taskWorker = -1;
+		return nullptr;
+	}
+
+	LuaTask *task = tasks.front()->get();
+	tasks.pop_front();
+	return task;
+}
+
+LuaError *LuaAPI::newBusyError() {
+	return LuaError::newError("LuaAPI is in use by another thread", LuaError::ERR_RUNTIME);
+}
+
+// Records the current globals as the state reset() returns to
+void LuaAPI::snapshot() {
+	LuaStateLock lock(this);
+	ERR_FAIL_COND_MSG(!lock.isLocked(), "LuaAPI is in use by another thread.");
+	state.snapshotGlobals();
+}
+
+// Returns the globals to the snapshot and the settings to their defaults, then collects what scripts left behind.
+// Fails if there is no snapshot or Lua is running.
+bool LuaAPI::reset() {
+	LuaStateLock lock(this);
+	if (!lock.isLocked() || activeState != nullptr || !state.restoreGlobals()) {
+		return false;
+	}
+
+	lua_settop(lState, 0);
+	setHook(Callable(), 0, 0);
+	setExecutionLimit(0, 0);
+	setMemoryLimit(0);
+	setPermissive(true);
+	modulePath = LAPI_DEFAULT_MODULE_PATH;
+	lua_gc(lState, LUA_GCCOLLECT, 0);
+	return true;
+}
+
+// The handle may be in its destructor on another thread. Its reference count is 0 then and the Ref stays empty,
+// it can't be freed before the Ref is made since its destructor waits for ownerMutex in clearFunctionRef().
+Ref<LuaFunction> LuaAPI::getFunctionRef(const void *pointer) {
+	MutexLock guard(getOwnerMutex());
+	LuaFunction **func = functionRefs.getptr(pointer);
+	return func == nullptr ? Ref<LuaFunction>() : Ref<LuaFunction>(*func);
+}
+
+void LuaAPI::setFunctionRef(const void *pointer, LuaFunction *func) {
+	MutexLock guard(getOwnerMutex());
+	functionRefs.insert(pointer, func);
+}
+
+// Only forgets the handle if it is still the one registered, a new handle may have replaced a dying one
+void LuaAPI::clearFunctionRef(const void *pointer, LuaFunction *func) {
+	MutexLock guard(getOwnerMutex());
+	LuaFunction **registered = functionRefs.getptr(pointer);
+	if (registered != nullptr && *registered == func) {
+		functionRefs.erase(pointer);
+	}
+}
+
+// Counts the LuaScheduler tasks living in this state
+void LuaAPI::addSchedulerTasks(int count) {
+	MutexLock guard(getOwnerMutex());
+	schedulerTasks += count;
+}
+
+// Whether LuaFunction handles or LuaScheduler tasks still reference functions of the state. See LuaStatePool::release().
+bool LuaAPI::hasLiveHandles() {
+	MutexLock guard(getOwnerMutex());
+	return !functionRefs.is_empty() || schedulerTasks > 0;
 }
 
 // Calls LuaState::pushGlobalVariant()
 LuaError *LuaAPI::pushGlobalVariant(String name, Variant var) {
+	LuaStateLock lock(this);
+	if (!lock.isLocked()) {
+		return newBusyError();
+	}
+
 	return state.pushGlobalVariant(name, var);
 }
 
+// Serializes the global with the given name without converting it to a Variant. Returns a LuaError if it can't be serialized.
+Variant LuaAPI::pullSerialized(String name) {
+	LuaStateLock lock(this);
+	if (!lock.isLocked()) {
+		return newBusyError();
+	}
+
+	state.getGlobal(name);
+	PackedByteArray bytes;
+	LuaError *err = LuaSerializer::serialize(lState, -1, bytes);
+	lua_pop(lState, 1);
+	if (err != nullptr) {
+		return err;
+	}
+	return bytes;
+}
+
+// Sets the global with the given name to the value pull_serialized or lua_serialize wrote
+LuaError *LuaAPI::pushSerialized(String name, PackedByteArray bytes) {
+	LuaStateLock lock(this);
+	if (!lock.isLocked()) {
+		return newBusyError();
+	}
+
+	LuaError *err = LuaSerializer::deserialize(lState, bytes.ptr(), bytes.size());
+	if (err != nullptr) {
+		return err;
+	}
+	state.setGlobal(name);
+	return nullptr;
+}
+
 // Calls LuaState::exposeObjectConstructor()
 LuaError *LuaAPI::exposeObjectConstructor(String name, Object *obj) {
+	LuaStateLock lock(this);
+	if (!lock.isLocked()) {
+		return newBusyError();
+	}
+
 	return state.exposeObjectConstructor(name, obj);
 }
 
-// addFile() calls luaL_loadfille with the absolute file path
+// Loads the file with LuaState::loadFile() and executes it
 LuaError *LuaAPI::doFile(String fileName) {
+	LuaStateLock lock(this);
+	if (!lock.isLocked()) {
+		return newBusyError();
+	}
+
 	// push the error handler onto the stack
 	lua_pushcfunction(lState, LuaState::luaErrorHandler);
 
-	String path;
-	// fileAccess never unrefs without this
-	{
-#ifndef LAPI_GDEXTENSION
-		Error error;
-		Ref<FileAccess> file = FileAccess::open(fileName, FileAccess::READ, &error);
-		if (error != Error::OK) {
-			return LuaError::newError(vformat("error '%s' while opening file '%s'", error_names[error], fileName), LuaError::ERR_FILE);
-		}
-#else
-		Ref<FileAccess> file = FileAccess::open(fileName, FileAccess::READ);
-		if (!file.is_valid()) {
-			return LuaError::newError(vformat("error while opening file '%s'", fileName), LuaError::ERR_FILE);
-		}
-#endif
+	LuaError *err = LuaState::loadFile(lState, fileName);
+	if (err != nullptr) {
+		// pop the error handler from the stack
+		lua_pop(lState, 1);
+		return err;
+	}
+
+	err = execute(-2);
+	// pop the error handler from the stack
+	lua_pop(lState, 1);
+	return err;
+}
 
-		path = file->get_path_absolute();
+// Loads string into lua state and executes the top of the stack
+LuaError *LuaAPI::doString(String code) {
+	LuaStateLock lock(this);
+	if (!lock.isLocked()) {
+		return newBusyError();
 	}
 
-	int ret = luaL_loadfile(lState, path.ascii().get_data());
+	// push the error handler onto the stack
+	lua_pushcfunction(lState, LuaState::luaErrorHandler);
+	CharString utf8 = code.utf8();
+	// The code is its own chunk name, the same as luaL_loadstring
+	int ret = luaL_loadbuffer(lState, utf8.get_data(), utf8.length(), utf8.get_data());
 	if (ret != LUA_OK) {
 		return state.handleError(ret);
 	}
@@ -150,24 +583,90 @@ LuaError *LuaAPI::doFile(String fileName) {
 	return err;
 }
 
-// Loads string into lua state and executes the top of the stack
-LuaError *LuaAPI::doString(String code) {
+// Runs a compiled chunk, the bytecode is only loaded the first time this state runs it
+LuaError *LuaAPI::doChunk(Ref<LuaChunk> chunk) {
+	if (chunk.is_null()) {
+		return LuaError::newError("Chunk is null", LuaError::ERR_RUNTIME);
+	}
+
+	LuaStateLock lock(this);
+	if (!lock.isLocked()) {
+		return newBusyError();
+	}
+
 	// push the error handler onto the stack
 	lua_pushcfunction(lState, LuaState::luaErrorHandler);
-	int ret = luaL_loadstring(lState, code.ascii().get_data());
-	if (ret != LUA_OK) {
-		return state.handleError(ret);
+
+	LuaError *err = chunk->push(this);
+	if (err != nullptr) {
+		// pop the error handler from the stack
+		lua_pop(lState, 1);
+		return err;
 	}
 
-	LuaError *err = execute(-2);
+	err = execute(-2);
 	// pop the error handler from the stack
 	lua_pop(lState, 1);
 	return err;
 }
 
+// Parses code into a LuaChunk, returns a LuaError if it does not parse
+Variant LuaAPI::compileString(String code) {
+	LuaStateLock lock(this);
+	if (!lock.isLocked()) {
+		return newBusyError();
+	}
+
+	CharString utf8 = code.utf8();
+	// The code is its own chunk name, the same as do_string
+	int ret = luaL_loadbuffer(lState, utf8.get_data(), utf8.length(), utf8.get_data());
+	if (ret != LUA_OK) {
+		return state.handleError(ret);
+	}
+
+	Ref<LuaBytecode> bytecode = LuaBytecode::dump(lState, false);
+	bytecode->setSourceHash(code.md5_text());
+	return LuaChunk::fromStack(this, bytecode, code);
+}
+
+// Loads a file into a LuaChunk, using its imported bytecode when possible
+Variant LuaAPI::compileFile(String fileName) {
+	LuaStateLock lock(this);
+	if (!lock.isLocked()) {
+		return newBusyError();
+	}
+
+	LuaError *err = LuaState::loadFile(lState, fileName);
+	if (err != nullptr) {
+		return err;
+	}
+
+	return LuaChunk::fromStack(this, LuaBytecode::dump(lState, false), "@" + fileName);
+}
+
+// Runs call_function on the WorkerThreadPool
+Ref<LuaTask> LuaAPI::callFunctionAsync(String functionName, Array args) {
+	return LuaTask::start(this, LuaTask::KIND_CALL, functionName, args);
+}
+
+// Runs do_string on the WorkerThreadPool
+Ref<LuaTask> LuaAPI::doStringAsync(String code) {
+	return LuaTask::start(this, LuaTask::KIND_STRING, code, Array());
+}
+
+// Runs do_file on the WorkerThreadPool
+Ref<LuaTask> LuaAPI::doFileAsync(String fileName) {
+	return LuaTask::start(this, LuaTask::KIND_FILE, fileName, Array());
+}
+
 // Execute the current lua stack, return error as string if one occurs, otherwise return String()
 LuaError *LuaAPI::execute(int handlerIndex) {
-	int ret = lua_pcall(lState, 0, 0, handlerIndex);
+	LuaExecutionScope scope(&state);
+	int ret;
+	{
+		LuaProtectedScope protect(&state);
+		ret = lua_pcall(lState, 0, 0, handlerIndex);
+	}
 	if (ret != LUA_OK) {
 		return state.handleError(ret);
 	}
@@ -175,6 +674,9 @@ LuaError *LuaAPI::execute(int handlerIndex) {
 }
 
 Ref<LuaCoroutine> LuaAPI::newCoroutine() {
+	LuaStateLock lock(this);
+	ERR_FAIL_COND_V_MSG(!lock.isLocked(), Ref<LuaCoroutine>(), "LuaAPI is in use by another thread.");
+
 	Ref<LuaCoroutine> thread;
 	thread.instantiate();
 	thread->bind(this);
@@ -182,6 +684,9 @@ Ref<LuaCoroutine> LuaAPI::newCoroutine() {
 }
 
 Ref<LuaCoroutine> LuaAPI::getRunningCoroutine() {
+	LuaStateLock lock(this);
+	ERR_FAIL_COND_V_MSG(!lock.isLocked(), Ref<LuaCoroutine>(), "LuaAPI is in use by another thread.");
+
 	Variant top = state.getVar();
 	if (top.get_type() != Variant::Type::OBJECT) {
 		return nullptr;
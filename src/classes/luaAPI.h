@@ -4,20 +4,39 @@
 #ifndef LAPI_GDEXTENSION
 #include "core/core_bind.h"
 #include "core/object/ref_counted.h"
+#include "core/os/condition_variable.h"
+#include "core/os/mutex.h"
+#include "core/templates/list.h"
+#include "core/templates/safe_refcount.h"
+#include "core/templates/vector.h"
 #else
+#include <godot_cpp/classes/mutex.hpp>
 #include <godot_cpp/classes/ref.hpp>
+#include <godot_cpp/classes/semaphore.hpp>
+#include <godot_cpp/core/mutex_lock.hpp>
+#include <godot_cpp/templates/list.hpp>
+#include <godot_cpp/templates/safe_refcount.hpp>
+#include <godot_cpp/templates/vector.hpp>
 #endif
 
 #include "luaError.h"
 
+#include <luaAllocator.h>
+#include <luaBindingCache.h>
 #include <luaState.h>
+#include <luaStringCache.h>
 #include <lua/lua.hpp>
 
 #ifdef LAPI_GDEXTENSION
 using namespace godot;
 #endif
 
+#define LAPI_DEFAULT_MODULE_PATH "res://?.lua;res://?/init.lua"
+
+class LuaChunk;
+class LuaTask;
 class LuaCoroutine;
+class LuaFunction;
 
 class LuaAPI : public RefCounted {
 	GDCLASS(LuaAPI, RefCounted);
@@ -31,28 +50,64 @@ public:
 
 	void bindLibraries(Array libs);
 	void setHook(Callable hook, int mask, int count);
+	void setExecutionLimit(int64_t instructions, int64_t usec);
 
-	inline int configure_gc(int what, int data) {
-		return lua_gc(lState, what, data);
-	}
+	int configure_gc(int what, int data);
 
-	inline void setPermissive(bool value) {
-		permissive = value;
-	}
+	void setPermissive(bool value);
 
 	inline bool getPermissive() const {
 		return permissive;
 	}
 
+	void setModulePath(String value);
+
+	inline String getModulePath() const {
+		return modulePath;
+	}
+
+	static void clearModuleCache();
+
+	inline void setMemoryLimit(int64_t bytes) {
+		allocator.setLimit(MAX(bytes, 0));
+	}
+
+	inline int64_t getMemoryLimit() const {
+		return allocator.getLimit();
+	}
+
+	inline bool fitsMemoryLimit(uint64_t count, uint64_t size) const {
+		return allocator.fits(count, size);
+	}
+
+	inline Dictionary getMemoryStats() const {
+		return allocator.getStats();
+	}
+
 	bool luaFunctionExists(String functionName);
 
 	Variant pullVariant(String name);
 	Variant callFunction(String functionName, Array args);
-	Variant callFunctionRef(Array args, int funcRef);
 
 	LuaError *doFile(String fileName);
 	LuaError *doString(String code);
+	LuaError *doChunk(Ref<LuaChunk> chunk);
+	Variant compileString(String code);
+	Variant compileFile(String fileName);
+
+	Ref<LuaTask> callFunctionAsync(String functionName, Array args);
+	Ref<LuaTask> doStringAsync(String code);
+	Ref<LuaTask> doFileAsync(String fileName);
 	LuaError *pushGlobalVariant(String name, Variant var);
+	Variant pullSerialized(String name);
+
+	Variant callFunctionTuple(String functionName, Array args);
+	LuaError *callFunctionInto(String functionName, Array args, Array results);
+
+	Array callFunctionBatch(String functionName, Array argSets);
+	Array callFunctionBatchPacked(String functionName, Variant args);
+	void callFunctionRange(const String &functionName, const Array &argSets, int from, int to, Variant *results);
+	LuaError *pushSerialized(String name, PackedByteArray bytes);
 	LuaError *exposeObjectConstructor(String name, Object *obj);
 
 	Ref<LuaCoroutine> newCoroutine();
@@ -61,6 +116,77 @@ public:
 	lua_State *newThreadState();
 	lua_State *getState();
 
+	inline LuaStringCache *getStringCache() {
+		return &stringCache;
+	}
+
+	// Only called while holding the state. Applies a clear_binding_cache() which came in while another thread held it.
+	inline LuaBindingCache *getBindingCache() {
+		if (bindingCacheStale.is_set()) {
+			bindingCacheStale.clear();
+			bindingCache.clear();
+		}
+		return &bindingCache;
+	}
+
+	void clearBindingCache();
+
+	inline int getMetatableRef(LuaMetatable metatable) const {
+		return metatableRefs[metatable];
+	}
+
+	inline void setMetatableRef(LuaMetatable metatable, int ref) {
+		metatableRefs[metatable] = ref;
+	}
+
+	// The state Lua was last entered through from Godot, its execution limit and hook apply.
+	inline LuaState *getActiveState() const {
+		return activeState;
+	}
+
+	inline void setActiveState(LuaState *state) {
+		activeState = state;
+	}
+
+	// Turns the memory limit on or off, returns the previous setting. See LuaProtectedScope.
+	inline bool setEnforcingLimit(bool value) {
+		bool previous = allocator.isEnforcing();
+		allocator.setEnforcing(value);
+		return previous;
+	}
+
+	inline LuaState *getMainState() {
+		return &state;
+	}
+
+	void snapshot();
+	bool reset();
+
+	bool lock(bool wait);
+	void unlock();
+	static LuaError *newBusyError();
+
+	void releaseRef(int ref);
+
+	void queueTask(LuaTask *task);
+	void _runTasks();
+
+	// The LuaStatePool which created this state, 0 if none did
+	inline uint64_t getPoolId() const {
+		return poolId;
+	}
+
+	inline void setPoolId(uint64_t id) {
+		poolId = id;
+	}
+
+	Ref<LuaFunction> getFunctionRef(const void *pointer);
+	void setFunctionRef(const void *pointer, LuaFunction *func);
+	void clearFunctionRef(const void *pointer, LuaFunction *func);
+
+	void addSchedulerTasks(int count);
+	bool hasLiveHandles();
+
 	enum HookMask {
 		HOOK_MASK_CALL = LUA_MASKCALL,
 		HOOK_MASK_RETURN = LUA_MASKRET,
@@ -68,6 +194,11 @@ public:
 		HOOK_MASK_COUNT = LUA_MASKCOUNT,
 	};
 
+	enum AllocatorType {
+		ALLOCATOR_SYSTEM = LuaAllocator::BACKEND_SYSTEM,
+		ALLOCATOR_POOL = LuaAllocator::BACKEND_POOL,
+	};
+
 	enum GCOption {
 		GC_STOP = LUA_GCSTOP,
 		GC_RESTART = LUA_GCRESTART,
@@ -79,16 +210,99 @@ public:
 		GC_SETSTEPMUL = LUA_GCSETSTEPMUL,
 	};
 
+	AllocatorType getAllocator() const;
+	static void setDefaultAllocator(AllocatorType type);
+	static AllocatorType getDefaultAllocator();
+
 private:
+	LuaAllocator allocator;
 	LuaState state;
+	LuaStringCache stringCache;
+	LuaBindingCache bindingCache;
+	SafeFlag bindingCacheStale;
+	int metatableRefs[METATABLE_MAX];
+	// Live LuaFunction handles keyed by lua_topointer, so pulling the same function twice returns the same handle.
+	// Guarded by ownerMutex, a handle may be freed on any thread.
+	HashMap<const void *, LuaFunction *> functionRefs;
+	int schedulerTasks = 0;
 	lua_State *lState = nullptr;
+	LuaState *activeState = nullptr;
 
 	bool permissive = true;
+	uint64_t poolId = 0;
+
+	// The thread using the state and how many times it entered, see lock()
+#ifndef LAPI_GDEXTENSION
+	BinaryMutex ownerMutex;
+	ConditionVariable ownerReleased;
+#else
+	// godot-cpp has no condition variable, waiters sleep on the semaphore and are woken one per release
+	Ref<Mutex> ownerMutex;
+	Ref<Semaphore> ownerReleased;
+	int ownerWaiters = 0;
+#endif
+	uint64_t owner = 0;
+	int ownerDepth = 0;
+
+	// Registry references freed while another thread held the state, the owner frees them on release. Guarded by ownerMutex.
+	Vector<int> pendingUnrefs;
+
+	// LuaTasks waiting for the worker running this state's tasks and its pool task id, -1 while none runs.
+	// Guarded by ownerMutex.
+	List<LuaTask *> tasks;
+	int64_t taskWorker = -1;
+
+#ifndef LAPI_GDEXTENSION
+	inline BinaryMutex &getOwnerMutex() {
+		return ownerMutex;
+	}
+#else
+	inline Mutex &getOwnerMutex() {
+		return *ownerMutex.ptr();
+	}
+#endif
+
+	String modulePath = LAPI_DEFAULT_MODULE_PATH;
+
+	// Backend of states created from now on
+	static AllocatorType defaultAllocator;
 
 	LuaError *execute(int handlerIndex);
+	void freePendingRefs();
+	LuaTask *nextTask(int64_t &worker);
+};
+
+// Holds LuaAPI::lock() for a scope. Entry points return LuaAPI::newBusyError() when another thread uses the state.
+// The memory limit is off while held, so an entry point reached from a callback of a protected call can't make lua panic.
+class LuaStateLock {
+public:
+	inline LuaStateLock(LuaAPI *api, bool wait = false) :
+			api(api) {
+		locked = api->lock(wait);
+		if (locked) {
+			enforcing = api->setEnforcingLimit(false);
+		}
+	}
+
+	inline ~LuaStateLock() {
+		if (locked) {
+			api->setEnforcingLimit(enforcing);
+			api->unlock();
+		}
+	}
+
+	inline bool isLocked() const {
+		return locked;
+	}
+
+private:
+	LuaAPI *api;
+	bool locked;
+	bool enforcing = false;
 };
 
 VARIANT_ENUM_CAST(LuaAPI::HookMask)
+VARIANT_ENUM_CAST(LuaAPI::AllocatorType)
 VARIANT_ENUM_CAST(LuaAPI::GCOption)
 
 #endif
@@ -0,0 +1,123 @@
+#include "luaBytecode.h"
+
+#include <luaState.h>
+
+#ifndef LAPI_GDEXTENSION
+#include "core/io/file_access.h"
+#include "core/io/resource_loader.h"
+#else
+#include <godot_cpp/classes/file_access.hpp>
+#include <godot_cpp/classes/resource_loader.hpp>
+#endif
+
+#include <string.h>
+
+void LuaBytecode::_bind_methods() {
+	ClassDB::bind_static_method("LuaBytecode", D_METHOD("compile", "Code", "ChunkName", "Strip"), &LuaBytecode::compile, DEFVAL(false));
+	ClassDB::bind_static_method("LuaBytecode", D_METHOD("get_vm_name"), &LuaBytecode::getVMName);
+
+	ClassDB::bind_method(D_METHOD("set_bytecode", "value"), &LuaBytecode::setBytecode);
+	ClassDB::bind_method(D_METHOD("get_bytecode"), &LuaBytecode::getBytecode);
+	ClassDB::bind_method(D_METHOD("set_vm", "value"), &LuaBytecode::setVM);
+	ClassDB::bind_method(D_METHOD("get_vm"), &LuaBytecode::getVM);
+	ClassDB::bind_method(D_METHOD("set_source_hash", "value"), &LuaBytecode::setSourceHash);
+	ClassDB::bind_method(D_METHOD("get_source_hash"), &LuaBytecode::getSourceHash);
+	ClassDB::bind_method(D_METHOD("is_compatible"), &LuaBytecode::isCompatible);
+
+	ADD_PROPERTY(PropertyInfo(Variant::PACKED_BYTE_ARRAY, "bytecode"), "set_bytecode", "get_bytecode");
+	ADD_PROPERTY(PropertyInfo(Variant::STRING, "vm"), "set_vm", "get_vm");
+	ADD_PROPERTY(PropertyInfo(Variant::STRING, "source_hash"), "set_source_hash", "get_source_hash");
+}
+
+static int writeBytecode(lua_State *state, const void *p, size_t sz, void *ud) {
+	PackedByteArray *bytes = (PackedByteArray *)ud;
+	int64_t offset = bytes->size();
+	bytes->resize(offset + sz);
+	memcpy(bytes->ptrw() + offset, p, sz);
+	return 0;
+}
+
+// Compiles code in a scratch state. Returns a LuaBytecode, or a LuaError if the code does not parse.
+Variant LuaBytecode::compile(String code, String chunkName, bool strip) {
+	lua_State *state = luaL_newstate();
+	CharString utf8 = code.utf8();
+	CharString name = chunkName.utf8();
+	int ret = luaL_loadbuffer(state, utf8.get_data(), utf8.length(), name.get_data());
+	if (ret != LUA_OK) {
+		LuaError *err = LuaState::handleError(state, ret);
+		lua_close(state);
+		return err;
+	}
+
+	Ref<LuaBytecode> bytecode = dump(state, strip);
+	lua_close(state);
+	bytecode->sourceHash = code.md5_text();
+	return bytecode;
+}
+
+// Dumps the function on the top of the stack without popping it
+Ref<LuaBytecode> LuaBytecode::dump(lua_State *state, bool strip) {
+	Ref<LuaBytecode> bytecode;
+	bytecode.instantiate();
+#ifndef LAPI_LUAJIT
+	lua_dump(state, writeBytecode, &bytecode->bytecode, strip);
+#else
+	// LuaJIT's lua_dump always keeps debug info
+	lua_dump(state, writeBytecode, &bytecode->bytecode);
+#endif
+	bytecode->vm = getVMName();
+	return bytecode;
+}
+
+// Returns the bytecode path was imported as, if it exists, is up to date and can be loaded by this VM.
+Ref<LuaBytecode> LuaBytecode::loadImported(const String &path) {
+	if (!path.begins_with("res://")) {
+		return Ref<LuaBytecode>();
+	}
+
+#ifndef LAPI_GDEXTENSION
+	if (!ResourceLoader::exists(path, "LuaBytecode")) {
+		return Ref<LuaBytecode>();
+	}
+	Ref<LuaBytecode> bytecode = ResourceLoader::load(path, "LuaBytecode");
+#else
+	if (!ResourceLoader::get_singleton()->exists(path, "LuaBytecode")) {
+		return Ref<LuaBytecode>();
+	}
+	// blame this on https://github.com/godotengine/godot-cpp/issues/995
+	Ref<Resource> res = ResourceLoader::get_singleton()->load(path, "LuaBytecode");
+	Ref<LuaBytecode> bytecode = dynamic_cast<LuaBytecode *>(res.ptr());
+#endif
+	if (bytecode.is_null() || !bytecode->isCompatible()) {
+		return Ref<LuaBytecode>();
+	}
+
+	// Exported projects usually don't ship the source, when it is there it must not have changed since the import
+#ifndef LAPI_GDEXTENSION
+	bool hasSource = FileAccess::exists(path);
+#else
+	bool hasSource = FileAccess::file_exists(path);
+#endif
+	if (!bytecode->sourceHash.is_empty() && hasSource && FileAccess::get_md5(path) != bytecode->sourceHash) {
+		return Ref<LuaBytecode>();
+	}
+	return bytecode;
+}
+
+String LuaBytecode::getVMName() {
+#ifndef LAPI_LUAJIT
+	return LUA_RELEASE;
+#else
+	return LUAJIT_VERSION;
+#endif
+}
+
+// Pushes the compiled chunk onto the stack
+LuaError *LuaBytecode::load(lua_State *state, const String &chunkName) const {
+	CharString name = chunkName.utf8();
+	int ret = luaL_loadbuffer(state, (const char *)bytecode.ptr(), bytecode.size(), name.get_data());
+	if (ret != LUA_OK) {
+		return LuaState::handleError(state, ret);
+	}
+	return nullptr;
+}
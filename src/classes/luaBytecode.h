@@ -0,0 +1,70 @@
+#ifndef LUABYTECODE_H
+#define LUABYTECODE_H
+
+#ifndef LAPI_GDEXTENSION
+#include "core/core_bind.h"
+#include "core/io/resource.h"
+#else
+#include <godot_cpp/classes/resource.hpp>
+#endif
+
+#include "luaError.h"
+
+#include <lua/lua.hpp>
+
+#ifdef LAPI_GDEXTENSION
+using namespace godot;
+#endif
+
+// A chunk precompiled with lua_dump. .lua files are imported as one, do_file and load_file use it instead of parsing the source.
+// Bytecode is only loadable by the VM that produced it, vm records which one that was.
+class LuaBytecode : public Resource {
+	GDCLASS(LuaBytecode, Resource);
+
+protected:
+	static void _bind_methods();
+
+public:
+	static Variant compile(String code, String chunkName, bool strip);
+	static Ref<LuaBytecode> dump(lua_State *state, bool strip);
+	static Ref<LuaBytecode> loadImported(const String &path);
+	static String getVMName();
+
+	LuaError *load(lua_State *state, const String &chunkName) const;
+
+	inline void setBytecode(PackedByteArray value) {
+		bytecode = value;
+	}
+
+	inline PackedByteArray getBytecode() const {
+		return bytecode;
+	}
+
+	inline void setVM(String value) {
+		vm = value;
+	}
+
+	inline String getVM() const {
+		return vm;
+	}
+
+	inline void setSourceHash(String value) {
+		sourceHash = value;
+	}
+
+	inline String getSourceHash() const {
+		return sourceHash;
+	}
+
+	inline bool isCompatible() const {
+		return vm == getVMName();
+	}
+
+private:
+	PackedByteArray bytecode;
+	String vm;
+	// md5 of the source file, lets a stale import be detected while the source is around
+	String sourceHash;
+};
+
+#endif
@@ -1,6 +1,7 @@
 #include "luaCallableExtra.h"
 
 #include "luaAPI.h"
+#include "luaFunction.h"
 #include "luaTuple.h"
 
 #include <luaState.h>
@@ -72,7 +73,7 @@ int LuaCallableExtra::call(lua_State *state) {
 	LuaCallableExtra *func = (LuaCallableExtra *)LuaState::getVariant(state, 1, api).operator Object *();
 	if (func == nullptr) {
 		LuaError *err = LuaError::newError("Error during LuaCallableExtra::call func==null", LuaError::ERR_RUNTIME);
-		lua_pushstring(state, err->getMessage().ascii().get_data());
+		LuaState::pushString(state, err->getMessage());
 		lua_error(state);
 		return 0;
 	}
@@ -111,9 +112,12 @@ int LuaCallableExtra::call(lua_State *state) {
 #ifndef LAPI_GDEXTENSION
 	Callable::CallError error;
 	func->function.callp(p_args, args.size(), returned, error);
+	while (LuaFunction::isCallableMismatch(error, args.size()) && LuaFunction::toCallableArgument(args[error.argument])) {
+		func->function.callp(p_args, args.size(), returned, error);
+	}
 	if (error.error != error.CALL_OK) {
 		LuaError *err = LuaState::handleError(func->function.get_method(), error, p_args, args.size());
-		lua_pushstring(state, err->getMessage().ascii().get_data());
+		LuaState::pushString(state, err->getMessage());
 		lua_error(state);
 		return 0;
 	}
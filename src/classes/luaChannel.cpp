@@ -0,0 +1,173 @@
+#include "luaChannel.h"
+
+#include <luaSerializer.h>
+#include <luaState.h>
+
+void LuaChannel::_bind_methods() {
+	ClassDB::bind_method(D_METHOD("setup", "Capacity"), &LuaChannel::setup);
+	ClassDB::bind_method(D_METHOD("send", "Value"), &LuaChannel::send);
+	ClassDB::bind_method(D_METHOD("try_recv"), &LuaChannel::tryRecv);
+	ClassDB::bind_method(D_METHOD("get_capacity"), &LuaChannel::getCapacity);
+	ClassDB::bind_method(D_METHOD("get_count"), &LuaChannel::getCount);
+}
+
+LuaChannel::LuaChannel() {
+	setup(LAPI_CHANNEL_DEFAULT_CAPACITY);
+}
+
+LuaChannel::~LuaChannel() {
+	memdelete_arr(cells);
+}
+
+// Drops every queued message and makes room for capacity, rounded up to a power of 2.
+// Must not be called while other threads use the channel.
+void LuaChannel::setup(int capacity) {
+	uint64_t size = 2;
+	while (size < (uint64_t)capacity) {
+		size <<= 1;
+	}
+
+	if (cells != nullptr) {
+		memdelete_arr(cells);
+	}
+	cells = memnew_arr(Cell, size);
+	mask = size - 1;
+	for (uint64_t i = 0; i < size; i++) {
+		cells[i].sequence.store(i, std::memory_order_relaxed);
+	}
+	sendPosition.store(0, std::memory_order_relaxed);
+	recvPosition.store(0, std::memory_order_release);
+}
+
+// Queues a serialized message. Returns false if the channel is full.
+bool LuaChannel::push(const PackedByteArray &message) {
+	uint64_t position = sendPosition.load(std::memory_order_relaxed);
+	Cell *cell;
+	while (true) {
+		cell = &cells[position & mask];
+		int64_t diff = (int64_t)cell->sequence.load(std::memory_order_acquire) - (int64_t)position;
+		if (diff == 0) {
+			if (sendPosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+				break;
+			}
+		} else if (diff < 0) {
+			return false;
+		} else {
+			position = sendPosition.load(std::memory_order_relaxed);
+		}
+	}
+
+	cell->message = message;
+	cell->sequence.store(position + 1, std::memory_order_release);
+	return true;
+}
+
+// Takes the oldest message. Returns false if the channel is empty.
+bool LuaChannel::pop(PackedByteArray &message) {
+	uint64_t position = recvPosition.load(std::memory_order_relaxed);
+	Cell *cell;
+	while (true) {
+		cell = &cells[position & mask];
+		int64_t diff = (int64_t)cell->sequence.load(std::memory_order_acquire) - (int64_t)(position + 1);
+		if (diff == 0) {
+			if (recvPosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+				break;
+			}
+		} else if (diff < 0) {
+			return false;
+		} else {
+			position = recvPosition.load(std::memory_order_relaxed);
+		}
+	}
+
+	message = cell->message;
+	cell->message = PackedByteArray();
+	cell->sequence.store(position + mask + 1, std::memory_order_release);
+	return true;
+}
+
+// The number of queued messages, only exact while no other thread uses the channel
+int LuaChannel::getCount() const {
+	uint64_t recv = recvPosition.load(std::memory_order_relaxed);
+	uint64_t sent = sendPosition.load(std::memory_order_relaxed);
+	return sent > recv ? (int)(sent - recv) : 0;
+}
+
+// Sends a Variant as Lua would receive it. Returns false if the channel is full.
+bool LuaChannel::send(Variant value) {
+	PackedByteArray message;
+	LuaError *err = LuaSerializer::serializeVariant(value, message);
+	if (err != nullptr) {
+		String msg = err->getMessage();
+		memdelete(err);
+		ERR_FAIL_V_MSG(false, msg);
+	}
+	return push(message);
+}
+
+// Returns the oldest message, or null if the channel is empty
+Variant LuaChannel::tryRecv() {
+	PackedByteArray message;
+	if (!pop(message)) {
+		return Variant();
+	}
+
+	Variant value;
+	LuaError *err = LuaSerializer::deserializeVariant(message.ptr(), message.size(), value);
+	if (err != nullptr) {
+		return err;
+	}
+	return value;
+}
+
+// Returns the channel of the mt_Channel userdata at index 1, raises an error otherwise
+static LuaChannel *checkChannel(lua_State *state) {
+	Variant *userdata = (Variant *)LuaState::testUserdata(state, 1, METATABLE_CHANNEL);
+	if (userdata == nullptr) {
+		luaL_argerror(state, 1, "LuaChannel expected");
+	}
+	return (LuaChannel *)userdata->operator Object *();
+}
+
+// channel:send(value) -> boolean, false if the channel is full
+int LuaChannel::luaSend(lua_State *state) {
+	LuaChannel *channel = checkChannel(state);
+	lua_settop(state, 2);
+
+	// The error is raised outside of the scope, the message buffer must be freed first
+	{
+		PackedByteArray message;
+		LuaError *err = LuaSerializer::serialize(state, 2, message);
+		if (err == nullptr) {
+			lua_pushboolean(state, channel->push(message));
+			return 1;
+		}
+
+		LuaState::pushString(state, err->getMessage());
+		memdelete(err);
+	}
+	return lua_error(state);
+}
+
+// channel:try_recv() -> false if the channel is empty, true and the message otherwise
+int LuaChannel::luaTryRecv(lua_State *state) {
+	LuaChannel *channel = checkChannel(state);
+
+	{
+		PackedByteArray message;
+		if (!channel->pop(message)) {
+			lua_pushboolean(state, false);
+			return 1;
+		}
+
+		lua_pushboolean(state, true);
+		LuaError *err = LuaSerializer::deserialize(state, message.ptr(), message.size());
+		if (err == nullptr) {
+			return 2;
+		}
+
+		LuaState::pushString(state, err->getMessage());
+		memdelete(err);
+	}
+	return lua_error(state);
+}
@@ -0,0 +1,70 @@
+#ifndef LUACHANNEL_H
+#define LUACHANNEL_H
+
+#ifndef LAPI_GDEXTENSION
+#include "core/core_bind.h"
+#include "core/object/ref_counted.h"
+#include "core/variant/variant.h"
+#else
+#include <godot_cpp/classes/ref.hpp>
+#include <godot_cpp/variant/packed_byte_array.hpp>
+#endif
+
+#include <lua/lua.hpp>
+
+#include <atomic>
+
+#ifdef LAPI_GDEXTENSION
+using namespace godot;
+#endif
+
+#define LAPI_CHANNEL_DEFAULT_CAPACITY 64
+
+// A bounded queue of serialized values which any number of threads can send to and receive from without locking.
+// Pushed into a LuaAPI it becomes a userdata with native send and try_recv methods, so Lua values go through
+// LuaSerializer without becoming Variants. GDScript can use the same channel with Variants.
+class LuaChannel : public RefCounted {
+	GDCLASS(LuaChannel, RefCounted);
+
+protected:
+	static void _bind_methods();
+
+public:
+	LuaChannel();
+	~LuaChannel();
+
+	void setup(int capacity);
+
+	bool push(const PackedByteArray &message);
+	bool pop(PackedByteArray &message);
+
+	bool send(Variant value);
+	Variant tryRecv();
+
+	inline int getCapacity() const {
+		return (int)(mask + 1);
+	}
+
+	int getCount() const;
+
+	static int luaSend(lua_State *state);
+	static int luaTryRecv(lua_State *state);
+
+private:
+	// A slot of the ring. sequence says whether the slot is ready to be written or read for a given position,
+	// see Dmitry Vyukov's bounded MPMC queue.
+	struct Cell {
+		std::atomic<uint64_t> sequence;
+		PackedByteArray message;
+	};
+
+	Cell *cells = nullptr;
+	uint64_t mask = 0;
+
+	// Padded apart so senders and receivers don't contend on the same cache line
+	std::atomic<uint64_t> sendPosition;
+	uint8_t padding[64];
+	std::atomic<uint64_t> recvPosition;
+};
+
+#endif
@@ -0,0 +1,74 @@
+#include "luaChunk.h"
+
+#include "luaAPI.h"
+
+#ifdef LAPI_GDEXTENSION
+#include <godot_cpp/core/object.hpp>
+#endif
+
+void LuaChunk::_bind_methods() {
+	ClassDB::bind_method(D_METHOD("get_bytecode"), &LuaChunk::getBytecode);
+	ClassDB::bind_method(D_METHOD("get_name"), &LuaChunk::getName);
+}
+
+LuaChunk::LuaChunk() {
+#ifdef LAPI_GDEXTENSION
+	refsMutex.instantiate();
+#endif
+}
+
+LuaChunk::~LuaChunk() {
+	MutexLock guard(getRefsMutex());
+	for (const KeyValue<uint64_t, int> &entry : refs) {
+#ifndef LAPI_GDEXTENSION
+		LuaAPI *api = Object::cast_to<LuaAPI>(ObjectDB::get_instance(ObjectID(entry.key)));
+#else
+		LuaAPI *api = Object::cast_to<LuaAPI>(ObjectDB::get_instance(entry.key));
+#endif
+		if (api != nullptr) {
+			// A LuaTask may be using the state on another thread, that thread frees the reference then
+			api->releaseRef(entry.value);
+		}
+	}
+}
+
+// Creates a chunk from the function on the top of the stack, which was loaded from bytecode by api. Pops the function.
+Ref<LuaChunk> LuaChunk::fromStack(LuaAPI *api, Ref<LuaBytecode> bytecode, const String &name) {
+	Ref<LuaChunk> chunk;
+	chunk.instantiate();
+	chunk->bytecode = bytecode;
+	chunk->name = name;
+	chunk->setRef(api, luaL_ref(api->getState(), LUA_REGISTRYINDEX));
+	return chunk;
+}
+
+// Pushes the chunk's function onto the stack of api's state, loading the bytecode the first time.
+LuaError *LuaChunk::push(LuaAPI *api) {
+	lua_State *state = api->getState();
+	int ref = getRef(api);
+	if (ref != LUA_NOREF) {
+		lua_rawgeti(state, LUA_REGISTRYINDEX, ref);
+		return nullptr;
+	}
+
+	LuaError *err = bytecode->load(state, name);
+	if (err != nullptr) {
+		return err;
+	}
+
+	lua_pushvalue(state, -1);
+	setRef(api, luaL_ref(state, LUA_REGISTRYINDEX));
+	return nullptr;
+}
+
+// Registry reference of the function loaded in api, LUA_NOREF if it wasn't loaded there yet
+int LuaChunk::getRef(LuaAPI *api) {
+	MutexLock guard(getRefsMutex());
+	const int *ref = refs.getptr((uint64_t)api->get_instance_id());
+	return ref == nullptr ? LUA_NOREF : *ref;
+}
+
+void LuaChunk::setRef(LuaAPI *api, int ref) {
+	MutexLock guard(getRefsMutex());
+	refs.insert((uint64_t)api->get_instance_id(), ref);
+}
@@ -0,0 +1,76 @@
+#ifndef LUACHUNK_H
+#define LUACHUNK_H
+
+#ifndef LAPI_GDEXTENSION
+#include "core/core_bind.h"
+#include "core/object/ref_counted.h"
+#include "core/os/mutex.h"
+#include "core/templates/hash_map.h"
+#else
+#include <godot_cpp/classes/mutex.hpp>
+#include <godot_cpp/classes/ref.hpp>
+#include <godot_cpp/core/mutex_lock.hpp>
+#include <godot_cpp/templates/hash_map.hpp>
+#endif
+
+#include "luaBytecode.h"
+#include "luaError.h"
+
+#include <lua/lua.hpp>
+
+#ifdef LAPI_GDEXTENSION
+using namespace godot;
+#endif
+
+class LuaAPI;
+
+// A chunk parsed once by LuaAPI.compile_string or compile_file, which can be run any number of times in any LuaAPI.
+// Each LuaAPI loads the bytecode the first time it runs the chunk and keeps the function in its registry.
+class LuaChunk : public RefCounted {
+	GDCLASS(LuaChunk, RefCounted);
+
+protected:
+	static void _bind_methods();
+
+public:
+	LuaChunk();
+	~LuaChunk();
+
+	static Ref<LuaChunk> fromStack(LuaAPI *api, Ref<LuaBytecode> bytecode, const String &name);
+
+	LuaError *push(LuaAPI *api);
+
+	inline Ref<LuaBytecode> getBytecode() const {
+		return bytecode;
+	}
+
+	inline String getName() const {
+		return name;
+	}
+
+private:
+	Ref<LuaBytecode> bytecode;
+	String name;
+	// Registry reference of the loaded function, keyed by the instance id of the LuaAPI it was loaded in.
+	// Instance ids aren't reused, so a freed LuaAPI can't be mistaken for a new one.
+	HashMap<uint64_t, int> refs;
+	// Guards refs, the chunk may run in several LuaAPIs on different threads at once
+#ifndef LAPI_GDEXTENSION
+	BinaryMutex refsMutex;
+
+	inline BinaryMutex &getRefsMutex() {
+		return refsMutex;
+	}
+#else
+	Ref<Mutex> refsMutex;
+
+	inline Mutex &getRefsMutex() {
+		return *refsMutex.ptr();
+	}
+#endif
+
+	int getRef(LuaAPI *api);
+	void setRef(LuaAPI *api, int ref);
+};
+
+#endif
@@ -11,6 +11,7 @@
 void LuaCoroutine::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("bind", "lua"), &LuaCoroutine::bind);
 	ClassDB::bind_method(D_METHOD("set_hook", "Hook", "HookMask", "Count"), &LuaCoroutine::setHook);
+	ClassDB::bind_method(D_METHOD("set_execution_limit", "Instructions", "Usec"), &LuaCoroutine::setExecutionLimit);
 	ClassDB::bind_method(D_METHOD("resume", "Args"), &LuaCoroutine::resume);
 	ClassDB::bind_method(D_METHOD("yield_await", "Args"), &LuaCoroutine::yieldAwait);
 	ClassDB::bind_method(D_METHOD("yield_state", "Args"), &LuaCoroutine::yield);
@@ -30,6 +31,9 @@ void LuaCoroutine::_bind_methods() {
 
 // binds the thread to a lua object
 void LuaCoroutine::bind(Ref<LuaAPI> lua) {
+	LuaStateLock lock(lua.ptr());
+	ERR_FAIL_COND_MSG(!lock.isLocked(), "LuaAPI is in use by another thread.");
+
 	parent = lua;
 	tState = lua->newThreadState();
 	state.setState(tState, lua.ptr(), false);
@@ -50,10 +54,21 @@ void LuaCoroutine::bindExisting(Ref<LuaAPI> lua, lua_State *tState) {
 }
 
 void LuaCoroutine::setHook(Callable hook, int mask, int count) {
+	LuaStateLock lock(parent.ptr());
+	ERR_FAIL_COND_MSG(!lock.isLocked(), "LuaAPI is in use by another thread.");
 	return state.setHook(hook, mask, count);
 }
 
+void LuaCoroutine::setExecutionLimit(int64_t instructions, int64_t usec) {
+	LuaStateLock lock(parent.ptr());
+	ERR_FAIL_COND_MSG(!lock.isLocked(), "LuaAPI is in use by another thread.");
+	state.setExecutionLimit(instructions, usec);
+}
+
 Signal LuaCoroutine::yieldAwait(Array args) {
+	LuaStateLock lock(parent.ptr());
+	ERR_FAIL_COND_V_MSG(!lock.isLocked(), Signal(), "LuaAPI is in use by another thread.");
+
 	lua_pop(tState, 1); // Pop function off top of stack.
 	for (int i = 0; i < args.size(); i++) {
 		LuaError *err = state.pushVariant(args[i]);
@@ -67,28 +82,55 @@ Signal LuaCoroutine::yieldAwait(Array args) {
 
 // Calls LuaState::luaFunctionExists()
 bool LuaCoroutine::luaFunctionExists(String functionName) {
+	LuaStateLock lock(parent.ptr());
+	if (!lock.isLocked()) {
+		return false;
+	}
+
 	return state.luaFunctionExists(functionName);
 }
 
 // Calls LuaState::pullVariant()
 Variant LuaCoroutine::pullVariant(String name) {
+	LuaStateLock lock(parent.ptr());
+	if (!lock.isLocked()) {
+		return LuaAPI::newBusyError();
+	}
+
 	return state.pullVariant(name);
 }
 
 // Calls LuaState::pushGlobalVariant()
 LuaError *LuaCoroutine::pushGlobalVariant(String name, Variant var) {
+	LuaStateLock lock(parent.ptr());
+	if (!lock.isLocked()) {
+		return LuaAPI::newBusyError();
+	}
+
 	return state.pushGlobalVariant(name, var);
 }
 
 // Calls LuaState::callFunction()
 Variant LuaCoroutine::callFunction(String functionName, Array args) {
+	LuaStateLock lock(parent.ptr());
+	if (!lock.isLocked()) {
+		return LuaAPI::newBusyError();
+	}
+
 	return state.callFunction(functionName, args);
 }
 
 // loads a string into the threads state
 LuaError *LuaCoroutine::loadString(String code) {
+	LuaStateLock lock(parent.ptr());
+	if (!lock.isLocked()) {
+		return LuaAPI::newBusyError();
+	}
+
 	done = false;
-	int ret = luaL_loadstring(tState, code.ascii().get_data());
+	CharString utf8 = code.utf8();
+	// The code is its own chunk name, the same as luaL_loadstring
+	int ret = luaL_loadbuffer(tState, utf8.get_data(), utf8.length(), utf8.get_data());
 	if (ret != LUA_OK) {
 		return state.handleError(ret);
 	}
@@ -96,38 +138,31 @@ LuaError *LuaCoroutine::loadString(String code) {
 }
 
 LuaError *LuaCoroutine::loadFile(String fileName) {
-#ifndef LAPI_GDEXTENSION
-	done = false;
-	Error error;
-	Ref<FileAccess> file = FileAccess::open(fileName, FileAccess::READ, &error);
-	if (error != Error::OK) {
-		return LuaError::newError(vformat("error '%s' while opening file '%s'", error_names[error], fileName), LuaError::ERR_FILE);
+	LuaStateLock lock(parent.ptr());
+	if (!lock.isLocked()) {
+		return LuaAPI::newBusyError();
 	}
-#else
-	done = false;
-	Ref<FileAccess> file = FileAccess::open(fileName, FileAccess::READ);
-	if (!file.is_valid()) {
-		return LuaError::newError(vformat("error while opening file '%s'", fileName), LuaError::ERR_FILE);
-	}
-#endif
 
-	String path = file->get_path_absolute();
-	int ret = luaL_loadfile(tState, path.ascii().get_data());
-	if (ret != LUA_OK) {
-		return state.handleError(ret);
-	}
-	return nullptr;
+	done = false;
+	return LuaState::loadFile(tState, fileName);
 }
 
 LuaError *LuaCoroutine::yield(Array args) {
-	Array ret;
-	if (int count = lua_gettop(tState); count > 0) {
-		lua_pop(tState, count);
-	}
-	for (int i = 0; i < args.size(); i++) {
-		LuaError *err = state.pushVariant(args[i]);
-		if (err != nullptr) {
-			return err;
+	// lua_yield may not return, the lock has to be released before it
+	{
+		LuaStateLock lock(parent.ptr());
+		if (!lock.isLocked()) {
+			return LuaAPI::newBusyError();
+		}
+
+		if (int count = lua_gettop(tState); count > 0) {
+			lua_pop(tState, count);
+		}
+		for (int i = 0; i < args.size(); i++) {
+			LuaError *err = state.pushVariant(args[i]);
+			if (err != nullptr) {
+				return err;
+			}
 		}
 	}
 
@@ -138,6 +173,11 @@ LuaError *LuaCoroutine::yield(Array args) {
 #ifndef LAPI_GDEXTENSION
 
 Variant LuaCoroutine::resume(Array args) {
+	LuaStateLock lock(parent.ptr());
+	if (!lock.isLocked()) {
+		return LuaAPI::newBusyError();
+	}
+
 	if (done) {
 		return LuaError::newError("Thread is done executing", LuaError::ERR_RUNTIME);
 	}
@@ -176,6 +216,9 @@ Variant LuaCoroutine::resume(Array args) {
 		args.append(returned);
 	}
 
+	// Each resume gets a fresh execution budget
+	LuaExecutionScope scope(&state);
+
 	for (int i = 0; i < args.size(); i++) {
 		LuaError *err = state.pushVariant(args[i]);
 		if (err != nullptr) {
@@ -183,13 +226,18 @@ Variant LuaCoroutine::resume(Array args) {
 		}
 	}
 
+	int ret;
+	int argc;
+	{
+		LuaProtectedScope protect(&state);
 #ifndef LAPI_LUAJIT
-	int argc = 0;
-	int ret = lua_resume(tState, nullptr, args.size(), &argc);
+		argc = 0;
+		ret = lua_resume(tState, nullptr, args.size(), &argc);
 #else
-	int ret = lua_resume(tState, args.size());
-	int argc = lua_gettop(tState);
+		ret = lua_resume(tState, args.size());
+		argc = lua_gettop(tState);
 #endif
+	}
 
 	if (ret == LUA_OK) {
 		done = true; // thread is finished
@@ -209,6 +257,11 @@ Variant LuaCoroutine::resume(Array args) {
 #else
 
 Variant LuaCoroutine::resume(Array args) {
+	LuaStateLock lock(parent.ptr());
+	if (!lock.isLocked()) {
+		return LuaAPI::newBusyError();
+	}
+
 	if (done) {
 		return LuaError::newError("Thread is done executing", LuaError::ERR_RUNTIME);
 	}
@@ -232,6 +285,9 @@ Variant LuaCoroutine::resume(Array args) {
 		args.append(returned);
 	}
 
+	// Each resume gets a fresh execution budget
+	LuaExecutionScope scope(&state);
+
 	for (int i = 0; i < args.size(); i++) {
 		LuaError *err = state.pushVariant(args[i]);
 		if (err != nullptr) {
@@ -239,13 +295,18 @@ Variant LuaCoroutine::resume(Array args) {
 		}
 	}
 
+	int ret;
+	int argc;
+	{
+		LuaProtectedScope protect(&state);
 #ifndef LAPI_LUAJIT
-	int argc = 0;
-	int ret = lua_resume(tState, nullptr, args.size(), &argc);
+		argc = 0;
+		ret = lua_resume(tState, nullptr, args.size(), &argc);
 #else
-	int ret = lua_resume(tState, args.size());
-	int argc = lua_gettop(tState);
+		ret = lua_resume(tState, args.size());
+		argc = lua_gettop(tState);
 #endif
+	}
 
 	if (ret == LUA_OK) {
 		done = true; // thread is finished
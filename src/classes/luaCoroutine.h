@@ -29,6 +29,7 @@ public:
 	void bind(Ref<LuaAPI> lua);
 	void bindExisting(Ref<LuaAPI> lua, lua_State *tState);
 	void setHook(Callable hook, int mask, int count);
+	void setExecutionLimit(int64_t instructions, int64_t usec);
 
 	Signal yieldAwait(Array args);
 
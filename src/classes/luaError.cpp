@@ -18,6 +18,7 @@ void LuaError::_bind_methods() {
 	BIND_ENUM_CONSTANT(ERR_MEMORY);
 	BIND_ENUM_CONSTANT(ERR_ERR);
 	BIND_ENUM_CONSTANT(ERR_FILE);
+	BIND_ENUM_CONSTANT(ERR_EXECUTION_LIMIT);
 }
 
 // Create a new error
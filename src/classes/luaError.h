@@ -28,6 +28,7 @@ public:
 		ERR_MEMORY = LUA_ERRMEM,
 		ERR_ERR = LUA_ERRERR,
 		ERR_FILE = LUA_ERRFILE,
+		ERR_EXECUTION_LIMIT = LUA_ERRFILE + 1,
 	};
 	static LuaError *newError(String msg, ErrorType type);
 
@@ -0,0 +1,217 @@
+#include "luaFunction.h"
+
+#include "luaAPI.h"
+#include "luaTuple.h"
+
+#include <luaState.h>
+
+#ifdef LAPI_GDEXTENSION
+#include <godot_cpp/core/object.hpp>
+#endif
+
+void LuaFunction::_bind_methods() {
+	ClassDB::bind_vararg_method(METHOD_FLAGS_DEFAULT, "invoke", &LuaFunction::invoke, MethodInfo("invoke"));
+	ClassDB::bind_method(D_METHOD("invokev", "Args"), &LuaFunction::invokev);
+	ClassDB::bind_method(D_METHOD("invokev_tuple", "Args"), &LuaFunction::invokevTuple);
+	ClassDB::bind_vararg_method(METHOD_FLAGS_DEFAULT, "invoke_callable", &LuaFunction::invokeCallable, MethodInfo("invoke_callable"));
+	ClassDB::bind_method(D_METHOD("to_callable"), &LuaFunction::toCallable);
+}
+
+LuaFunction::~LuaFunction() {
+	if (ref == LUA_NOREF) {
+		return;
+	}
+
+	// The state is already closed if the LuaAPI is gone
+	Ref<LuaAPI> api = getAPI();
+	if (api.is_null()) {
+		return;
+	}
+
+	// A LuaTask may be using the state on another thread, that thread frees the reference then
+	api->clearFunctionRef(pointer, this);
+	api->releaseRef(ref);
+}
+
+// Returns the handle for the function at index. Pulling the same function again returns the same handle.
+Ref<LuaFunction> LuaFunction::fromStack(LuaAPI *api, lua_State *state, int index) {
+	const void *pointer = lua_topointer(state, index);
+	// Empty if there is none or it is being freed
+	if (Ref<LuaFunction> existing = api->getFunctionRef(pointer); existing.is_valid()) {
+		return existing;
+	}
+
+	Ref<LuaFunction> func;
+	func.instantiate();
+	func->apiID = (uint64_t)api->get_instance_id();
+	func->pointer = pointer;
+
+	lua_pushvalue(state, index);
+	func->ref = luaL_ref(state, LUA_REGISTRYINDEX);
+	api->setFunctionRef(pointer, func.ptr());
+	return func;
+}
+
+#ifndef LAPI_GDEXTENSION
+Variant LuaFunction::invoke(const Variant **p_args, int p_argcount, Callable::CallError &r_error) {
+	r_error.error = Callable::CallError::CALL_OK;
+#else
+Variant LuaFunction::invoke(const Variant **p_args, GDExtensionInt p_argcount, GDExtensionCallError &r_error) {
+	r_error.error = GDEXTENSION_CALL_OK;
+#endif
+	Ref<LuaAPI> api = getAPI();
+	if (api.is_null()) {
+		return LuaError::newError("the LuaAPI this function was pulled from has been freed.", LuaError::ERR_RUNTIME);
+	}
+
+	LuaStateLock lock(api.ptr());
+	if (!lock.isLocked()) {
+		return LuaAPI::newBusyError();
+	}
+
+	LuaExecutionScope scope(api->getMainState());
+	lua_State *state = api->getState();
+	lua_pushcfunction(state, LuaState::luaErrorHandler);
+	lua_rawgeti(state, LUA_REGISTRYINDEX, ref);
+
+	for (int i = 0; i < p_argcount; i++) {
+		LuaState::pushVariant(state, *p_args[i]);
+	}
+
+	return pcall(api.ptr(), state, p_argcount);
+}
+
+Variant LuaFunction::invokev(Array args) {
+	Ref<LuaAPI> api = getAPI();
+	if (api.is_null()) {
+		return LuaError::newError("the LuaAPI this function was pulled from has been freed.", LuaError::ERR_RUNTIME);
+	}
+
+	LuaStateLock lock(api.ptr());
+	if (!lock.isLocked()) {
+		return LuaAPI::newBusyError();
+	}
+
+	LuaExecutionScope scope(api->getMainState());
+	lua_State *state = api->getState();
+	lua_pushcfunction(state, LuaState::luaErrorHandler);
+	lua_rawgeti(state, LUA_REGISTRYINDEX, ref);
+
+	for (int i = 0; i < args.size(); i++) {
+		LuaState::pushVariant(state, args[i]);
+	}
+
+	return pcall(api.ptr(), state, args.size());
+}
+
+// Like invokev, but returns every value the function returns as a LuaTuple
+Variant LuaFunction::invokevTuple(Array args) {
+	Ref<LuaAPI> api = getAPI();
+	if (api.is_null()) {
+		return LuaError::newError("the LuaAPI this function was pulled from has been freed.", LuaError::ERR_RUNTIME);
+	}
+
+	LuaStateLock lock(api.ptr());
+	if (!lock.isLocked()) {
+		return LuaAPI::newBusyError();
+	}
+
+	LuaExecutionScope scope(api->getMainState());
+	lua_State *state = api->getState();
+	lua_pushcfunction(state, LuaState::luaErrorHandler);
+	lua_rawgeti(state, LUA_REGISTRYINDEX, ref);
+
+	for (int i = 0; i < args.size(); i++) {
+		LuaState::pushVariant(state, args[i]);
+	}
+
+	Array results;
+	LuaError *err = LuaState::pcallMulti(state, args.size(), results, api.ptr());
+	if (err != nullptr) {
+		return err;
+	}
+	return LuaTuple::fromArray(results);
+}
+
+// Calls the function below the argc arguments on the top of the stack, the error handler must be below the function.
+// Leaves the stack as it was before the error handler was pushed.
+Variant LuaFunction::pcall(LuaAPI *api, lua_State *state, int argc) {
+	Variant toReturn;
+	int ret;
+	{
+		LuaProtectedScope protect(api->getMainState());
+		ret = lua_pcall(state, argc, 1, -2 - argc);
+	}
+	if (ret != LUA_OK) {
+		toReturn = LuaState::handleError(state, ret);
+	} else {
+		toReturn = LuaState::getVariant(state, -1, api);
+		lua_pop(state, 1);
+	}
+
+	// pop the error handler
+	lua_pop(state, 1);
+	return toReturn;
+}
+
+// Target of the Callable returned by toCallable. The last argument is the handle itself, bound to keep it alive.
+#ifndef LAPI_GDEXTENSION
+Variant LuaFunction::invokeCallable(const Variant **p_args, int p_argcount, Callable::CallError &r_error) {
+#else
+Variant LuaFunction::invokeCallable(const Variant **p_args, GDExtensionInt p_argcount, GDExtensionCallError &r_error) {
+#endif
+	return invoke(p_args, MAX(p_argcount - 1, 0), r_error);
+}
+
+// Returns a Callable calling the function. A Callable only holds its object's id, so the handle is bound to it as an argument.
+Callable LuaFunction::toCallable() {
+	Array binds;
+	binds.push_back(Ref<LuaFunction>(this));
+	return Callable(this, "invoke_callable").bindv(binds);
+}
+
+#ifndef LAPI_GDEXTENSION
+bool LuaFunction::isCallableMismatch(const Callable::CallError &error, int argc) {
+	return error.error == Callable::CallError::CALL_ERROR_INVALID_ARGUMENT && error.expected == Variant::CALLABLE && error.argument < argc;
+}
+#else
+bool LuaFunction::isCallableMismatch(const GDExtensionCallError &error, int argc) {
+	return error.error == GDEXTENSION_CALL_ERROR_INVALID_ARGUMENT && error.expected == Variant::CALLABLE && error.argument < argc;
+}
+#endif
+
+bool LuaFunction::toCallableArgument(Variant &arg) {
+	if (arg.get_type() != Variant::OBJECT) {
+		return false;
+	}
+
+#ifndef LAPI_GDEXTENSION
+	LuaFunction *func = Object::cast_to<LuaFunction>(arg.operator Object *());
+#else
+	// blame this on https://github.com/godotengine/godot-cpp/issues/995
+	LuaFunction *func = dynamic_cast<LuaFunction *>(arg.operator Object *());
+#endif
+	if (func == nullptr) {
+		return false;
+	}
+
+	arg = func->toCallable();
+	return true;
+}
+
+// Returns the LuaAPI the function belongs to, or null once it has been freed.
+Ref<LuaAPI> LuaFunction::getAPI() const {
+#ifndef LAPI_GDEXTENSION
+	return Ref<LuaAPI>(Object::cast_to<LuaAPI>(ObjectDB::get_instance(ObjectID(apiID))));
+#else
+	return Ref<LuaAPI>(Object::cast_to<LuaAPI>(ObjectDB::get_instance(apiID)));
+#endif
+}
+
+bool LuaFunction::belongsTo(LuaAPI *lua) const {
+	return lua != nullptr && apiID == (uint64_t)lua->get_instance_id();
+}
+
+int LuaFunction::getRef() const {
+	return ref;
+}
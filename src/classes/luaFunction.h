@@ -0,0 +1,69 @@
+#ifndef LUAFUNCTION_H
+#define LUAFUNCTION_H
+
+#ifndef LAPI_GDEXTENSION
+#include "core/core_bind.h"
+#include "core/object/ref_counted.h"
+#else
+#include <godot_cpp/classes/ref.hpp>
+#endif
+
+#include <lua/lua.hpp>
+
+#ifdef LAPI_GDEXTENSION
+using namespace godot;
+#endif
+
+class LuaAPI;
+
+// A handle to a lua function. Owns a registry reference which is released when the handle is freed.
+// The handle only holds the LuaAPI's id, an object storing it does not keep the state alive.
+class LuaFunction : public RefCounted {
+	GDCLASS(LuaFunction, RefCounted);
+
+protected:
+	static void _bind_methods();
+
+public:
+	~LuaFunction();
+
+	static Ref<LuaFunction> fromStack(LuaAPI *api, lua_State *state, int index);
+
+#ifndef LAPI_GDEXTENSION
+	Variant invoke(const Variant **p_args, int p_argcount, Callable::CallError &r_error);
+#else
+	Variant invoke(const Variant **p_args, GDExtensionInt p_argcount, GDExtensionCallError &r_error);
+#endif
+	Variant invokev(Array args);
+	Variant invokevTuple(Array args);
+
+#ifndef LAPI_GDEXTENSION
+	Variant invokeCallable(const Variant **p_args, int p_argcount, Callable::CallError &r_error);
+#else
+	Variant invokeCallable(const Variant **p_args, GDExtensionInt p_argcount, GDExtensionCallError &r_error);
+#endif
+	Callable toCallable();
+
+	// Lua functions reach Godot as LuaFunction handles. When a call fails because a parameter is typed Callable,
+	// the caller replaces the argument with the handle's Callable and calls again.
+#ifndef LAPI_GDEXTENSION
+	static bool isCallableMismatch(const Callable::CallError &error, int argc);
+#else
+	static bool isCallableMismatch(const GDExtensionCallError &error, int argc);
+#endif
+	// Replaces arg with its Callable if it holds a LuaFunction. Returns true if it did.
+	static bool toCallableArgument(Variant &arg);
+
+	Ref<LuaAPI> getAPI() const;
+	bool belongsTo(LuaAPI *lua) const;
+	int getRef() const;
+
+private:
+	uint64_t apiID = 0;
+	int ref = LUA_NOREF;
+	const void *pointer = nullptr;
+
+	Variant pcall(LuaAPI *api, lua_State *state, int argc);
+};
+
+#endif
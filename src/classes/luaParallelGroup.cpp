@@ -0,0 +1,172 @@
+#include "luaParallelGroup.h"
+
+#include "luaChunk.h"
+
+#ifndef LAPI_GDEXTENSION
+#include "core/object/worker_thread_pool.h"
+#include "core/os/os.h"
+#else
+#include <godot_cpp/classes/os.hpp>
+#include <godot_cpp/classes/worker_thread_pool.hpp>
+#endif
+
+void LuaParallelGroup::_bind_methods() {
+	ClassDB::bind_method(D_METHOD("setup", "Size", "Libraries"), &LuaParallelGroup::setup);
+	ClassDB::bind_method(D_METHOD("do_string", "Code"), &LuaParallelGroup::doString);
+	ClassDB::bind_method(D_METHOD("do_file", "FilePath"), &LuaParallelGroup::doFile);
+	ClassDB::bind_method(D_METHOD("push_variant", "Name", "var"), &LuaParallelGroup::pushGlobalVariant);
+	ClassDB::bind_method(D_METHOD("call_function", "LuaFunctionName", "ArgSets"), &LuaParallelGroup::callFunction);
+	ClassDB::bind_method(D_METHOD("get_size"), &LuaParallelGroup::getSize);
+	ClassDB::bind_method(D_METHOD("get_state", "Index"), &LuaParallelGroup::getState);
+
+	// Only bound so it can be used as a callable, it is not part of the API
+	ClassDB::bind_method(D_METHOD("_run_partition", "Index"), &LuaParallelGroup::_runPartition);
+}
+
+// Drops the current states and creates size new ones with libraries bound. A size of 0 or less uses one state per core.
+void LuaParallelGroup::setup(int size, Array libraries) {
+	if (size <= 0) {
+		size = OS::get_singleton()->get_processor_count();
+	}
+
+	states.clear();
+	for (int i = 0; i < size; i++) {
+		Ref<LuaAPI> lua;
+		lua.instantiate();
+		lua->bindLibraries(libraries);
+		states.push_back(lua);
+	}
+}
+
+// Parses the code once and runs it in every state. Returns the first error.
+LuaError *LuaParallelGroup::doString(String code) {
+	if (states.is_empty()) {
+		return LuaError::newError("LuaParallelGroup has no states, call setup first", LuaError::ERR_RUNTIME);
+	}
+	return runEverywhere(states[0]->compileString(code));
+}
+
+// Loads the file once and runs it in every state. Returns the first error.
+LuaError *LuaParallelGroup::doFile(String fileName) {
+	if (states.is_empty()) {
+		return LuaError::newError("LuaParallelGroup has no states, call setup first", LuaError::ERR_RUNTIME);
+	}
+	return runEverywhere(states[0]->compileFile(fileName));
+}
+
+// Pushes the variant as a global of every state. Returns the first error.
+LuaError *LuaParallelGroup::pushGlobalVariant(String name, Variant var) {
+	for (int i = 0; i < states.size(); i++) {
+		LuaError *err = states[i]->pushGlobalVariant(name, var);
+		if (err != nullptr) {
+			return err;
+		}
+	}
+	return nullptr;
+}
+
+Ref<LuaAPI> LuaParallelGroup::getState(int index) const {
+	ERR_FAIL_INDEX_V(index, states.size(), Ref<LuaAPI>());
+	return states[index];
+}
+
+// Calls the function once per argument set and returns the results in the same order. argSets is an Array whose
+// elements are Arrays of arguments or single arguments, or a packed array of single arguments.
+// A call which fails has its LuaError as result.
+Array LuaParallelGroup::callFunction(String functionName, Variant argSets) {
+	Array results;
+	if (states.is_empty()) {
+		results.append(LuaError::newError("LuaParallelGroup has no states, call setup first", LuaError::ERR_RUNTIME));
+		return results;
+	}
+	if (batchResults != nullptr) {
+		results.append(LuaError::newError("LuaParallelGroup is already running a batch", LuaError::ERR_RUNTIME));
+		return results;
+	}
+
+	switch (argSets.get_type()) {
+		case Variant::ARRAY:
+			batchArgs = argSets;
+			break;
+		case Variant::PACKED_INT32_ARRAY:
+		case Variant::PACKED_INT64_ARRAY:
+		case Variant::PACKED_FLOAT32_ARRAY:
+		case Variant::PACKED_FLOAT64_ARRAY:
+		case Variant::PACKED_STRING_ARRAY:
+		case Variant::PACKED_VECTOR2_ARRAY:
+		case Variant::PACKED_VECTOR3_ARRAY:
+		case Variant::PACKED_COLOR_ARRAY: {
+			// Read every element once here so the workers don't touch the packed array
+			batchArgs = Array();
+			int count = argSets.call("size");
+			batchArgs.resize(count);
+			for (int i = 0; i < count; i++) {
+				batchArgs[i] = argSets.get(i);
+			}
+			break;
+		}
+		default:
+			results.append(LuaError::newError("ArgSets must be an Array or a packed array", LuaError::ERR_TYPE));
+			return results;
+	}
+
+	int count = batchArgs.size();
+	if (count == 0) {
+		return results;
+	}
+
+	// Every worker writes its own part of the results, so they never share a Variant
+	Vector<Variant> output;
+	output.resize(count);
+	batchResults = output.ptrw();
+	batchFunction = functionName;
+
+	int partitions = MIN(states.size(), count);
+	batchPartitionSize = (count + partitions - 1) / partitions;
+	partitions = (count + batchPartitionSize - 1) / batchPartitionSize;
+
+	WorkerThreadPool *pool = WorkerThreadPool::get_singleton();
+	int64_t group = pool->add_group_task(Callable(this, "_run_partition"), partitions, partitions, true, "LuaParallelGroup");
+	pool->wait_for_group_task_completion(group);
+
+	batchResults = nullptr;
+	batchArgs = Array();
+
+	results.resize(count);
+	for (int i = 0; i < count; i++) {
+		results[i] = output[i];
+	}
+	return results;
+}
+
+// Runs on a worker thread, calls the function for every argument set of partition index in state index
+void LuaParallelGroup::_runPartition(int index) {
+	int from = index * batchPartitionSize;
+	int to = MIN(from + batchPartitionSize, batchArgs.size());
+	states[index]->callFunctionRange(batchFunction, batchArgs, from, to, batchResults);
+}
+
+// Runs a LuaChunk, or returns the LuaError compileString or compileFile produced
+LuaError *LuaParallelGroup::runEverywhere(const Variant &compiled) {
+#ifndef LAPI_GDEXTENSION
+	Ref<LuaChunk> chunk = Object::cast_to<LuaChunk>(compiled.operator Object *());
+	LuaError *err = Object::cast_to<LuaError>(compiled.operator Object *());
+#else
+	// blame this on https://github.com/godotengine/godot-cpp/issues/995
+	Ref<LuaChunk> chunk = dynamic_cast<LuaChunk *>(compiled.operator Object *());
+	LuaError *err = dynamic_cast<LuaError *>(compiled.operator Object *());
+#endif
+	if (err != nullptr) {
+		// compiled holds the only reference to the error, it would be freed with it
+		return LuaError::newError(err->getMessage(), err->getType());
+	}
+	ERR_FAIL_COND_V(chunk.is_null(), LuaError::newError("Compiling the code did not return a chunk", LuaError::ERR_RUNTIME));
+
+	for (int i = 0; i < states.size(); i++) {
+		err = states[i]->doChunk(chunk);
+		if (err != nullptr) {
+			return err;
+		}
+	}
+	return nullptr;
+}
@@ -0,0 +1,56 @@
+#ifndef LUAPARALLELGROUP_H
+#define LUAPARALLELGROUP_H
+
+#ifndef LAPI_GDEXTENSION
+#include "core/core_bind.h"
+#include "core/object/ref_counted.h"
+#include "core/templates/vector.h"
+#else
+#include <godot_cpp/classes/ref.hpp>
+#include <godot_cpp/templates/vector.hpp>
+#endif
+
+#include "luaAPI.h"
+
+#ifdef LAPI_GDEXTENSION
+using namespace godot;
+#endif
+
+// A set of LuaAPI states running the same code. call_function splits a list of argument sets into one contiguous
+// partition per state and runs the partitions in parallel on the WorkerThreadPool.
+class LuaParallelGroup : public RefCounted {
+	GDCLASS(LuaParallelGroup, RefCounted);
+
+protected:
+	static void _bind_methods();
+
+public:
+	void setup(int size, Array libraries);
+
+	LuaError *doString(String code);
+	LuaError *doFile(String fileName);
+	LuaError *pushGlobalVariant(String name, Variant var);
+
+	Array callFunction(String functionName, Variant argSets);
+
+	inline int getSize() const {
+		return states.size();
+	}
+
+	Ref<LuaAPI> getState(int index) const;
+
+	void _runPartition(int index);
+
+private:
+	Vector<Ref<LuaAPI>> states;
+
+	// The batch being run by callFunction, read by the workers
+	String batchFunction;
+	Array batchArgs;
+	Variant *batchResults = nullptr;
+	int batchPartitionSize = 0;
+
+	LuaError *runEverywhere(const Variant &compiled);
+};
+
+#endif
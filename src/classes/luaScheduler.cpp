@@ -0,0 +1,400 @@
+#include "luaScheduler.h"
+
+#include "luaFunction.h"
+
+#ifndef LAPI_GDEXTENSION
+#include "core/os/os.h"
+#else
+#include <godot_cpp/classes/time.hpp>
+#endif
+
+// Only the addresses are used, as the markers the wait functions yield
+static char waitSecondsMarker;
+static char waitFramesMarker;
+static char waitUntilMarker;
+
+static uint64_t getTicksUsec() {
+#ifndef LAPI_GDEXTENSION
+	return OS::get_singleton()->get_ticks_usec();
+#else
+	return Time::get_singleton()->get_ticks_usec();
+#endif
+}
+
+void LuaScheduler::_bind_methods() {
+	ClassDB::bind_method(D_METHOD("bind", "lua"), &LuaScheduler::bind);
+	ClassDB::bind_method(D_METHOD("spawn", "Function", "Args"), &LuaScheduler::spawn);
+	ClassDB::bind_method(D_METHOD("cancel", "Id"), &LuaScheduler::cancel);
+	ClassDB::bind_method(D_METHOD("tick", "Delta"), &LuaScheduler::tick);
+	ClassDB::bind_method(D_METHOD("is_running", "Id"), &LuaScheduler::isRunning);
+	ClassDB::bind_method(D_METHOD("get_task_count"), &LuaScheduler::getTaskCount);
+	ClassDB::bind_method(D_METHOD("get_stats"), &LuaScheduler::getStats);
+
+	ClassDB::bind_method(D_METHOD("set_time_budget", "value"), &LuaScheduler::setTimeBudget);
+	ClassDB::bind_method(D_METHOD("get_time_budget"), &LuaScheduler::getTimeBudget);
+
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "time_budget"), "set_time_budget", "get_time_budget");
+
+	ADD_SIGNAL(MethodInfo("task_finished", PropertyInfo(Variant::INT, "id")));
+	ADD_SIGNAL(MethodInfo("task_failed", PropertyInfo(Variant::INT, "id"), PropertyInfo(Variant::OBJECT, "error", PROPERTY_HINT_RESOURCE_TYPE, "LuaError")));
+}
+
+LuaScheduler::~LuaScheduler() {
+	if (api.is_null()) {
+		return;
+	}
+
+	// A LuaTask may be using the state on another thread, that thread frees the references then
+	for (const KeyValue<uint64_t, Task> &entry : tasks) {
+		api->releaseRef(entry.value.predicateRef);
+		api->releaseRef(entry.value.threadRef);
+	}
+	api->addSchedulerTasks(-tasks.size());
+}
+
+// Binds the scheduler to a LuaAPI and registers the wait functions as globals. Drops the tasks of a previous LuaAPI.
+void LuaScheduler::bind(Ref<LuaAPI> lua) {
+	if (api.is_valid()) {
+		LuaStateLock lock(api.ptr());
+		ERR_FAIL_COND_MSG(!lock.isLocked(), "LuaAPI is in use by another thread.");
+		while (!tasks.is_empty()) {
+			freeTask(tasks.begin()->key);
+		}
+		ready.clear();
+		timers.clear();
+		frameWaits.clear();
+		polling.clear();
+	}
+
+	LuaStateLock lock(lua.ptr());
+	ERR_FAIL_COND_MSG(!lock.isLocked(), "LuaAPI is in use by another thread.");
+	api = lua;
+	lua_State *L = api->getState();
+	lua_register(L, "wait", luaWait);
+	lua_register(L, "wait_frames", luaWaitFrames);
+	lua_register(L, "wait_until", luaWaitUntil);
+}
+
+// Starts a task running function, a LuaFunction or the name of a global function, with args. It first runs on the next tick.
+// Returns the id of the task, or 0 if it could not be created.
+int64_t LuaScheduler::spawn(Variant function, Array args) {
+	ERR_FAIL_COND_V_MSG(api.is_null(), 0, "LuaScheduler is not bound to a LuaAPI.");
+	LuaStateLock lock(api.ptr());
+	ERR_FAIL_COND_V_MSG(!lock.isLocked(), 0, "LuaAPI is in use by another thread.");
+
+	lua_State *L = api->getState();
+	lua_State *thread = lua_newthread(L);
+	int threadRef = luaL_ref(L, LUA_REGISTRYINDEX);
+
+	if (function.get_type() == Variant::STRING || function.get_type() == Variant::STRING_NAME) {
+		api->getMainState()->getGlobal(function);
+		lua_xmove(L, thread, 1);
+	} else {
+#ifndef LAPI_GDEXTENSION
+		LuaFunction *func = Object::cast_to<LuaFunction>(function.operator Object *());
+#else
+		// blame this on https://github.com/godotengine/godot-cpp/issues/995
+		LuaFunction *func = dynamic_cast<LuaFunction *>(function.operator Object *());
+#endif
+		if (func == nullptr || !func->belongsTo(api.ptr())) {
+			luaL_unref(L, LUA_REGISTRYINDEX, threadRef);
+			ERR_FAIL_V_MSG(0, "Function must be a global function name or a LuaFunction of the bound LuaAPI.");
+		}
+		lua_rawgeti(thread, LUA_REGISTRYINDEX, func->getRef());
+	}
+
+	if (lua_type(thread, -1) != LUA_TFUNCTION) {
+		luaL_unref(L, LUA_REGISTRYINDEX, threadRef);
+		ERR_FAIL_V_MSG(0, vformat("\"%s\" is not a function.", function));
+	}
+
+	for (int i = 0; i < args.size(); i++) {
+		LuaError *err = LuaState::pushVariant(thread, args[i]);
+		if (err != nullptr) {
+			luaL_unref(L, LUA_REGISTRYINDEX, threadRef);
+			String msg = err->getMessage();
+			memdelete(err);
+			ERR_FAIL_V_MSG(0, msg);
+		}
+	}
+
+	Task task;
+	task.thread = thread;
+	task.threadRef = threadRef;
+	task.argc = args.size();
+
+	uint64_t id = nextId++;
+	tasks.insert(id, task);
+	api->addSchedulerTasks(1);
+	ready.push_back(id);
+	return (int64_t)id;
+}
+
+// Stops a task. Returns false if it is not running.
+bool LuaScheduler::cancel(int64_t id) {
+	if (api.is_null() || !tasks.has((uint64_t)id)) {
+		return false;
+	}
+
+	LuaStateLock lock(api.ptr());
+	ERR_FAIL_COND_V_MSG(!lock.isLocked(), false, "LuaAPI is in use by another thread.");
+
+	// A task cancelling itself from a callback is freed once it yields or returns
+	if ((uint64_t)id == runningId) {
+		runningCancelled = true;
+		return true;
+	}
+
+	// Its entry in a heap or queue is skipped when it comes up
+	freeTask((uint64_t)id);
+	return true;
+}
+
+// Advances the clock by delta seconds and a frame, then resumes every task which is due, up to the time budget.
+LuaError *LuaScheduler::tick(double delta) {
+	if (api.is_null()) {
+		return LuaError::newError("LuaScheduler is not bound to a LuaAPI", LuaError::ERR_RUNTIME);
+	}
+	LuaStateLock lock(api.ptr());
+	if (!lock.isLocked()) {
+		return LuaAPI::newBusyError();
+	}
+
+	uint64_t start = getTicksUsec();
+	time += delta;
+	frame++;
+
+	// Tasks deferred by the budget of the last tick stay in front of the ones due now
+	while (!timers.is_empty() && timers[0].at <= time) {
+		ready.push_back(timers[0].id);
+		popWake(timers);
+	}
+	while (!frameWaits.is_empty() && frameWaits[0].at <= frame) {
+		ready.push_back(frameWaits[0].id);
+		popWake(frameWaits);
+	}
+
+	int finished = 0;
+	int failed = 0;
+	lua_State *L = api->getState();
+
+	Vector<uint64_t> waiting = polling;
+	polling.clear();
+	for (uint64_t id : waiting) {
+		Task *task = tasks.getptr(id);
+		if (task == nullptr) {
+			continue;
+		}
+
+		LuaExecutionScope scope(api->getMainState());
+		lua_pushcfunction(L, LuaState::luaErrorHandler);
+		lua_rawgeti(L, LUA_REGISTRYINDEX, task->predicateRef);
+		int ret;
+		{
+			LuaProtectedScope protect(api->getMainState());
+			ret = lua_pcall(L, 0, 1, -2);
+		}
+		if (ret != LUA_OK) {
+			LuaError *err = LuaState::handleError(L, ret);
+			lua_pop(L, 1);
+			failed++;
+			freeTask(id);
+			emit_signal("task_failed", (int64_t)id, err);
+			continue;
+		}
+
+		bool due = lua_toboolean(L, -1);
+		lua_pop(L, 2);
+
+		// The predicate may have spawned or cancelled tasks
+		task = tasks.getptr(id);
+		if (task == nullptr) {
+			continue;
+		}
+		if (!due) {
+			polling.push_back(id);
+			continue;
+		}
+
+		luaL_unref(L, LUA_REGISTRYINDEX, task->predicateRef);
+		task->predicateRef = LUA_NOREF;
+		ready.push_back(id);
+	}
+
+	int resumed = 0;
+	while (!ready.is_empty()) {
+		// At least one task runs every tick, so a tiny budget can't stall everything
+		if (timeBudget > 0 && resumed > 0 && (int64_t)(getTicksUsec() - start) >= timeBudget) {
+			break;
+		}
+
+		uint64_t id = ready.front()->get();
+		ready.pop_front();
+		if (!tasks.has(id)) {
+			continue;
+		}
+
+		resumed++;
+		resumeTask(id, finished, failed);
+	}
+
+	stats["usec"] = (int64_t)(getTicksUsec() - start);
+	stats["resumed"] = resumed;
+	stats["finished"] = finished;
+	stats["failed"] = failed;
+	stats["deferred"] = (int64_t)ready.size();
+	stats["tasks"] = tasks.size();
+	stats["sleeping"] = (int64_t)(timers.size() + frameWaits.size());
+	stats["polling"] = (int64_t)polling.size();
+	return nullptr;
+}
+
+// Resumes a task and files it under what it waits for next, or frees it once it returned or failed
+void LuaScheduler::resumeTask(uint64_t id, int &finished, int &failed) {
+	Task *task = tasks.getptr(id);
+	lua_State *thread = task->thread;
+	int argc = task->argc;
+	task->argc = 0;
+
+	runningId = id;
+	runningCancelled = false;
+	int ret;
+	int nres;
+	{
+		// Each resume gets a fresh execution budget
+		LuaExecutionScope scope(api->getMainState());
+		{
+			LuaProtectedScope protect(api->getMainState());
+#ifndef LAPI_LUAJIT
+			nres = 0;
+			ret = lua_resume(thread, nullptr, argc, &nres);
+#else
+			ret = lua_resume(thread, argc);
+			nres = lua_gettop(thread);
+#endif
+		}
+
+		if (ret != LUA_OK && ret != LUA_YIELD) {
+			LuaError *err = LuaState::handleError(thread, ret);
+			runningId = 0;
+			failed++;
+			freeTask(id);
+			emit_signal("task_failed", (int64_t)id, err);
+			return;
+		}
+	}
+	runningId = 0;
+
+	if (ret == LUA_OK || runningCancelled) {
+		if (ret == LUA_OK) {
+			finished++;
+		}
+		freeTask(id);
+		if (ret == LUA_OK) {
+			emit_signal("task_finished", (int64_t)id);
+		}
+		return;
+	}
+
+	// Lua may have spawned tasks, which can move this one
+	task = tasks.getptr(id);
+
+	int base = lua_gettop(thread) - nres + 1;
+	void *marker = nres == 2 ? lua_touserdata(thread, base) : nullptr;
+	if (marker == &waitSecondsMarker) {
+		pushWake(timers, { time + lua_tonumber(thread, base + 1), id });
+	} else if (marker == &waitFramesMarker) {
+		lua_Integer frames = lua_tointeger(thread, base + 1);
+		pushWake(frameWaits, { (double)(frame + MAX(frames, 1)), id });
+	} else if (marker == &waitUntilMarker) {
+		lua_pushvalue(thread, base + 1);
+		task->predicateRef = luaL_ref(thread, LUA_REGISTRYINDEX);
+		polling.push_back(id);
+	} else {
+		// A plain yield waits for the next frame
+		pushWake(frameWaits, { (double)(frame + 1), id });
+	}
+
+	lua_settop(thread, 0);
+}
+
+void LuaScheduler::freeTask(uint64_t id) {
+	Task *task = tasks.getptr(id);
+	if (task == nullptr) {
+		return;
+	}
+
+	lua_State *L = api->getState();
+	luaL_unref(L, LUA_REGISTRYINDEX, task->predicateRef);
+	luaL_unref(L, LUA_REGISTRYINDEX, task->threadRef);
+	tasks.erase(id);
+	api->addSchedulerTasks(-1);
+}
+
+void LuaScheduler::pushWake(Vector<Wake> &heap, const Wake &wake) {
+	heap.push_back(wake);
+	Wake *w = heap.ptrw();
+	int i = heap.size() - 1;
+	while (i > 0) {
+		int parent = (i - 1) / 2;
+		if (!(w[i] < w[parent])) {
+			break;
+		}
+		SWAP(w[i], w[parent]);
+		i = parent;
+	}
+}
+
+// Removes the earliest wake up
+void LuaScheduler::popWake(Vector<Wake> &heap) {
+	int size = heap.size() - 1;
+	Wake *w = heap.ptrw();
+	w[0] = w[size];
+	heap.resize(size);
+
+	w = heap.ptrw();
+	int i = 0;
+	while (true) {
+		int smallest = i;
+		int left = i * 2 + 1;
+		int right = left + 1;
+		if (left < size && w[left] < w[smallest]) {
+			smallest = left;
+		}
+		if (right < size && w[right] < w[smallest]) {
+			smallest = right;
+		}
+		if (smallest == i) {
+			break;
+		}
+		SWAP(w[i], w[smallest]);
+		i = smallest;
+	}
+}
+
+// wait(seconds), resumes the task once the scheduler's clock advanced by seconds
+int LuaScheduler::luaWait(lua_State *state) {
+	luaL_checknumber(state, 1);
+	lua_settop(state, 1);
+	lua_pushlightuserdata(state, &waitSecondsMarker);
+	lua_insert(state, 1);
+	return lua_yield(state, 2);
+}
+
+// wait_frames(n), resumes the task n ticks later, at least 1
+int LuaScheduler::luaWaitFrames(lua_State *state) {
+	luaL_checkinteger(state, 1);
+	lua_settop(state, 1);
+	lua_pushlightuserdata(state, &waitFramesMarker);
+	lua_insert(state, 1);
+	return lua_yield(state, 2);
+}
+
+// wait_until(fn), calls fn every tick and resumes the task on the tick it returns true
+int LuaScheduler::luaWaitUntil(lua_State *state) {
+	luaL_checktype(state, 1, LUA_TFUNCTION);
+	lua_settop(state, 1);
+	lua_pushlightuserdata(state, &waitUntilMarker);
+	lua_insert(state, 1);
+	return lua_yield(state, 2);
+}
@@ -0,0 +1,114 @@
+#ifndef LUASCHEDULER_H
+#define LUASCHEDULER_H
+
+#ifndef LAPI_GDEXTENSION
+#include "core/core_bind.h"
+#include "core/object/ref_counted.h"
+#include "core/templates/hash_map.h"
+#include "core/templates/list.h"
+#include "core/templates/vector.h"
+#else
+#include <godot_cpp/classes/ref.hpp>
+#include <godot_cpp/templates/hash_map.hpp>
+#include <godot_cpp/templates/list.hpp>
+#include <godot_cpp/templates/vector.hpp>
+#endif
+
+#include "luaAPI.h"
+
+#ifdef LAPI_GDEXTENSION
+using namespace godot;
+#endif
+
+// Runs many Lua coroutines from one tick call. Lua waits with the wait(seconds), wait_frames(n) and wait_until(fn)
+// globals, which yield a marker the scheduler understands. Sleeping tasks sit in heaps ordered by wake up time or
+// frame, so a tick only touches the tasks that are due. Resuming stops once the tick's time budget is spent, the
+// remaining due tasks run first on the next tick.
+class LuaScheduler : public RefCounted {
+	GDCLASS(LuaScheduler, RefCounted);
+
+protected:
+	static void _bind_methods();
+
+public:
+	~LuaScheduler();
+
+	void bind(Ref<LuaAPI> lua);
+
+	int64_t spawn(Variant function, Array args);
+	bool cancel(int64_t id);
+	LuaError *tick(double delta);
+
+	inline bool isRunning(int64_t id) const {
+		return tasks.has((uint64_t)id);
+	}
+
+	inline int getTaskCount() const {
+		return tasks.size();
+	}
+
+	inline void setTimeBudget(int64_t usec) {
+		timeBudget = usec;
+	}
+
+	inline int64_t getTimeBudget() const {
+		return timeBudget;
+	}
+
+	// A copy, the Dictionary is rewritten by every tick
+	inline Dictionary getStats() const {
+		return stats.duplicate();
+	}
+
+	// Lua functions
+	static int luaWait(lua_State *state);
+	static int luaWaitFrames(lua_State *state);
+	static int luaWaitUntil(lua_State *state);
+
+private:
+	struct Task {
+		lua_State *thread = nullptr;
+		int threadRef = LUA_NOREF;
+		// The wait_until predicate while the task waits on one
+		int predicateRef = LUA_NOREF;
+		// Arguments waiting for the first resume
+		int argc = 0;
+	};
+
+	struct Wake {
+		double at;
+		uint64_t id;
+
+		bool operator<(const Wake &other) const {
+			return at < other.at;
+		}
+	};
+
+	Ref<LuaAPI> api;
+	HashMap<uint64_t, Task> tasks;
+	uint64_t nextId = 1;
+
+	double time = 0;
+	uint64_t frame = 0;
+	int64_t timeBudget = 0;
+
+	List<uint64_t> ready;
+	// Binary min heaps, the earliest wake up is first
+	Vector<Wake> timers;
+	Vector<Wake> frameWaits;
+	Vector<uint64_t> polling;
+
+	Dictionary stats;
+
+	// The task being resumed, it is only freed after lua_resume returns
+	uint64_t runningId = 0;
+	bool runningCancelled = false;
+
+	void resumeTask(uint64_t id, int &finished, int &failed);
+	void freeTask(uint64_t id);
+
+	static void pushWake(Vector<Wake> &heap, const Wake &wake);
+	static void popWake(Vector<Wake> &heap);
+};
+
+#endif
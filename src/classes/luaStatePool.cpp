@@ -0,0 +1,61 @@
+#include "luaStatePool.h"
+
+void LuaStatePool::_bind_methods() {
+	ClassDB::bind_method(D_METHOD("setup", "Size", "Libraries"), &LuaStatePool::setup);
+	ClassDB::bind_method(D_METHOD("acquire"), &LuaStatePool::acquire);
+	ClassDB::bind_method(D_METHOD("release", "Lua"), &LuaStatePool::release);
+	ClassDB::bind_method(D_METHOD("get_available_count"), &LuaStatePool::getAvailableCount);
+	ClassDB::bind_method(D_METHOD("get_size"), &LuaStatePool::getSize);
+	ClassDB::bind_method(D_METHOD("get_libraries"), &LuaStatePool::getLibraries);
+}
+
+// Drops the states the pool holds and creates size new ones with libraries bound
+void LuaStatePool::setup(int size, Array libraries) {
+	this->size = MAX(size, 0);
+	this->libraries = libraries.duplicate();
+
+	available.clear();
+	for (int i = 0; i < this->size; i++) {
+		available.push_back(create());
+	}
+}
+
+// Hands out a pooled state, or creates one when the pool is empty
+Ref<LuaAPI> LuaStatePool::acquire() {
+	if (available.is_empty()) {
+		return create();
+	}
+
+	Ref<LuaAPI> lua = available[available.size() - 1];
+	available.remove_at(available.size() - 1);
+	return lua;
+}
+
+// Resets lua and keeps it for the next acquire. Returns false if lua did not come from this pool, was already released or is running.
+// The caller must not use lua afterwards.
+bool LuaStatePool::release(Ref<LuaAPI> lua) {
+	if (lua.is_null() || lua->getPoolId() != (uint64_t)get_instance_id() || available.has(lua)) {
+		return false;
+	}
+
+	// reset() keeps the global tables, so closures of this tenant would see the globals of the next one
+	LuaStateLock lock(lua.ptr());
+	if (!lock.isLocked() || lua->hasLiveHandles() || !lua->reset()) {
+		return false;
+	}
+
+	// A full pool lets extra states be freed
+	if (available.size() < size) {
+		available.push_back(lua);
+	}
+	return true;
+}
+
+Ref<LuaAPI> LuaStatePool::create() const {
+	Ref<LuaAPI> lua;
+	lua.instantiate();
+	lua->bindLibraries(libraries);
+	lua->snapshot();
+	lua->setPoolId((uint64_t)get_instance_id());
+	return lua;
+}
@@ -0,0 +1,53 @@
+#ifndef LUASTATEPOOL_H
+#define LUASTATEPOOL_H
+
+#ifndef LAPI_GDEXTENSION
+#include "core/core_bind.h"
+#include "core/object/ref_counted.h"
+#include "core/templates/vector.h"
+#else
+#include <godot_cpp/classes/ref.hpp>
+#include <godot_cpp/templates/vector.hpp>
+#endif
+
+#include "luaAPI.h"
+
+#ifdef LAPI_GDEXTENSION
+using namespace godot;
+#endif
+
+// Keeps LuaAPI states with a set of libraries bound ready to be handed out.
+// Released states are reset to the globals they had when created, instead of being closed and rebuilt.
+class LuaStatePool : public RefCounted {
+	GDCLASS(LuaStatePool, RefCounted);
+
+protected:
+	static void _bind_methods();
+
+public:
+	void setup(int size, Array libraries);
+
+	Ref<LuaAPI> acquire();
+	bool release(Ref<LuaAPI> lua);
+
+	inline int getAvailableCount() const {
+		return available.size();
+	}
+
+	inline int getSize() const {
+		return size;
+	}
+
+	inline Array getLibraries() const {
+		return libraries;
+	}
+
+private:
+	int size = 0;
+	Array libraries;
+	Vector<Ref<LuaAPI>> available;
+
+	Ref<LuaAPI> create() const;
+};
+
+#endif
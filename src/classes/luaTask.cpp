@@ -0,0 +1,89 @@
+#include "luaTask.h"
+
+#include "luaAPI.h"
+
+#ifndef LAPI_GDEXTENSION
+#include "core/object/worker_thread_pool.h"
+#else
+#include <godot_cpp/classes/worker_thread_pool.hpp>
+#endif
+
+void LuaTask::_bind_methods() {
+	ClassDB::bind_method(D_METHOD("is_done"), &LuaTask::isDone);
+	ClassDB::bind_method(D_METHOD("get_result"), &LuaTask::getResult);
+	ClassDB::bind_method(D_METHOD("wait"), &LuaTask::wait);
+
+	// Only bound so it can be used as a callable, it is not part of the API
+	ClassDB::bind_method(D_METHOD("_complete"), &LuaTask::_complete);
+
+	ADD_SIGNAL(MethodInfo("completed", PropertyInfo(Variant::NIL, "result", PROPERTY_HINT_NONE, "", PROPERTY_USAGE_NIL_IS_VARIANT)));
+}
+
+// Creates a task and queues it on the LuaAPI
+Ref<LuaTask> LuaTask::start(LuaAPI *api, Kind kind, const String &target, const Array &args) {
+	Ref<LuaTask> task;
+	task.instantiate();
+	task->api = Ref<LuaAPI>(api);
+	task->kind = kind;
+	task->target = target;
+	task->args = args;
+	task->self = task;
+#ifdef LAPI_GDEXTENSION
+	task->finished.instantiate();
+#endif
+
+	api->queueTask(task.ptr());
+	return task;
+}
+
+// Waits for the state to be free instead of failing like calls from other threads do
+void LuaTask::execute() {
+	LuaStateLock lock(api.ptr(), true);
+	switch (kind) {
+		case KIND_CALL:
+			result = api->callFunction(target, args);
+			break;
+		case KIND_STRING:
+			result = api->doString(target);
+			break;
+		case KIND_FILE:
+			result = api->doFile(target);
+			break;
+	}
+}
+
+// Publishes the result and queues _complete. The task may be freed on the main thread afterwards.
+void LuaTask::finish(int64_t worker) {
+	workerId = worker;
+	done.set();
+#ifndef LAPI_GDEXTENSION
+	finished.post();
+#else
+	finished->post();
+#endif
+	call_deferred("_complete");
+}
+
+// Runs on the main thread once the task finished
+void LuaTask::_complete() {
+	if (workerId != -1) {
+		WorkerThreadPool::get_singleton()->wait_for_task_completion(workerId);
+	}
+	emit_signal("completed", result);
+	self.unref();
+}
+
+// Blocks until the task is done and returns its result
+Variant LuaTask::wait() {
+	if (!done.is_set()) {
+#ifndef LAPI_GDEXTENSION
+		finished.wait();
+		// Passes the wake up on to other threads waiting for the same task
+		finished.post();
+#else
+		finished->wait();
+		finished->post();
+#endif
+	}
+	return result;
+}
@@ -0,0 +1,79 @@
+#ifndef LUATASK_H
+#define LUATASK_H
+
+#ifndef LAPI_GDEXTENSION
+#include "core/core_bind.h"
+#include "core/object/ref_counted.h"
+#include "core/os/semaphore.h"
+#include "core/templates/safe_refcount.h"
+#else
+#include <godot_cpp/classes/ref.hpp>
+#include <godot_cpp/classes/semaphore.hpp>
+#include <godot_cpp/templates/safe_refcount.hpp>
+#endif
+
+#ifdef LAPI_GDEXTENSION
+using namespace godot;
+#endif
+
+class LuaAPI;
+
+// Work started by one of the LuaAPI *_async methods. The work runs on Godot's WorkerThreadPool while holding the
+// LuaAPI, so calls into it from other threads fail until the task is done. The result can be polled with is_done
+// and get_result, waited for with wait, or received with the completed signal, which is emitted on the main thread.
+// Tasks of a LuaAPI are queued on it and run one after another by a single worker, so they never hold more than
+// one pool thread waiting for a busy state.
+class LuaTask : public RefCounted {
+	GDCLASS(LuaTask, RefCounted);
+
+protected:
+	static void _bind_methods();
+
+public:
+	enum Kind {
+		KIND_CALL,
+		KIND_STRING,
+		KIND_FILE,
+	};
+
+	static Ref<LuaTask> start(LuaAPI *api, Kind kind, const String &target, const Array &args);
+
+	Variant wait();
+
+	inline bool isDone() const {
+		return done.is_set();
+	}
+
+	// The result is only written by the worker before done is set, so reading it after is safe
+	inline Variant getResult() const {
+		return done.is_set() ? result : Variant();
+	}
+
+	// Called by the worker running the tasks of the LuaAPI, see LuaAPI::_runTasks()
+	void execute();
+	void finish(int64_t worker);
+
+	void _complete();
+
+private:
+	Ref<LuaAPI> api;
+	Kind kind = KIND_CALL;
+	String target;
+	Array args;
+
+	Variant result;
+	SafeFlag done;
+#ifndef LAPI_GDEXTENSION
+	Semaphore finished;
+#else
+	Ref<Semaphore> finished;
+#endif
+
+	// Set on the last task a worker ran, the pool requires its task to be waited for exactly once
+	int64_t workerId = -1;
+
+	// Keeps the task alive until the worker finished and the completed signal was emitted
+	Ref<LuaTask> self;
+};
+
+#endif
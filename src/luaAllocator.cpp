@@ -0,0 +1,159 @@
+#include "luaAllocator.h"
+
+#ifndef LAPI_GDEXTENSION
+#include "core/variant/variant.h"
+#else
+#include <godot_cpp/variant/packed_int64_array.hpp>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+LuaAllocator::~LuaAllocator() {
+	for (void *slab : slabs) {
+		free(slab);
+	}
+}
+
+void *LuaAllocator::alloc(void *ud, void *ptr, size_t osize, size_t nsize) {
+	LuaAllocator *allocator = (LuaAllocator *)ud;
+	// When ptr is NULL osize is the type of the object being created, not a size
+	if (ptr == nullptr) {
+		osize = 0;
+	}
+
+	if (nsize == 0) {
+		if (ptr != nullptr) {
+			allocator->current -= osize;
+			allocator->frees++;
+			allocator->release(ptr, osize);
+		}
+		return nullptr;
+	}
+
+	// Shrinking must never fail, lua relies on it
+	if (nsize > osize && allocator->enforcing && allocator->limit > 0 && allocator->current + (nsize - osize) > allocator->limit) {
+		allocator->failed++;
+		return nullptr;
+	}
+
+	void *block = allocator->resize(ptr, osize, nsize);
+	if (block == nullptr) {
+		allocator->failed++;
+		return nullptr;
+	}
+
+	allocator->current += nsize;
+	allocator->current -= osize;
+	if (allocator->current > allocator->peak) {
+		allocator->peak = allocator->current;
+	}
+
+	if (ptr == nullptr) {
+		allocator->allocations++;
+		allocator->histogram[getBucket(nsize)]++;
+	}
+	return block;
+}
+
+void *LuaAllocator::resize(void *ptr, size_t osize, size_t nsize) {
+	if (backend == BACKEND_SYSTEM) {
+		return realloc(ptr, nsize);
+	}
+
+	int oldClass = ptr == nullptr ? -1 : getPoolClass(osize);
+	int newClass = getPoolClass(nsize);
+	if (ptr != nullptr && oldClass >= 0 && oldClass == newClass) {
+		return ptr;
+	}
+
+	// Neither block is pooled
+	if ((ptr == nullptr || oldClass < 0) && newClass < 0) {
+		return realloc(ptr, nsize);
+	}
+
+	void *block = newClass < 0 ? malloc(nsize) : poolAlloc(newClass);
+	if (block == nullptr) {
+		// Lua expects shrinking to succeed. The old block is big enough, at worst it ends up in a smaller class's free list.
+		return nsize <= osize ? ptr : nullptr;
+	}
+
+	if (ptr != nullptr) {
+		memcpy(block, ptr, MIN(osize, nsize));
+		release(ptr, osize);
+	}
+	return block;
+}
+
+void LuaAllocator::release(void *ptr, size_t size) {
+	int poolClass = backend == BACKEND_POOL ? getPoolClass(size) : -1;
+	if (poolClass < 0) {
+		free(ptr);
+		return;
+	}
+
+	FreeBlock *block = (FreeBlock *)ptr;
+	block->next = freeLists[poolClass];
+	freeLists[poolClass] = block;
+}
+
+void *LuaAllocator::poolAlloc(int poolClass) {
+	if (freeLists[poolClass] == nullptr) {
+		char *slab = (char *)malloc(POOL_SLAB_SIZE);
+		if (slab == nullptr) {
+			return nullptr;
+		}
+		slabs.push_back(slab);
+		reserved += POOL_SLAB_SIZE;
+
+		// Thread the slab's blocks into the free list, lowest address first
+		size_t blockSize = (poolClass + 1) * POOL_GRANULARITY;
+		size_t count = POOL_SLAB_SIZE / blockSize;
+		for (size_t i = count; i > 0; i--) {
+			FreeBlock *block = (FreeBlock *)(slab + (i - 1) * blockSize);
+			block->next = freeLists[poolClass];
+			freeLists[poolClass] = block;
+		}
+	}
+
+	FreeBlock *block = freeLists[poolClass];
+	freeLists[poolClass] = block->next;
+	return block;
+}
+
+// Returns -1 for blocks too large to be pooled
+int LuaAllocator::getPoolClass(size_t size) {
+	if (size == 0 || size > (size_t)POOL_GRANULARITY * POOL_CLASSES) {
+		return -1;
+	}
+	return (int)((size + POOL_GRANULARITY - 1) / POOL_GRANULARITY) - 1;
+}
+
+int LuaAllocator::getBucket(size_t size) {
+	int bucket = 0;
+	size_t bound = 8;
+	while (size > bound && bucket < HISTOGRAM_SIZE - 1) {
+		bound <<= 1;
+		bucket++;
+	}
+	return bucket;
+}
+
+Dictionary LuaAllocator::getStats() const {
+	Dictionary stats;
+	stats["current"] = (int64_t)current;
+	stats["peak"] = (int64_t)peak;
+	stats["limit"] = (int64_t)limit;
+	stats["allocations"] = (int64_t)allocations;
+	stats["frees"] = (int64_t)frees;
+	stats["failed"] = (int64_t)failed;
+	stats["reserved"] = (int64_t)reserved;
+
+	PackedInt64Array buckets;
+	buckets.resize(HISTOGRAM_SIZE);
+	for (int i = 0; i < HISTOGRAM_SIZE; i++) {
+		buckets.set(i, (int64_t)histogram[i]);
+	}
+	stats["histogram"] = buckets;
+	return stats;
+}
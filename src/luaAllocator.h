@@ -0,0 +1,105 @@
+#ifndef LUAALLOCATOR_H
+#define LUAALLOCATOR_H
+
+#ifndef LAPI_GDEXTENSION
+#include "core/templates/vector.h"
+#include "core/variant/dictionary.h"
+#else
+#include <godot_cpp/templates/vector.hpp>
+#include <godot_cpp/variant/dictionary.hpp>
+#endif
+
+#include <lua/lua.hpp>
+
+#ifdef LAPI_GDEXTENSION
+using namespace godot;
+#endif
+
+// lua_Alloc of a LuaAPI state. Tracks the bytes lua holds and can cap them.
+// The cap is only enforced inside lua_pcall and lua_resume, lua raises LUA_ERRMEM which the running call reports as ERR_MEMORY.
+// Pushes, loads and pulls from Godot happen outside of a protected call, failing them would make lua panic.
+class LuaAllocator {
+public:
+	enum Backend {
+		// realloc and free, like luaL_newstate
+		BACKEND_SYSTEM,
+		// Small blocks come from per size class free lists carved out of slabs, larger ones from malloc.
+		// Slabs are only returned to the system when the state is closed.
+		BACKEND_POOL,
+	};
+
+	~LuaAllocator();
+
+	static void *alloc(void *ud, void *ptr, size_t osize, size_t nsize);
+
+	// Must be set before the state is created
+	inline void setBackend(Backend value) {
+		backend = value;
+	}
+
+	inline Backend getBackend() const {
+		return backend;
+	}
+
+	inline void setLimit(uint64_t bytes) {
+		limit = bytes;
+	}
+
+	inline uint64_t getLimit() const {
+		return limit;
+	}
+
+	// Whether count more elements of size bytes stay under the limit.
+	// Memory Godot allocates on lua's behalf, like the buffer of a packed array, is checked with this before it is allocated.
+	inline bool fits(uint64_t count, uint64_t size) const {
+		return limit == 0 || (current <= limit && count <= (limit - current) / size);
+	}
+
+	inline void setEnforcing(bool value) {
+		enforcing = value;
+	}
+
+	inline bool isEnforcing() const {
+		return enforcing;
+	}
+
+	Dictionary getStats() const;
+
+	// Bucket i counts allocations of up to 8 << i bytes, the last one everything larger.
+	static const int HISTOGRAM_SIZE = 16;
+
+private:
+	struct FreeBlock {
+		FreeBlock *next;
+	};
+
+	// Size classes are multiples of POOL_GRANULARITY up to POOL_CLASSES * POOL_GRANULARITY bytes.
+	// Lua's strings, closures, small tables and Variant userdata are all below that.
+	static const int POOL_GRANULARITY = 16;
+	static const int POOL_CLASSES = 16;
+	static const int POOL_SLAB_SIZE = 16 * 1024;
+
+	Backend backend = BACKEND_SYSTEM;
+	FreeBlock *freeLists[POOL_CLASSES] = {};
+	Vector<void *> slabs;
+	uint64_t reserved = 0;
+
+	uint64_t limit = 0;
+	bool enforcing = false;
+
+	uint64_t current = 0;
+	uint64_t peak = 0;
+	uint64_t allocations = 0;
+	uint64_t frees = 0;
+	uint64_t failed = 0;
+	uint64_t histogram[HISTOGRAM_SIZE] = {};
+
+	static int getBucket(size_t size);
+	static int getPoolClass(size_t size);
+
+	void *resize(void *ptr, size_t osize, size_t nsize);
+	void release(void *ptr, size_t size);
+	void *poolAlloc(int poolClass);
+};
+
+#endif
@@ -0,0 +1,95 @@
+#include "luaBindingCache.h"
+
+#include <classes/luaAPI.h>
+
+#ifdef LAPI_GDEXTENSION
+#include <godot_cpp/variant/typed_array.hpp>
+#endif
+
+// Returns the bindings for the object's script, or its class if it has no script.
+// Scripted classes are invalidated when the script changes.
+LuaBindingCache::ClassBindings *LuaBindingCache::getClass(Object *obj, LuaAPI *api) {
+	Object *script = obj->get_script();
+	if (script == nullptr) {
+		String className = obj->get_class();
+		if (ClassBindings *bindings = classes.getptr(className); bindings != nullptr) {
+			return bindings;
+		}
+
+		classes.insert(className, newClassBindings(obj));
+		return classes.getptr(className);
+	}
+
+	uint64_t scriptID = (uint64_t)script->get_instance_id();
+	if (ClassBindings *bindings = scripts.getptr(scriptID); bindings != nullptr) {
+		return bindings;
+	}
+
+	Callable invalidate = Callable(api, "clear_binding_cache");
+	if (!script->is_connected("changed", invalidate)) {
+		script->connect("changed", invalidate);
+	}
+
+	scripts.insert(scriptID, newClassBindings(obj));
+	return scripts.getptr(scriptID);
+}
+
+// Resolves the field once per class. In permissive mode lua_fields is a blacklist, otherwise it is a whitelist.
+// Names which are neither a method, a property nor listed in lua_fields are not cached.
+LuaBindingCache::Binding LuaBindingCache::getBinding(ClassBindings *bindings, Object *obj, const String &field, bool permissive) {
+	if (const Binding *binding = bindings->fields.getptr(field); binding != nullptr) {
+		return *binding;
+	}
+
+	Binding binding;
+	binding.name = field;
+
+	bool listed = bindings->luaFields.has(field);
+	bool cached = listed;
+	if (permissive == listed) {
+		binding.kind = BINDING_DENIED;
+	} else if (obj->has_method(binding.name)) {
+		binding.kind = BINDING_METHOD;
+		cached = true;
+	} else {
+		binding.kind = BINDING_PROPERTY;
+		cached = cached || bindings->properties.has(field);
+	}
+
+	if (cached) {
+		bindings->fields.insert(field, binding);
+	}
+	return binding;
+}
+
+void LuaBindingCache::clear() {
+	scripts.clear();
+	classes.clear();
+}
+
+LuaBindingCache::ClassBindings LuaBindingCache::newClassBindings(Object *obj) {
+	ClassBindings bindings;
+	bindings.overridesIndex = obj->has_method("__index");
+	bindings.overridesNewIndex = obj->has_method("__newindex");
+
+#ifndef LAPI_GDEXTENSION
+	List<PropertyInfo> properties;
+	obj->get_property_list(&properties);
+	for (const PropertyInfo &property : properties) {
+		bindings.properties.insert(property.name);
+	}
+#else
+	TypedArray<Dictionary> properties = obj->get_property_list();
+	for (int i = 0; i < properties.size(); i++) {
+		bindings.properties.insert((String)((Dictionary)properties[i])["name"]);
+	}
+#endif
+
+	if (obj->has_method("lua_fields")) {
+		Array fields = obj->call("lua_fields");
+		for (int i = 0; i < fields.size(); i++) {
+			bindings.luaFields.insert((String)fields[i]);
+		}
+	}
+	return bindings;
+}
@@ -0,0 +1,58 @@
+#ifndef LUABINDINGCACHE_H
+#define LUABINDINGCACHE_H
+
+#ifndef LAPI_GDEXTENSION
+#include "core/object/object.h"
+#include "core/string/string_name.h"
+#include "core/templates/hash_map.h"
+#include "core/templates/hash_set.h"
+#else
+#include <godot_cpp/classes/object.hpp>
+#include <godot_cpp/templates/hash_map.hpp>
+#include <godot_cpp/templates/hash_set.hpp>
+#include <godot_cpp/variant/string_name.hpp>
+#endif
+
+#ifdef LAPI_GDEXTENSION
+using namespace godot;
+#endif
+
+class LuaAPI;
+
+// Caches how mt_Object resolves a field per class (or per script), so repeated accesses from lua
+// are a hash lookup instead of has_method and lua_fields calls.
+// lua_fields is assumed to return the same fields for every instance of a class.
+// Only names the class declares are cached, any other name is resolved on every access so scripts can't grow the cache.
+class LuaBindingCache {
+public:
+	enum BindingKind {
+		BINDING_METHOD,
+		BINDING_PROPERTY,
+		BINDING_DENIED,
+	};
+
+	struct Binding {
+		BindingKind kind = BINDING_DENIED;
+		StringName name;
+	};
+
+	struct ClassBindings {
+		bool overridesIndex = false;
+		bool overridesNewIndex = false;
+		HashSet<String> luaFields;
+		HashSet<String> properties;
+		HashMap<String, Binding> fields;
+	};
+
+	ClassBindings *getClass(Object *obj, LuaAPI *api);
+	Binding getBinding(ClassBindings *bindings, Object *obj, const String &field, bool permissive);
+	void clear();
+
+private:
+	HashMap<uint64_t, ClassBindings> scripts;
+	HashMap<String, ClassBindings> classes;
+
+	static ClassBindings newClassBindings(Object *obj);
+};
+
+#endif
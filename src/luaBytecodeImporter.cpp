@@ -0,0 +1,75 @@
+#include "luaBytecodeImporter.h"
+
+#if defined(TOOLS_ENABLED) && !defined(LAPI_GDEXTENSION)
+
+#include "core/io/file_access.h"
+#include "core/io/resource_saver.h"
+
+#include <classes/luaBytecode.h>
+
+String ResourceImporterLuaBytecode::get_importer_name() const {
+	return "lua_bytecode";
+}
+
+String ResourceImporterLuaBytecode::get_visible_name() const {
+	return "Lua Bytecode";
+}
+
+void ResourceImporterLuaBytecode::get_recognized_extensions(List<String> *p_extensions) const {
+	p_extensions->push_back("lua");
+}
+
+String ResourceImporterLuaBytecode::get_save_extension() const {
+	return "res";
+}
+
+String ResourceImporterLuaBytecode::get_resource_type() const {
+	return "LuaBytecode";
+}
+
+int ResourceImporterLuaBytecode::get_preset_count() const {
+	return 0;
+}
+
+String ResourceImporterLuaBytecode::get_preset_name(int p_idx) const {
+	return String();
+}
+
+void ResourceImporterLuaBytecode::get_import_options(const String &p_path, List<ImportOption> *r_options, int p_preset) const {
+	r_options->push_back(ImportOption(PropertyInfo(Variant::BOOL, "strip_debug_info"), false));
+}
+
+bool ResourceImporterLuaBytecode::get_option_visibility(const String &p_path, const String &p_option, const HashMap<StringName, Variant> &p_options) const {
+	return true;
+}
+
+Error ResourceImporterLuaBytecode::import(const String &p_source_file, const String &p_save_path, const HashMap<StringName, Variant> &p_options, List<String> *r_platform_variants, List<String> *r_gen_files, Variant *r_metadata) {
+	Error error;
+	String code = FileAccess::get_file_as_string(p_source_file, &error);
+	if (error != OK) {
+		return error;
+	}
+
+	// Like do_file, skips a UTF-8 BOM and a first line starting with #. The newline stays so line numbers match.
+	if (code.begins_with(String::chr(0xFEFF))) {
+		code = code.substr(1);
+	}
+	if (code.begins_with("#")) {
+		int newline = code.find("\n");
+		code = newline == -1 ? String() : code.substr(newline);
+	}
+
+	// Named like a file chunk, so error messages and tracebacks show the script's path
+	Variant compiled = LuaBytecode::compile(code, "@" + p_source_file, p_options["strip_debug_info"]);
+	Ref<LuaBytecode> bytecode = Object::cast_to<LuaBytecode>(compiled);
+	if (bytecode.is_null()) {
+		Ref<LuaError> err = Object::cast_to<LuaError>(compiled);
+		ERR_FAIL_COND_V_MSG(err.is_valid(), ERR_PARSE_ERROR, err->getMessage());
+		return ERR_PARSE_ERROR;
+	}
+
+	bytecode->setSourceHash(FileAccess::get_md5(p_source_file));
+	return ResourceSaver::save(bytecode, p_save_path + ".res");
+}
+
+#endif
@@ -0,0 +1,128 @@
+#include "luaModuleCache.h"
+
+#include <luaState.h>
+
+#ifndef LAPI_GDEXTENSION
+#include "core/io/dir_access.h"
+#include "core/io/file_access.h"
+#else
+#include <godot_cpp/classes/dir_access.hpp>
+#include <godot_cpp/classes/file_access.hpp>
+#endif
+
+#ifndef LAPI_GDEXTENSION
+BinaryMutex LuaModuleCache::mutex;
+#else
+Ref<Mutex> LuaModuleCache::mutex;
+#endif
+HashMap<String, HashSet<String>> LuaModuleCache::indexes;
+HashMap<String, LuaModuleCache::Module> LuaModuleCache::modules;
+
+// Returns the file the module name resolves to with the ; separated templates in modulePath, or an empty String.
+String LuaModuleCache::resolve(const String &name, const String &modulePath) {
+	String file = name.replace(".", "/");
+	PackedStringArray templates = modulePath.split(";", false);
+
+	MutexLock lock(getMutex());
+	for (int i = 0; i < templates.size(); i++) {
+		const String &pattern = templates[i];
+		int wildcard = pattern.find("?");
+		if (wildcard < 0) {
+			continue;
+		}
+
+		String candidate = pattern.replace("?", file);
+		if (getIndex(pattern.substr(0, wildcard).get_base_dir()).has(candidate)) {
+			return candidate;
+		}
+	}
+	return String();
+}
+
+// Pushes the module in path as a function, compiling it only the first time any state loads it or after the file changed.
+LuaError *LuaModuleCache::load(lua_State *state, const String &path) {
+	uint64_t modifiedTime = FileAccess::get_modified_time(path);
+	Ref<LuaBytecode> bytecode;
+	{
+		MutexLock lock(getMutex());
+		if (const Module *cached = modules.getptr(path); cached != nullptr && cached->modifiedTime == modifiedTime) {
+			bytecode = cached->bytecode;
+		}
+	}
+
+	if (bytecode.is_valid()) {
+		return bytecode->load(state, "@" + path);
+	}
+
+	LuaError *err = LuaState::loadFile(state, path);
+	if (err != nullptr) {
+		return err;
+	}
+
+	Module module;
+	module.bytecode = LuaBytecode::dump(state, false);
+	module.modifiedTime = modifiedTime;
+
+	MutexLock lock(getMutex());
+	modules.insert(path, module);
+	return nullptr;
+}
+
+void LuaModuleCache::initialize() {
+#ifdef LAPI_GDEXTENSION
+	mutex.instantiate();
+#endif
+}
+
+// The cached bytecode must be freed before ObjectDB is cleaned up
+void LuaModuleCache::finalize() {
+	clear();
+#ifdef LAPI_GDEXTENSION
+	mutex.unref();
+#endif
+}
+
+void LuaModuleCache::clear() {
+	MutexLock lock(getMutex());
+	indexes.clear();
+	modules.clear();
+}
+
+// Expects the mutex to be held
+const HashSet<String> &LuaModuleCache::getIndex(const String &dir) {
+	if (HashSet<String> *index = indexes.getptr(dir); index != nullptr) {
+		return *index;
+	}
+
+	HashSet<String> index;
+	indexDirectory(dir, index);
+	indexes.insert(dir, index);
+	return indexes[dir];
+}
+
+void LuaModuleCache::indexDirectory(const String &dir, HashSet<String> &index) {
+	Ref<DirAccess> access = DirAccess::open(dir);
+	if (access.is_null()) {
+		return;
+	}
+
+	access->list_dir_begin();
+	for (String entry = access->get_next(); !entry.is_empty(); entry = access->get_next()) {
+		if (entry == "." || entry == "..") {
+			continue;
+		}
+
+		String path = dir.path_join(entry);
+		if (access->current_is_dir()) {
+			indexDirectory(path, index);
+			continue;
+		}
+
+		// Exported projects only have the .import or .remap file of an imported script, LuaState::loadFile still finds its bytecode
+		if (path.ends_with(".import") || path.ends_with(".remap")) {
+			path = path.get_basename();
+		}
+		index.insert(path);
+	}
+	access->list_dir_end();
+}
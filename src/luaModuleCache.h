@@ -0,0 +1,70 @@
+#ifndef LUAMODULECACHE_H
+#define LUAMODULECACHE_H
+
+#ifndef LAPI_GDEXTENSION
+#include "core/os/mutex.h"
+#include "core/string/ustring.h"
+#include "core/templates/hash_map.h"
+#include "core/templates/hash_set.h"
+#else
+#include <godot_cpp/classes/mutex.hpp>
+#include <godot_cpp/core/mutex_lock.hpp>
+#include <godot_cpp/templates/hash_map.hpp>
+#include <godot_cpp/templates/hash_set.hpp>
+#include <godot_cpp/variant/string.hpp>
+#endif
+
+#include <classes/luaBytecode.h>
+#include <classes/luaError.h>
+#include <lua/lua.hpp>
+
+#ifdef LAPI_GDEXTENSION
+using namespace godot;
+#endif
+
+// Backs the require searcher LuaState installs with the package library. Shared by every state, so it is locked.
+// Each directory a module path template searches is listed once into an index, resolving a module is then
+// a few hash lookups instead of a file system probe per template. Every module file is compiled once,
+// other states requiring it load the bytecode until the file's modification time changes.
+// The indexes don't notice files being added or removed until clear() is called.
+class LuaModuleCache {
+public:
+	static String resolve(const String &name, const String &modulePath);
+	static LuaError *load(lua_State *state, const String &path);
+	static void clear();
+
+	// Called when the module is initialized and uninitialized
+	static void initialize();
+	static void finalize();
+
+private:
+#ifndef LAPI_GDEXTENSION
+	static BinaryMutex mutex;
+#else
+	// godot-cpp's Mutex is an engine object, so it only exists between initialize() and finalize()
+	static Ref<Mutex> mutex;
+#endif
+	// Every file below a directory, keyed by the directory
+	static HashMap<String, HashSet<String>> indexes;
+	struct Module {
+		Ref<LuaBytecode> bytecode;
+		uint64_t modifiedTime = 0;
+	};
+
+	static HashMap<String, Module> modules;
+
+	static const HashSet<String> &getIndex(const String &dir);
+
+#ifndef LAPI_GDEXTENSION
+	static inline BinaryMutex &getMutex() {
+		return mutex;
+	}
+#else
+	static inline Mutex &getMutex() {
+		return *mutex.ptr();
+	}
+#endif
+	static void indexDirectory(const String &dir, HashSet<String> &index);
+};
+
+#endif
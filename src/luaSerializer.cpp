@@ -0,0 +1,1027 @@
+#include "luaSerializer.h"
+
+#include <luaState.h>
+
+#include <string.h>
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define LAPI_SERIALIZE_SWAP
+#endif
+
+static const uint8_t SERIALIZED_MAGIC[4] = { 'L', 'A', 'P', 'S' };
+
+// The format is little-endian, reverses the bytes of each of the count scalars on big-endian hosts
+static inline void toLittleEndian(uint8_t *bytes, int64_t count, int size) {
+#ifdef LAPI_SERIALIZE_SWAP
+	for (int64_t i = 0; i < count; i++) {
+		uint8_t *scalar = bytes + i * size;
+		for (int a = 0, b = size - 1; a < b; a++, b--) {
+			uint8_t byte = scalar[a];
+			scalar[a] = scalar[b];
+			scalar[b] = byte;
+		}
+	}
+#endif
+}
+
+// Every value starts with one of these tags
+enum SerializedTag : uint8_t {
+	TAG_NIL,
+	TAG_FALSE,
+	TAG_TRUE,
+	TAG_INTEGER, // int64
+	TAG_NUMBER, // double
+	TAG_STRING, // uint32 length, UTF-8 bytes
+	TAG_TABLE, // uint32 array count, array values, uint32 pair count, key value pairs
+	TAG_REF, // uint32 id of a table written before, tables are numbered from 1 in the order they are written
+	TAG_VALUE, // uint8 Variant::Type, the components as doubles
+	TAG_PACKED, // uint8 Variant::Type, uint32 count, the elements
+};
+
+// Appends to a buffer which grows by doubling, so writing a byte is not a resize
+class SerializeWriter {
+public:
+	PackedByteArray &data;
+	uint8_t *buffer;
+	int64_t length = 0;
+
+	SerializeWriter(PackedByteArray &data) :
+			data(data) {
+		data.resize(256);
+		buffer = data.ptrw();
+	}
+
+	void write(const void *bytes, int64_t size) {
+		if (length + size > data.size()) {
+			int64_t capacity = data.size();
+			while (capacity < length + size) {
+				capacity *= 2;
+			}
+			data.resize(capacity);
+			buffer = data.ptrw();
+		}
+		memcpy(buffer + length, bytes, size);
+		length += size;
+	}
+
+	// Writes count scalars of size bytes each
+	void writeScalars(const void *values, int64_t count, int size) {
+		write(values, count * size);
+		toLittleEndian(buffer + length - count * size, count, size);
+	}
+
+	void writeHeader() {
+		write(SERIALIZED_MAGIC, sizeof(SERIALIZED_MAGIC));
+		writeU8(LAPI_SERIALIZE_VERSION);
+	}
+
+	void writeTag(SerializedTag tag) {
+		write(&tag, 1);
+	}
+
+	void writeU8(uint8_t value) {
+		write(&value, 1);
+	}
+
+	void writeU32(uint32_t value) {
+		writeScalars(&value, 1, sizeof(value));
+	}
+
+	void writeI64(int64_t value) {
+		writeScalars(&value, 1, sizeof(value));
+	}
+
+	void writeDouble(double value) {
+		writeScalars(&value, 1, sizeof(value));
+	}
+
+	void writeString(const CharString &utf8) {
+		writeU32((uint32_t)utf8.length());
+		write(utf8.get_data(), utf8.length());
+	}
+
+	// Reserves a uint32 to be filled in by patchU32 once the value is known
+	int64_t reserveU32() {
+		writeU32(0);
+		return length - sizeof(uint32_t);
+	}
+
+	void patchU32(int64_t offset, uint32_t value) {
+		memcpy(buffer + offset, &value, sizeof(value));
+		toLittleEndian(buffer + offset, 1, sizeof(value));
+	}
+
+	void finish() {
+		data.resize(length);
+	}
+};
+
+class SerializeReader {
+public:
+	const uint8_t *data;
+	int64_t size;
+	int64_t position = 0;
+
+	SerializeReader(const uint8_t *data, int64_t size) :
+			data(data), size(size) {}
+
+	bool read(void *bytes, int64_t count) {
+		if (count > size - position) {
+			return false;
+		}
+		memcpy(bytes, data + position, count);
+		position += count;
+		return true;
+	}
+
+	// Reads count scalars of size bytes each
+	bool readScalars(void *values, int64_t count, int size) {
+		if (!read(values, count * size)) {
+			return false;
+		}
+		toLittleEndian((uint8_t *)values, count, size);
+		return true;
+	}
+
+	bool readU32(uint32_t &value) {
+		return readScalars(&value, 1, sizeof(value));
+	}
+
+	bool readI64(int64_t &value) {
+		return readScalars(&value, 1, sizeof(value));
+	}
+
+	bool readDouble(double &value) {
+		return readScalars(&value, 1, sizeof(value));
+	}
+
+	bool readDoubles(double *values, int count) {
+		return readScalars(values, count, sizeof(double));
+	}
+
+	bool readHeader() {
+		uint8_t magic[sizeof(SERIALIZED_MAGIC)];
+		uint8_t version;
+		return read(magic, sizeof(magic)) && memcmp(magic, SERIALIZED_MAGIC, sizeof(magic)) == 0 && read(&version, 1) && version == LAPI_SERIALIZE_VERSION;
+	}
+
+	// Returns a pointer to the next count bytes and skips them, nullptr if there are not enough left
+	const uint8_t *skip(int64_t count) {
+		if (count > size - position) {
+			return nullptr;
+		}
+		const uint8_t *bytes = data + position;
+		position += count;
+		return bytes;
+	}
+
+	bool readString(String &out) {
+		uint32_t length;
+		const uint8_t *str;
+		if (!readU32(length) || (str = skip(length)) == nullptr) {
+			return false;
+		}
+		out = String::utf8((const char *)str, length);
+		return true;
+	}
+};
+
+static LuaError *truncatedError() {
+	return LuaError::newError("serialized data is truncated or corrupt", LuaError::ERR_RUNTIME);
+}
+
+static LuaError *headerError() {
+	return LuaError::newError(vformat("serialized data has no header or was written by a version other than %d", LAPI_SERIALIZE_VERSION), LuaError::ERR_RUNTIME);
+}
+
+static LuaError *depthError() {
+	return LuaError::newError(vformat("tables nested deeper than %d can't be serialized", LAPI_SERIALIZE_MAX_DEPTH), LuaError::ERR_RUNTIME);
+}
+
+// -------------
+// BUILTIN TYPES
+// -------------
+
+// Elements are written as a block of scalars of size S, so little-endian hosts copy them in one go
+template <typename T, int S>
+static void writePackedRaw(SerializeWriter &writer, const T &array) {
+	writer.writeU32((uint32_t)array.size());
+	if (array.size() > 0) {
+		writer.writeScalars(array.ptr(), array.size() * sizeof(array.ptr()[0]) / S, S);
+	}
+}
+
+template <typename T, int S>
+static bool readPackedRaw(SerializeReader &reader, uint32_t count, Variant &out) {
+	T array;
+	array.resize(count);
+	if (count > 0 && !reader.readScalars(array.ptrw(), (int64_t)count * sizeof(array.ptr()[0]) / S, S)) {
+		return false;
+	}
+	out = array;
+	return true;
+}
+
+// Writes the value types and packed arrays, which Lua holds as userdata
+static LuaError *writeBuiltin(const Variant &var, SerializeWriter &writer) {
+	Variant::Type type = var.get_type();
+	switch (type) {
+		case Variant::VECTOR2: {
+			Vector2 value = var;
+			writer.writeTag(TAG_VALUE);
+			writer.writeU8(type);
+			writer.writeDouble(value.x);
+			writer.writeDouble(value.y);
+			return nullptr;
+		}
+		case Variant::VECTOR3: {
+			Vector3 value = var;
+			writer.writeTag(TAG_VALUE);
+			writer.writeU8(type);
+			writer.writeDouble(value.x);
+			writer.writeDouble(value.y);
+			writer.writeDouble(value.z);
+			return nullptr;
+		}
+		case Variant::COLOR: {
+			Color value = var;
+			writer.writeTag(TAG_VALUE);
+			writer.writeU8(type);
+			writer.writeDouble(value.r);
+			writer.writeDouble(value.g);
+			writer.writeDouble(value.b);
+			writer.writeDouble(value.a);
+			return nullptr;
+		}
+		case Variant::RECT2: {
+			Rect2 value = var;
+			writer.writeTag(TAG_VALUE);
+			writer.writeU8(type);
+			writer.writeDouble(value.position.x);
+			writer.writeDouble(value.position.y);
+			writer.writeDouble(value.size.x);
+			writer.writeDouble(value.size.y);
+			return nullptr;
+		}
+		case Variant::PLANE: {
+			Plane value = var;
+			writer.writeTag(TAG_VALUE);
+			writer.writeU8(type);
+			writer.writeDouble(value.normal.x);
+			writer.writeDouble(value.normal.y);
+			writer.writeDouble(value.normal.z);
+			writer.writeDouble(value.d);
+			return nullptr;
+		}
+		default:
+			break;
+	}
+
+	writer.writeTag(TAG_PACKED);
+	writer.writeU8(type);
+	switch (type) {
+		case Variant::PACKED_BYTE_ARRAY:
+			writePackedRaw<PackedByteArray, 1>(writer, var.operator PackedByteArray());
+			return nullptr;
+		case Variant::PACKED_INT32_ARRAY:
+			writePackedRaw<PackedInt32Array, 4>(writer, var.operator PackedInt32Array());
+			return nullptr;
+		case Variant::PACKED_INT64_ARRAY:
+			writePackedRaw<PackedInt64Array, 8>(writer, var.operator PackedInt64Array());
+			return nullptr;
+		case Variant::PACKED_FLOAT32_ARRAY:
+			writePackedRaw<PackedFloat32Array, 4>(writer, var.operator PackedFloat32Array());
+			return nullptr;
+		case Variant::PACKED_FLOAT64_ARRAY:
+			writePackedRaw<PackedFloat64Array, 8>(writer, var.operator PackedFloat64Array());
+			return nullptr;
+		case Variant::PACKED_STRING_ARRAY: {
+			PackedStringArray array = var;
+			writer.writeU32((uint32_t)array.size());
+			for (int i = 0; i < array.size(); i++) {
+				writer.writeString(array[i].utf8());
+			}
+			return nullptr;
+		}
+		case Variant::PACKED_VECTOR2_ARRAY: {
+			PackedVector2Array array = var;
+			writer.writeU32((uint32_t)array.size());
+			for (int i = 0; i < array.size(); i++) {
+				writer.writeDouble(array[i].x);
+				writer.writeDouble(array[i].y);
+			}
+			return nullptr;
+		}
+		case Variant::PACKED_VECTOR3_ARRAY: {
+			PackedVector3Array array = var;
+			writer.writeU32((uint32_t)array.size());
+			for (int i = 0; i < array.size(); i++) {
+				writer.writeDouble(array[i].x);
+				writer.writeDouble(array[i].y);
+				writer.writeDouble(array[i].z);
+			}
+			return nullptr;
+		}
+		case Variant::PACKED_COLOR_ARRAY:
+			// Colors are floats whatever real_t is
+			writePackedRaw<PackedColorArray, 4>(writer, var.operator PackedColorArray());
+			return nullptr;
+		default:
+			return LuaError::newError(vformat("Variants of type \"%s\" can't be serialized.", Variant::get_type_name(type)), LuaError::ERR_TYPE);
+	}
+}
+
+// Reads what writeBuiltin wrote, after the tag
+static LuaError *readBuiltin(SerializeReader &reader, SerializedTag tag, Variant &out) {
+	uint8_t type;
+	if (!reader.read(&type, 1)) {
+		return truncatedError();
+	}
+
+	double c[4];
+	if (tag == TAG_VALUE) {
+		switch (type) {
+			case Variant::VECTOR2:
+				if (!reader.readDoubles(c, 2)) {
+					return truncatedError();
+				}
+				out = Vector2(c[0], c[1]);
+				return nullptr;
+			case Variant::VECTOR3:
+				if (!reader.readDoubles(c, 3)) {
+					return truncatedError();
+				}
+				out = Vector3(c[0], c[1], c[2]);
+				return nullptr;
+			case Variant::COLOR:
+				if (!reader.readDoubles(c, 4)) {
+					return truncatedError();
+				}
+				out = Color(c[0], c[1], c[2], c[3]);
+				return nullptr;
+			case Variant::RECT2:
+				if (!reader.readDoubles(c, 4)) {
+					return truncatedError();
+				}
+				out = Rect2(c[0], c[1], c[2], c[3]);
+				return nullptr;
+			case Variant::PLANE:
+				if (!reader.readDoubles(c, 4)) {
+					return truncatedError();
+				}
+				out = Plane(c[0], c[1], c[2], c[3]);
+				return nullptr;
+			default:
+				return truncatedError();
+		}
+	}
+
+	uint32_t count;
+	// Every element takes at least a byte, a bogus count can't allocate a huge array
+	if (!reader.readU32(count) || count > reader.size - reader.position) {
+		return truncatedError();
+	}
+
+	bool ok = false;
+	switch (type) {
+		case Variant::PACKED_BYTE_ARRAY:
+			ok = readPackedRaw<PackedByteArray, 1>(reader, count, out);
+			break;
+		case Variant::PACKED_INT32_ARRAY:
+			ok = readPackedRaw<PackedInt32Array, 4>(reader, count, out);
+			break;
+		case Variant::PACKED_INT64_ARRAY:
+			ok = readPackedRaw<PackedInt64Array, 8>(reader, count, out);
+			break;
+		case Variant::PACKED_FLOAT32_ARRAY:
+			ok = readPackedRaw<PackedFloat32Array, 4>(reader, count, out);
+			break;
+		case Variant::PACKED_FLOAT64_ARRAY:
+			ok = readPackedRaw<PackedFloat64Array, 8>(reader, count, out);
+			break;
+		case Variant::PACKED_COLOR_ARRAY:
+			ok = readPackedRaw<PackedColorArray, 4>(reader, count, out);
+			break;
+		case Variant::PACKED_STRING_ARRAY: {
+			PackedStringArray array;
+			array.resize(count);
+			ok = true;
+			for (uint32_t i = 0; i < count && ok; i++) {
+				String value;
+				ok = reader.readString(value);
+				array.set(i, value);
+			}
+			out = array;
+			break;
+		}
+		case Variant::PACKED_VECTOR2_ARRAY: {
+			PackedVector2Array array;
+			array.resize(count);
+			ok = true;
+			for (uint32_t i = 0; i < count && ok; i++) {
+				ok = reader.readDoubles(c, 2);
+				array.set(i, Vector2(c[0], c[1]));
+			}
+			out = array;
+			break;
+		}
+		case Variant::PACKED_VECTOR3_ARRAY: {
+			PackedVector3Array array;
+			array.resize(count);
+			ok = true;
+			for (uint32_t i = 0; i < count && ok; i++) {
+				ok = reader.readDoubles(c, 3);
+				array.set(i, Vector3(c[0], c[1], c[2]));
+			}
+			out = array;
+			break;
+		}
+		default:
+			break;
+	}
+	return ok ? nullptr : truncatedError();
+}
+
+// ----------
+// LUA VALUES
+// ----------
+
+struct LuaWriteContext {
+	lua_State *state;
+	SerializeWriter &writer;
+	// Stack index of a table mapping the tables written so far to their id
+	int seen;
+	uint32_t tables = 0;
+};
+
+static LuaError *writeLuaValue(LuaWriteContext &ctx, int index, int depth);
+
+static LuaError *writeLuaTable(LuaWriteContext &ctx, int index, int depth) {
+	lua_State *state = ctx.state;
+	SerializeWriter &writer = ctx.writer;
+
+	lua_pushvalue(state, index);
+	lua_rawget(state, ctx.seen);
+	if (!lua_isnil(state, -1)) {
+		writer.writeTag(TAG_REF);
+		writer.writeU32((uint32_t)lua_tointeger(state, -1));
+		lua_pop(state, 1);
+		return nullptr;
+	}
+	lua_pop(state, 1);
+
+	if (depth >= LAPI_SERIALIZE_MAX_DEPTH) {
+		return depthError();
+	}
+	if (!lua_checkstack(state, 3)) {
+		return LuaError::newError("stack overflow while serializing", LuaError::ERR_RUNTIME);
+	}
+
+	lua_pushvalue(state, index);
+	lua_pushinteger(state, ++ctx.tables);
+	lua_rawset(state, ctx.seen);
+
+#ifndef LAPI_LUAJIT
+	lua_Integer count = lua_rawlen(state, index);
+#else
+	lua_Integer count = lua_objlen(state, index);
+#endif
+	writer.writeTag(TAG_TABLE);
+	writer.writeU32((uint32_t)count);
+	for (lua_Integer i = 1; i <= count; i++) {
+		lua_rawgeti(state, index, i);
+		LuaError *err = writeLuaValue(ctx, lua_gettop(state), depth + 1);
+		lua_pop(state, 1);
+		if (err != nullptr) {
+			return err;
+		}
+	}
+
+	// The array part was written already, everything else goes in the pairs
+	int64_t pairsOffset = writer.reserveU32();
+	uint32_t pairs = 0;
+	lua_pushnil(state);
+	while (lua_next(state, index) != 0) {
+		if (lua_type(state, -2) == LUA_TNUMBER) {
+			lua_Number key = lua_tonumber(state, -2);
+			if (key >= 1 && key <= count && key == (lua_Number)(lua_Integer)key) {
+				lua_pop(state, 1);
+				continue;
+			}
+		}
+
+		int top = lua_gettop(state);
+		LuaError *err = writeLuaValue(ctx, top - 1, depth + 1);
+		if (err == nullptr) {
+			err = writeLuaValue(ctx, top, depth + 1);
+		}
+		if (err != nullptr) {
+			lua_pop(state, 2);
+			return err;
+		}
+
+		pairs++;
+		lua_pop(state, 1);
+	}
+	writer.patchU32(pairsOffset, pairs);
+	return nullptr;
+}
+
+// index must be absolute
+static LuaError *writeLuaValue(LuaWriteContext &ctx, int index, int depth) {
+	lua_State *state = ctx.state;
+	SerializeWriter &writer = ctx.writer;
+
+	switch (lua_type(state, index)) {
+		case LUA_TNIL:
+			writer.writeTag(TAG_NIL);
+			return nullptr;
+		case LUA_TBOOLEAN:
+			writer.writeTag(lua_toboolean(state, index) ? TAG_TRUE : TAG_FALSE);
+			return nullptr;
+		case LUA_TNUMBER: {
+#if LUA_VERSION_NUM >= 503
+			if (lua_isinteger(state, index)) {
+				int64_t value = lua_tointeger(state, index);
+				writer.writeTag(TAG_INTEGER);
+				writer.writeI64(value);
+				return nullptr;
+			}
+#endif
+			writer.writeTag(TAG_NUMBER);
+			writer.writeDouble(lua_tonumber(state, index));
+			return nullptr;
+		}
+		case LUA_TSTRING: {
+			size_t length;
+			const char *str = lua_tolstring(state, index, &length);
+			writer.writeTag(TAG_STRING);
+			writer.writeU32((uint32_t)length);
+			writer.write(str, length);
+			return nullptr;
+		}
+		case LUA_TTABLE:
+			return writeLuaTable(ctx, index, depth);
+		case LUA_TUSERDATA: {
+			Variant::Type type = LuaState::getUserdataType(state, index);
+			switch (type) {
+				case Variant::VECTOR2:
+				case Variant::VECTOR3:
+				case Variant::COLOR:
+				case Variant::RECT2:
+				case Variant::PLANE:
+					return writeBuiltin(LuaState::getValueType(state, index, type), writer);
+				case Variant::STRING_NAME: {
+					writer.writeTag(TAG_STRING);
+					writer.writeString(String(*(StringName *)lua_touserdata(state, index)).utf8());
+					return nullptr;
+				}
+				case Variant::PACKED_BYTE_ARRAY:
+				case Variant::PACKED_INT32_ARRAY:
+				case Variant::PACKED_INT64_ARRAY:
+				case Variant::PACKED_FLOAT32_ARRAY:
+				case Variant::PACKED_FLOAT64_ARRAY:
+				case Variant::PACKED_STRING_ARRAY:
+				case Variant::PACKED_VECTOR2_ARRAY:
+				case Variant::PACKED_VECTOR3_ARRAY:
+				case Variant::PACKED_COLOR_ARRAY:
+					// The Variant shares the userdata's buffer, this is not a copy
+					return writeBuiltin(LuaState::getPackedArray(state, index, type), writer);
+				default:
+					return LuaError::newError("objects, signals and callables can't be serialized", LuaError::ERR_TYPE);
+			}
+		}
+		default:
+			return LuaError::newError(vformat("values of type '%s' can't be serialized", lua_typename(state, lua_type(state, index))), LuaError::ERR_TYPE);
+	}
+}
+
+struct LuaReadContext {
+	lua_State *state;
+	SerializeReader &reader;
+	// Stack index of a table holding the tables read so far at their id
+	int tables;
+	uint32_t count = 0;
+};
+
+static LuaError *readLuaValue(LuaReadContext &ctx, int depth) {
+	lua_State *state = ctx.state;
+	SerializeReader &reader = ctx.reader;
+
+	uint8_t tag;
+	if (!reader.read(&tag, 1)) {
+		return truncatedError();
+	}
+	if (!lua_checkstack(state, 3)) {
+		return LuaError::newError("stack overflow while deserializing", LuaError::ERR_RUNTIME);
+	}
+
+	switch (tag) {
+		case TAG_NIL:
+			lua_pushnil(state);
+			return nullptr;
+		case TAG_FALSE:
+		case TAG_TRUE:
+			lua_pushboolean(state, tag == TAG_TRUE);
+			return nullptr;
+		case TAG_INTEGER: {
+			int64_t value;
+			if (!reader.readI64(value)) {
+				return truncatedError();
+			}
+			lua_pushinteger(state, (lua_Integer)value);
+			return nullptr;
+		}
+		case TAG_NUMBER: {
+			double value;
+			if (!reader.readDouble(value)) {
+				return truncatedError();
+			}
+			lua_pushnumber(state, value);
+			return nullptr;
+		}
+		case TAG_STRING: {
+			uint32_t length;
+			const uint8_t *str;
+			if (!reader.readU32(length) || (str = reader.skip(length)) == nullptr) {
+				return truncatedError();
+			}
+			lua_pushlstring(state, (const char *)str, length);
+			return nullptr;
+		}
+		case TAG_REF: {
+			uint32_t id;
+			if (!reader.readU32(id) || id == 0 || id > ctx.count) {
+				return truncatedError();
+			}
+			lua_rawgeti(state, ctx.tables, id);
+			return nullptr;
+		}
+		case TAG_VALUE:
+		case TAG_PACKED: {
+			Variant value;
+			LuaError *err = readBuiltin(reader, (SerializedTag)tag, value);
+			if (err != nullptr) {
+				return err;
+			}
+			return LuaState::pushVariant(state, value);
+		}
+		case TAG_TABLE: {
+			if (depth >= LAPI_SERIALIZE_MAX_DEPTH) {
+				return depthError();
+			}
+
+			uint32_t count;
+			// Every value takes at least a byte, a bogus count can't presize a huge table
+			if (!reader.readU32(count) || count > reader.size - reader.position) {
+				return truncatedError();
+			}
+
+			lua_createtable(state, count, 0);
+			// Registered before its content is read, so references to it from inside resolve
+			lua_pushvalue(state, -1);
+			lua_rawseti(state, ctx.tables, ++ctx.count);
+
+			for (uint32_t i = 1; i <= count; i++) {
+				LuaError *err = readLuaValue(ctx, depth + 1);
+				if (err != nullptr) {
+					lua_pop(state, 1);
+					return err;
+				}
+				lua_rawseti(state, -2, i);
+			}
+
+			uint32_t pairs;
+			if (!reader.readU32(pairs)) {
+				lua_pop(state, 1);
+				return truncatedError();
+			}
+			for (uint32_t i = 0; i < pairs; i++) {
+				LuaError *err = readLuaValue(ctx, depth + 1);
+				if (err == nullptr) {
+					err = readLuaValue(ctx, depth + 1);
+					if (err != nullptr) {
+						lua_pop(state, 1);
+					}
+				}
+				if (err != nullptr) {
+					lua_pop(state, 1);
+					return err;
+				}
+				// lua_rawset raises an error for these keys
+				if (lua_isnil(state, -2) || (lua_type(state, -2) == LUA_TNUMBER && lua_tonumber(state, -2) != lua_tonumber(state, -2))) {
+					lua_pop(state, 3);
+					return truncatedError();
+				}
+				lua_rawset(state, -3);
+			}
+			return nullptr;
+		}
+		default:
+			return truncatedError();
+	}
+}
+
+// Writes the value at index to out
+LuaError *LuaSerializer::serialize(lua_State *state, int index, PackedByteArray &out) {
+	// lua_absindex is not in 5.1
+	if (index < 0 && index > LUA_REGISTRYINDEX) {
+		index = lua_gettop(state) + index + 1;
+	}
+
+	SerializeWriter writer(out);
+	writer.writeHeader();
+	lua_newtable(state);
+	LuaWriteContext ctx = { state, writer, lua_gettop(state) };
+	LuaError *err = writeLuaValue(ctx, index, 0);
+	lua_pop(state, 1);
+	writer.finish();
+	return err;
+}
+
+// Pushes the value read from data. Pushes nothing when it fails.
+LuaError *LuaSerializer::deserialize(lua_State *state, const uint8_t *data, int64_t size) {
+	SerializeReader reader(data, size);
+	if (!reader.readHeader()) {
+		return headerError();
+	}
+
+	lua_newtable(state);
+	LuaReadContext ctx = { state, reader, lua_gettop(state) };
+	LuaError *err = readLuaValue(ctx, 0);
+	if (err == nullptr && reader.position != size) {
+		lua_pop(state, 1);
+		err = truncatedError();
+	}
+
+	if (err != nullptr) {
+		lua_pop(state, 1);
+		return err;
+	}
+	lua_remove(state, -2);
+	return nullptr;
+}
+
+// --------
+// VARIANTS
+// --------
+
+static LuaError *writeVariant(const Variant &var, SerializeWriter &writer, int depth) {
+	switch (var.get_type()) {
+		case Variant::NIL:
+			writer.writeTag(TAG_NIL);
+			return nullptr;
+		case Variant::BOOL:
+			writer.writeTag((bool)var ? TAG_TRUE : TAG_FALSE);
+			return nullptr;
+		case Variant::INT: {
+			int64_t value = var;
+			writer.writeTag(TAG_INTEGER);
+			writer.writeI64(value);
+			return nullptr;
+		}
+		case Variant::FLOAT:
+			writer.writeTag(TAG_NUMBER);
+			writer.writeDouble(var);
+			return nullptr;
+		case Variant::STRING:
+		case Variant::STRING_NAME:
+			writer.writeTag(TAG_STRING);
+			writer.writeString(var.operator String().utf8());
+			return nullptr;
+		case Variant::ARRAY: {
+			if (depth >= LAPI_SERIALIZE_MAX_DEPTH) {
+				return depthError();
+			}
+
+			Array array = var;
+			writer.writeTag(TAG_TABLE);
+			writer.writeU32((uint32_t)array.size());
+			for (int i = 0; i < array.size(); i++) {
+				LuaError *err = writeVariant(array[i], writer, depth + 1);
+				if (err != nullptr) {
+					return err;
+				}
+			}
+			writer.writeU32(0);
+			return nullptr;
+		}
+		case Variant::DICTIONARY: {
+			if (depth >= LAPI_SERIALIZE_MAX_DEPTH) {
+				return depthError();
+			}
+
+			Dictionary dict = var;
+			Array keys = dict.keys();
+			Array values = dict.values();
+			writer.writeTag(TAG_TABLE);
+			writer.writeU32(0);
+			int64_t pairsOffset = writer.reserveU32();
+			uint32_t pairs = 0;
+			for (int i = 0; i < keys.size(); i++) {
+				// lua tables can not hold nil keys, pushVariant skips them too
+				if (keys[i].get_type() == Variant::NIL) {
+					continue;
+				}
+
+				LuaError *err = writeVariant(keys[i], writer, depth + 1);
+				if (err == nullptr) {
+					err = writeVariant(values[i], writer, depth + 1);
+				}
+				if (err != nullptr) {
+					return err;
+				}
+				pairs++;
+			}
+			writer.patchU32(pairsOffset, pairs);
+			return nullptr;
+		}
+		default:
+			return writeBuiltin(var, writer);
+	}
+}
+
+// tables holds the Arrays and Dictionaries read so far at their id - 1, nil while they are still being read
+static LuaError *readVariant(SerializeReader &reader, Array &tables, Variant &out, int depth) {
+	uint8_t tag;
+	if (!reader.read(&tag, 1)) {
+		return truncatedError();
+	}
+
+	switch (tag) {
+		case TAG_NIL:
+			out = Variant();
+			return nullptr;
+		case TAG_FALSE:
+		case TAG_TRUE:
+			out = tag == TAG_TRUE;
+			return nullptr;
+		case TAG_INTEGER: {
+			int64_t value;
+			if (!reader.readI64(value)) {
+				return truncatedError();
+			}
+			out = value;
+			return nullptr;
+		}
+		case TAG_NUMBER: {
+			double value;
+			if (!reader.readDouble(value)) {
+				return truncatedError();
+			}
+			out = value;
+			return nullptr;
+		}
+		case TAG_STRING: {
+			String value;
+			if (!reader.readString(value)) {
+				return truncatedError();
+			}
+			out = value;
+			return nullptr;
+		}
+		case TAG_REF: {
+			uint32_t id;
+			if (!reader.readU32(id) || id == 0 || id > (uint32_t)tables.size()) {
+				return truncatedError();
+			}
+			out = tables[id - 1];
+			if (out.get_type() == Variant::NIL) {
+				return LuaError::newError("tables containing themselves can't be converted to Variants", LuaError::ERR_TYPE);
+			}
+			return nullptr;
+		}
+		case TAG_VALUE:
+		case TAG_PACKED:
+			return readBuiltin(reader, (SerializedTag)tag, out);
+		case TAG_TABLE: {
+			if (depth >= LAPI_SERIALIZE_MAX_DEPTH) {
+				return depthError();
+			}
+
+			uint32_t count;
+			if (!reader.readU32(count) || count > reader.size - reader.position) {
+				return truncatedError();
+			}
+
+			int id = tables.size();
+			tables.append(Variant());
+
+			Array array;
+			array.resize(count);
+			for (uint32_t i = 0; i < count; i++) {
+				Variant value;
+				LuaError *err = readVariant(reader, tables, value, depth + 1);
+				if (err != nullptr) {
+					return err;
+				}
+				array[i] = value;
+			}
+
+			uint32_t pairs;
+			if (!reader.readU32(pairs)) {
+				return truncatedError();
+			}
+
+			// Same as getVariant, a table with only an array part becomes an Array
+			if (pairs == 0 && count > 0) {
+				out = array;
+				tables[id] = out;
+				return nullptr;
+			}
+
+			Dictionary dict;
+			for (uint32_t i = 0; i < count; i++) {
+				dict[(int64_t)i + 1] = array[i];
+			}
+			for (uint32_t i = 0; i < pairs; i++) {
+				Variant key;
+				Variant value;
+				LuaError *err = readVariant(reader, tables, key, depth + 1);
+				if (err == nullptr) {
+					err = readVariant(reader, tables, value, depth + 1);
+				}
+				if (err != nullptr) {
+					return err;
+				}
+				dict[key] = value;
+			}
+			out = dict;
+			tables[id] = out;
+			return nullptr;
+		}
+		default:
+			return truncatedError();
+	}
+}
+
+// Writes var to out in the same form serialize writes Lua values in. Arrays and Dictionaries reached twice are written twice.
+LuaError *LuaSerializer::serializeVariant(const Variant &var, PackedByteArray &out) {
+	SerializeWriter writer(out);
+	writer.writeHeader();
+	LuaError *err = writeVariant(var, writer, 0);
+	writer.finish();
+	return err;
+}
+
+// Reads a value written by serialize or serializeVariant. Shared tables become shared Arrays or Dictionaries.
+LuaError *LuaSerializer::deserializeVariant(const uint8_t *data, int64_t size, Variant &out) {
+	SerializeReader reader(data, size);
+	if (!reader.readHeader()) {
+		return headerError();
+	}
+
+	Array tables;
+	LuaError *err = readVariant(reader, tables, out, 0);
+	if (err == nullptr && reader.position != size) {
+		return truncatedError();
+	}
+	return err;
+}
+
+// lua_serialize(value) -> PackedByteArray
+int LuaSerializer::luaSerialize(lua_State *state) {
+	lua_settop(state, 1);
+
+	// The error is raised outside of the scope, the buffer must be freed first
+	{
+		PackedByteArray bytes;
+		LuaError *err = serialize(state, 1, bytes);
+		if (err == nullptr) {
+			LuaState::pushPackedArray(state, bytes);
+			return 1;
+		}
+
+		LuaState::pushString(state, err->getMessage());
+		memdelete(err);
+	}
+	return lua_error(state);
+}
+
+// lua_deserialize(bytes) -> value, bytes is a PackedByteArray or a string
+int LuaSerializer::luaDeserialize(lua_State *state) {
+	lua_settop(state, 1);
+	bool isBytes = lua_type(state, 1) == LUA_TUSERDATA && LuaState::getUserdataType(state, 1) == Variant::PACKED_BYTE_ARRAY;
+	if (lua_type(state, 1) != LUA_TSTRING && !isBytes) {
+		return luaL_argerror(state, 1, "PackedByteArray or string expected");
+	}
+
+	{
+		LuaError *err;
+		if (lua_type(state, 1) == LUA_TSTRING) {
+			size_t length;
+			const char *data = lua_tolstring(state, 1, &length);
+			err = deserialize(state, (const uint8_t *)data, length);
+		} else {
+			PackedByteArray bytes = LuaState::getPackedArray(state, 1, Variant::PACKED_BYTE_ARRAY);
+			err = deserialize(state, bytes.ptr(), bytes.size());
+		}
+		if (err == nullptr) {
+			return 1;
+		}
+
+		LuaState::pushString(state, err->getMessage());
+		memdelete(err);
+	}
+	return lua_error(state);
+}
@@ -0,0 +1,41 @@
+#ifndef LUASERIALIZER_H
+#define LUASERIALIZER_H
+
+#ifndef LAPI_GDEXTENSION
+#include "core/variant/variant.h"
+#else
+#include <godot_cpp/variant/packed_byte_array.hpp>
+#include <godot_cpp/variant/variant.hpp>
+#endif
+
+#include <classes/luaError.h>
+#include <lua/lua.hpp>
+
+#ifdef LAPI_GDEXTENSION
+using namespace godot;
+#endif
+
+// Deepest table nesting serialize accepts
+#define LAPI_SERIALIZE_MAX_DEPTH 128
+// Written after the magic bytes "LAPS", bumped when the format changes
+#define LAPI_SERIALIZE_VERSION 1
+
+// Converts Lua values to a compact binary form and back, without building Variants on the way.
+// Values written from a Variant read back into Lua as the same values pushVariant would create, and the other way around.
+// nil, booleans, numbers, strings, the builtin value types, packed arrays and tables of those are supported.
+// A table reached more than once is written once, so shared tables stay shared and cycles survive a round trip through Lua.
+// The data starts with a magic and version header and is little-endian, so it can be read on any platform.
+class LuaSerializer {
+public:
+	static LuaError *serialize(lua_State *state, int index, PackedByteArray &out);
+	static LuaError *deserialize(lua_State *state, const uint8_t *data, int64_t size);
+
+	static LuaError *serializeVariant(const Variant &var, PackedByteArray &out);
+	static LuaError *deserializeVariant(const uint8_t *data, int64_t size, Variant &out);
+
+	// Lua functions
+	static int luaSerialize(lua_State *state);
+	static int luaDeserialize(lua_State *state);
+};
+
+#endif
@@ -1,12 +1,30 @@
 #include "luaState.h"
 #include "lua/lua.h"
 #include <classes/luaAPI.h>
+#include <classes/luaBytecode.h>
 #include <classes/luaCallableExtra.h>
+#include <classes/luaChannel.h>
 #include <classes/luaCoroutine.h>
+#include <classes/luaFunction.h>
 #include <classes/luaTuple.h>
+#include <luaModuleCache.h>
+#include <luaSerializer.h>
 
 #include <util.h>
 
+#ifndef LAPI_GDEXTENSION
+#include "core/os/os.h"
+#include "core/variant/variant_internal.h"
+#else
+#include <godot_cpp/classes/file_access.hpp>
+#include <godot_cpp/classes/time.hpp>
+#endif
+
+#ifndef lua_getextraspace
+// Only the address is used, as a registry key which can't collide with string keys
+static char apiRegistryKey;
+#endif
+
 void LuaState::setState(lua_State *L, LuaAPI *api, bool bindAPI) {
 	this->L = L;
 	this->api = api;
@@ -16,11 +34,17 @@ void LuaState::setState(lua_State *L, LuaAPI *api, bool bindAPI) {
 
 	// push our custom print function so by default it prints to the GDConsole.
 	lua_register(L, "print", luaPrint);
+	lua_register(L, "lua_serialize", LuaSerializer::luaSerialize);
+	lua_register(L, "lua_deserialize", LuaSerializer::luaDeserialize);
 
-	// saving the object into registry
-	lua_pushstring(L, "__LAPI__");
+	// saving the object where getAPI can find it, threads created later inherit the extra space
+#ifdef lua_getextraspace
+	*(LuaAPI **)lua_getextraspace(L) = api;
+#else
+	lua_pushlightuserdata(L, &apiRegistryKey);
 	lua_pushlightuserdata(L, api);
 	lua_rawset(L, LUA_REGISTRYINDEX);
+#endif
 
 	// Creating basic types metatables and saving them in registry
 	createVector2Metatable(); // "mt_Vector2"
@@ -32,6 +56,9 @@ void LuaState::setState(lua_State *L, LuaAPI *api, bool bindAPI) {
 	createObjectMetatable(); // "mt_Object"
 	createCallableMetatable(); // "mt_Callable"
 	createCallableExtraMetatable(); // "mt_CallableExtra"
+	createPackedArrayMetatables(); // "mt_PackedByteArray", "mt_PackedFloat32Array", ...
+	createMethodMetatables(); // "mt_StringName", "mt_BuiltinMethod"
+	createChannelMetatable(); // "mt_Channel"
 
 	// Exposing basic types constructors
 	exposeConstructors();
@@ -76,6 +103,7 @@ void LuaState::bindLibraries(Array libs) {
 		} else if (lib == "package") {
 			luaL_requiref(L, LUA_LOADLIBNAME, luaopen_package, 1);
 			lua_pop(L, 1);
+			installModuleSearcher();
 		} else if (lib == "utf8") {
 			luaL_requiref(L, LUA_UTF8LIBNAME, luaopen_utf8, 1);
 			lua_pop(L, 1);
@@ -123,28 +151,265 @@ void LuaState::bindLibraries(Array libs) {
 			lua_pushcfunction(L, luaopen_package);
 			lua_pushstring(L, LUA_LOADLIBNAME);
 			lua_call(L, 1, 0);
+			installModuleSearcher();
 		}
 	}
 }
 
 #endif
 
+// Inserts luaModuleSearcher after the preload searcher, so require finds modules through Godot's file system before the stock searchers look at the OS one.
+void LuaState::installModuleSearcher() {
+	lua_getglobal(L, LUA_LOADLIBNAME);
+#ifndef LAPI_LUAJIT
+	lua_getfield(L, -1, "searchers");
+	int count = (int)lua_rawlen(L, -1);
+#else
+	lua_getfield(L, -1, "loaders");
+	int count = (int)lua_objlen(L, -1);
+#endif
+	for (int i = count; i >= 2; i--) {
+		lua_rawgeti(L, -1, i);
+		lua_rawseti(L, -2, i + 1);
+	}
+
+	lua_pushcfunction(L, luaModuleSearcher);
+	lua_rawseti(L, -2, 2);
+	lua_pop(L, 2);
+}
+
 void LuaState::setHook(Callable hook, int mask, int count) {
 	if (hook.is_null()) {
+		mask = 0;
+		count = 0;
+	}
+
+	hookCallable = hook;
+	hookMask = mask;
+	hookCount = count;
+	updateHook();
+}
+
+void LuaState::setExecutionLimit(int64_t instructions, int64_t usec) {
+	instructionLimit = MAX(instructions, 0);
+	usecLimit = MAX(usec, 0);
+	updateHook();
+}
+
+// Installs luaHook for the events requested by setHook, plus count events while an execution limit is set.
+void LuaState::updateHook() {
+	int mask = hookMask;
+	if (instructionLimit > 0 || usecLimit > 0) {
+		mask |= LUA_MASKCOUNT;
+	}
+
+	if (mask == 0) {
 		lua_sethook(L, nullptr, 0, 0);
 		return;
 	}
+	lua_sethook(L, luaHook, mask, getHookCount());
+}
+
+// The instructions between two count events.
+int LuaState::getHookCount() const {
+	if ((hookMask & LUA_MASKCOUNT) && hookCount > 0) {
+		return hookCount;
+	}
+	if (instructionLimit > 0 || usecLimit > 0) {
+		return instructionLimit > 0 ? MIN(instructionLimit, (int64_t)LAPI_LIMIT_CHECK_INTERVAL) : LAPI_LIMIT_CHECK_INTERVAL;
+	}
+	return hookCount;
+}
+
+static uint64_t getTicksUsec() {
+#ifndef LAPI_GDEXTENSION
+	return OS::get_singleton()->get_ticks_usec();
+#else
+	return Time::get_singleton()->get_ticks_usec();
+#endif
+}
+
+// Makes this the active state, starting its execution budget unless Lua is re-entered from a callback. Returns the previously active state.
+LuaState *LuaState::beginExecution() {
+	LuaState *previous = api->getActiveState();
+	if (executionDepth++ == 0) {
+		limitExceeded = false;
+		instructionsLeft = instructionLimit;
+		if (usecLimit > 0) {
+			deadline = getTicksUsec() + usecLimit;
+		}
+	}
+
+	api->setActiveState(this);
+	return previous;
+}
+
+void LuaState::endExecution(LuaState *previous) {
+	executionDepth--;
+	api->setActiveState(previous);
+}
+
+bool LuaState::setEnforcingLimit(bool value) {
+	return api->setEnforcingLimit(value);
+}
+
+// Charges the instructions run since the last count event, returns false once the budget is exhausted.
+bool LuaState::chargeBudget(int instructions) {
+	if (limitExceeded) {
+		return false;
+	}
+
+	if (instructionLimit > 0) {
+		instructionsLeft -= instructions;
+		if (instructionsLeft < 0) {
+			limitExceeded = true;
+		}
+	}
+
+	if (usecLimit > 0 && getTicksUsec() >= deadline) {
+		limitExceeded = true;
+	}
+
+	return !limitExceeded;
+}
+
+// Records the table on the top of the stack and every table reachable from it, metatables included, into copies
+// (original -> shallow copy) and metatables (original -> metatable). Leaves the stack as it was.
+static void snapshotTable(lua_State *state, int copies, int metatables) {
+	int table = lua_gettop(state);
+	lua_pushvalue(state, table);
+	lua_rawget(state, copies);
+	bool seen = !lua_isnil(state, -1);
+	lua_pop(state, 1);
+	if (seen) {
+		return;
+	}
 
-	lua_pushstring(L, "__HOOK");
-	pushVariant(hook);
-	lua_settable(L, LUA_REGISTRYINDEX);
-	lua_sethook(L, luaHook, mask, count);
+	lua_checkstack(state, 8);
+	lua_newtable(state);
+	int copy = lua_gettop(state);
+	lua_pushvalue(state, table);
+	lua_pushvalue(state, copy);
+	lua_rawset(state, copies);
+
+	if (lua_getmetatable(state, table)) {
+		snapshotTable(state, copies, metatables);
+		lua_pushvalue(state, table);
+		lua_insert(state, -2);
+		lua_rawset(state, metatables);
+	}
+
+	lua_pushnil(state);
+	while (lua_next(state, table) != 0) {
+		lua_pushvalue(state, -2);
+		lua_pushvalue(state, -2);
+		lua_rawset(state, copy);
+		if (lua_type(state, -1) == LUA_TTABLE) {
+			snapshotTable(state, copies, metatables);
+		}
+		lua_pop(state, 1);
+	}
+
+	lua_pop(state, 1);
+}
+
+// Records the globals and every table reachable from them, e.g. the libraries, so restoreGlobals can return to this point.
+// The string metatable and the metatables of the native types are recorded too, scripts can reach and change them
+// through getmetatable.
+void LuaState::snapshotGlobals() {
+	if (snapshotRef != LUA_NOREF) {
+		luaL_unref(L, LUA_REGISTRYINDEX, snapshotRef);
+	}
+
+	lua_newtable(L);
+	int snapshot = lua_gettop(L);
+	lua_newtable(L);
+	lua_newtable(L);
+#ifndef LAPI_LUAJIT
+	lua_pushglobaltable(L);
+#else
+	lua_pushvalue(L, LUA_GLOBALSINDEX);
+#endif
+	snapshotTable(L, snapshot + 1, snapshot + 2);
+	lua_pop(L, 1);
+
+	for (int i = 0; i < METATABLE_MAX; i++) {
+		lua_rawgeti(L, LUA_REGISTRYINDEX, api->getMetatableRef((LuaMetatable)i));
+		if (lua_istable(L, -1)) {
+			snapshotTable(L, snapshot + 1, snapshot + 2);
+		}
+		lua_pop(L, 1);
+	}
+
+	// Strings share one metatable, the type's metatable itself is put back as well
+	lua_pushliteral(L, "");
+	if (lua_getmetatable(L, -1)) {
+		snapshotTable(L, snapshot + 1, snapshot + 2);
+		lua_rawseti(L, snapshot, 3);
+	}
+	lua_pop(L, 1);
+
+	lua_rawseti(L, snapshot, 2);
+	lua_rawseti(L, snapshot, 1);
+	snapshotRef = luaL_ref(L, LUA_REGISTRYINDEX);
+}
+
+// Puts the contents and metatables of every table snapshotGlobals recorded back. Anything scripts created since is
+// unreachable from the globals afterwards. The tables keep their identity, so functions holding them stay valid.
+// Returns false if there is no snapshot.
+bool LuaState::restoreGlobals() {
+	if (snapshotRef == LUA_NOREF) {
+		return false;
+	}
+
+	lua_rawgeti(L, LUA_REGISTRYINDEX, snapshotRef);
+	int snapshot = lua_gettop(L);
+	lua_rawgeti(L, snapshot, 1);
+	int copies = snapshot + 1;
+	lua_rawgeti(L, snapshot, 2);
+	int metatables = snapshot + 2;
+
+	lua_pushnil(L);
+	while (lua_next(L, copies) != 0) {
+		int original = lua_gettop(L) - 1;
+		int copy = original + 1;
+
+		// Clearing fields during a traversal is allowed
+		lua_pushnil(L);
+		while (lua_next(L, original) != 0) {
+			lua_pop(L, 1);
+			lua_pushvalue(L, -1);
+			lua_pushnil(L);
+			lua_rawset(L, original);
+		}
+
+		lua_pushnil(L);
+		while (lua_next(L, copy) != 0) {
+			lua_pushvalue(L, -2);
+			lua_insert(L, -2);
+			lua_rawset(L, original);
+		}
+
+		lua_pushvalue(L, original);
+		lua_rawget(L, metatables);
+		lua_setmetatable(L, original);
+
+		lua_pop(L, 1);
+	}
+
+	lua_pushliteral(L, "");
+	lua_rawgeti(L, snapshot, 3);
+	lua_setmetatable(L, -2);
+	lua_pop(L, 1);
+
+	lua_pop(L, 3);
+	return true;
 }
 
 // Returns true if a lua function exists with the given name
 bool LuaState::luaFunctionExists(String functionName) {
 	// LuaJIT does not return a type here
-	lua_getglobal(L, functionName.ascii().get_data());
+	getGlobal(functionName);
 	int type = lua_type(L, -1);
 	lua_pop(L, 1);
 	return type == LUA_TFUNCTION;
@@ -157,7 +422,7 @@ Variant LuaState::getVar(int index) const {
 
 // Pull a global variant from Lua to GDScript
 Variant LuaState::pullVariant(String name) {
-	lua_getglobal(L, name.ascii().get_data());
+	getGlobal(name);
 	Variant val = getVar(-1);
 	lua_pop(L, 1);
 	return val;
@@ -165,11 +430,13 @@ Variant LuaState::pullVariant(String name) {
 
 // call a Lua function from GDScript
 Variant LuaState::callFunction(String functionName, Array args) {
+	LuaExecutionScope scope(this);
+
 	// push the error handler on to the stack
 	lua_pushcfunction(L, luaErrorHandler);
 
 	// put global function name on stack
-	lua_getglobal(L, functionName.ascii().get_data());
+	getGlobal(functionName);
 
 	// push args
 	for (int i = 0; i < args.size(); ++i) {
@@ -177,7 +444,11 @@ Variant LuaState::callFunction(String functionName, Array args) {
 	}
 
 	// error handlers index is -2 - args.size()
-	int ret = lua_pcall(L, args.size(), 1, -2 - args.size());
+	int ret;
+	{
+		LuaProtectedScope protect(this);
+		ret = lua_pcall(L, args.size(), 1, -2 - args.size());
+	}
 	if (ret != LUA_OK) {
 		return handleError(ret);
 	}
@@ -186,6 +457,269 @@ Variant LuaState::callFunction(String functionName, Array args) {
 	return toReturn;
 }
 
+// Calls a Lua function keeping every value it returns. results is resized to the number of values and filled in place.
+LuaError *LuaState::callFunctionMulti(const String &functionName, const Array &args, Array &results) {
+	LuaExecutionScope scope(this);
+
+	lua_pushcfunction(L, luaErrorHandler);
+	getGlobal(functionName);
+	for (int i = 0; i < args.size(); ++i) {
+		pushVariant(args[i]);
+	}
+
+	return pcallMulti(L, args.size(), results, api);
+}
+
+// Calls the function below the argc arguments on the top of the stack with LUA_MULTRET, the error handler must be below the function.
+// Every returned value is written straight into results. Leaves the stack as it was before the error handler was pushed.
+LuaError *LuaState::pcallMulti(lua_State *state, int argc, Array &results, LuaAPI *api) {
+	int handler = lua_gettop(state) - argc - 1;
+	int ret;
+	{
+		LuaProtectedScope protect(api->getMainState());
+		ret = lua_pcall(state, argc, LUA_MULTRET, handler);
+	}
+	if (ret != LUA_OK) {
+		LuaError *err = handleError(state, ret);
+		lua_settop(state, handler - 1);
+		return err;
+	}
+
+	int count = lua_gettop(state) - handler;
+	results.resize(count);
+	for (int i = 0; i < count; i++) {
+		results[i] = getVariant(state, handler + 1 + i, api);
+	}
+
+	lua_settop(state, handler - 1);
+	return nullptr;
+}
+
+// Calls the function on the top of the stack once per index in [from, to), with the error handler below it.
+// pushArgs pushes the arguments of an index and returns how many it pushed, or a LuaError with nothing pushed.
+// Leaves the stack as it was.
+template <typename PushArgs>
+static void runBatch(LuaState *luaState, lua_State *L, int from, int to, Variant *results, PushArgs pushArgs) {
+	int handler = lua_gettop(L) - 1;
+	int function = handler + 1;
+
+	for (int i = from; i < to; i++) {
+		LuaExecutionScope scope(luaState);
+		lua_pushvalue(L, function);
+
+		int argc = 0;
+		LuaError *err = pushArgs(i, argc);
+		if (err != nullptr) {
+			lua_settop(L, function);
+			results[i] = err;
+			continue;
+		}
+
+		int ret;
+		{
+			LuaProtectedScope protect(luaState);
+			ret = lua_pcall(L, argc, 1, handler);
+		}
+		if (ret != LUA_OK) {
+			results[i] = luaState->handleError(ret);
+			lua_settop(L, function);
+			continue;
+		}
+
+		results[i] = luaState->getVar(-1);
+		lua_settop(L, function);
+	}
+}
+
+// Calls the global function once per argument set in [from, to) and writes the results there, a failed call's LuaError included.
+// An argument set which is not an Array is a single argument. The function and error handler are looked up once.
+void LuaState::callFunctionBatch(const String &functionName, const Array &argSets, int from, int to, Variant *results) {
+	lua_pushcfunction(L, luaErrorHandler);
+	getGlobal(functionName);
+
+	runBatch(this, L, from, to, results, [&](int i, int &argc) -> LuaError * {
+		const Variant &argSet = argSets[i];
+		if (argSet.get_type() != Variant::ARRAY) {
+			argc = 1;
+			return pushVariant(argSet);
+		}
+
+		Array args = argSet;
+		argc = args.size();
+		if (!lua_checkstack(L, argc + LUA_MINSTACK)) {
+			return LuaError::newError("too many arguments", LuaError::ERR_RUNTIME);
+		}
+		for (int j = 0; j < argc; j++) {
+			LuaError *err = pushVariant(args[j]);
+			if (err != nullptr) {
+				return err;
+			}
+		}
+		return nullptr;
+	});
+
+	lua_pop(L, 2);
+}
+
+// Calls the global function once per element of a packed array, with the element as its only argument.
+// Numbers and strings are pushed straight from the array.
+void LuaState::callFunctionBatchPacked(const String &functionName, const Variant &args, Variant *results) {
+	lua_pushcfunction(L, luaErrorHandler);
+	getGlobal(functionName);
+
+	auto single = [](int &argc) {
+		argc = 1;
+		return (LuaError *)nullptr;
+	};
+
+	switch (args.get_type()) {
+		case Variant::PACKED_INT32_ARRAY: {
+			PackedInt32Array array = args;
+			const int32_t *values = array.ptr();
+			runBatch(this, L, 0, array.size(), results, [&](int i, int &argc) {
+				lua_pushinteger(L, values[i]);
+				return single(argc);
+			});
+			break;
+		}
+		case Variant::PACKED_INT64_ARRAY: {
+			PackedInt64Array array = args;
+			const int64_t *values = array.ptr();
+			runBatch(this, L, 0, array.size(), results, [&](int i, int &argc) {
+				lua_pushinteger(L, values[i]);
+				return single(argc);
+			});
+			break;
+		}
+		case Variant::PACKED_FLOAT32_ARRAY: {
+			PackedFloat32Array array = args;
+			const float *values = array.ptr();
+			runBatch(this, L, 0, array.size(), results, [&](int i, int &argc) {
+				lua_pushnumber(L, values[i]);
+				return single(argc);
+			});
+			break;
+		}
+		case Variant::PACKED_FLOAT64_ARRAY: {
+			PackedFloat64Array array = args;
+			const double *values = array.ptr();
+			runBatch(this, L, 0, array.size(), results, [&](int i, int &argc) {
+				lua_pushnumber(L, values[i]);
+				return single(argc);
+			});
+			break;
+		}
+		case Variant::PACKED_STRING_ARRAY: {
+			PackedStringArray array = args;
+			runBatch(this, L, 0, array.size(), results, [&](int i, int &argc) {
+				pushString(L, array[i]);
+				return single(argc);
+			});
+			break;
+		}
+		default: {
+			// Vectors and colors become userdata either way
+			int count = args.call("size");
+			runBatch(this, L, 0, count, results, [&](int i, int &argc) {
+				argc = 1;
+				return pushVariant(args.get(i));
+			});
+			break;
+		}
+	}
+
+	lua_pop(L, 2);
+}
+
+// lua_load reader streaming an open file in fixed-size blocks
+struct LuaFileReader {
+	static const int BLOCK_SIZE = 4096;
+
+	Ref<FileAccess> file;
+	// The first line was skipped, it is replaced by a newline so line numbers stay the same
+	bool pendingNewline = false;
+#ifndef LAPI_GDEXTENSION
+	uint8_t block[BLOCK_SIZE];
+#else
+	PackedByteArray block;
+#endif
+
+	// Like luaL_loadfile, skips a UTF-8 BOM and a first line starting with #
+	void skipPrefix() {
+		uint64_t start = 0;
+		if (file->get_length() >= 3 && file->get_8() == 0xEF && file->get_8() == 0xBB && file->get_8() == 0xBF) {
+			start = 3;
+		}
+
+		file->seek(start);
+		if (file->get_length() > start && file->get_8() == '#') {
+			while (!file->eof_reached() && file->get_8() != '\n') {
+			}
+			pendingNewline = true;
+			return;
+		}
+		file->seek(start);
+	}
+
+	static const char *read(lua_State *state, void *data, size_t *size) {
+		LuaFileReader *reader = (LuaFileReader *)data;
+		if (reader->pendingNewline) {
+			reader->pendingNewline = false;
+			*size = 1;
+			return "\n";
+		}
+
+#ifndef LAPI_GDEXTENSION
+		*size = reader->file->get_buffer(reader->block, BLOCK_SIZE);
+		return (const char *)reader->block;
+#else
+		reader->block = reader->file->get_buffer(BLOCK_SIZE);
+		*size = reader->block.size();
+		return (const char *)reader->block.ptr();
+#endif
+	}
+};
+
+// Pushes the chunk in fileName onto the stack. Uses the bytecode the file was imported as when possible, otherwise loads the source.
+// Anything FileAccess can open works, including res:// inside a pck and user://.
+LuaError *LuaState::loadFile(lua_State *state, const String &fileName) {
+	String chunkName = "@" + fileName;
+	if (Ref<LuaBytecode> bytecode = LuaBytecode::loadImported(fileName); bytecode.is_valid()) {
+		LuaError *err = bytecode->load(state, chunkName);
+		if (err == nullptr) {
+			return nullptr;
+		}
+		// Bytecode the VM rejects, the source may still load
+		memdelete(err);
+	}
+
+	LuaFileReader reader;
+#ifndef LAPI_GDEXTENSION
+	Error error;
+	reader.file = FileAccess::open(fileName, FileAccess::READ, &error);
+	if (error != Error::OK) {
+		return LuaError::newError(vformat("error '%s' while opening file '%s'", error_names[error], fileName), LuaError::ERR_FILE);
+	}
+#else
+	reader.file = FileAccess::open(fileName, FileAccess::READ);
+	if (!reader.file.is_valid()) {
+		return LuaError::newError(vformat("error while opening file '%s'", fileName), LuaError::ERR_FILE);
+	}
+#endif
+
+	reader.skipPrefix();
+	CharString name = chunkName.utf8();
+#ifndef LAPI_LUAJIT
+	int ret = lua_load(state, LuaFileReader::read, &reader, name.get_data(), nullptr);
+#else
+	int ret = lua_load(state, LuaFileReader::read, &reader, name.get_data());
+#endif
+	if (ret != LUA_OK) {
+		return handleError(state, ret);
+	}
+	return nullptr;
+}
+
 // Push a GD Variant to the lua stack and returns a error if the type is not supported
 LuaError *LuaState::pushVariant(Variant var) const {
 	return LuaState::pushVariant(L, var);
@@ -195,7 +729,7 @@ LuaError *LuaState::pushVariant(Variant var) const {
 LuaError *LuaState::pushGlobalVariant(String name, Variant var) {
 	LuaError *err = pushVariant(var);
 	if (err == nullptr) {
-		lua_setglobal(L, name.ascii().get_data());
+		setGlobal(name);
 		return err;
 	}
 	return err;
@@ -205,17 +739,89 @@ LuaError *LuaState::handleError(int lua_error) const {
 	return LuaState::handleError(L, lua_error);
 }
 
+// Pushes the global with the given name onto the stack. Respects metamethods on _G like lua_getglobal.
+void LuaState::getGlobal(const String &name) {
+#ifndef LAPI_LUAJIT
+	lua_pushglobaltable(L);
+#else
+	lua_pushvalue(L, LUA_GLOBALSINDEX);
+#endif
+	api->getStringCache()->push(L, name);
+	lua_gettable(L, -2);
+	lua_remove(L, -2);
+}
+
+// Pops the value on the top of the stack into the global with the given name.
+void LuaState::setGlobal(const String &name) {
+#ifndef LAPI_LUAJIT
+	lua_pushglobaltable(L);
+#else
+	lua_pushvalue(L, LUA_GLOBALSINDEX);
+#endif
+	api->getStringCache()->push(L, name);
+	lua_pushvalue(L, -3);
+	lua_settable(L, -3);
+	lua_pop(L, 2);
+}
+
 // --------------
 // STATIC METHODS
 // --------------
 
 LuaAPI *LuaState::getAPI(lua_State *state) {
-	lua_pushstring(state, "__LAPI__");
+#ifdef lua_getextraspace
+	return *(LuaAPI **)lua_getextraspace(state);
+#else
+	lua_pushlightuserdata(state, &apiRegistryKey);
 	lua_rawget(state, LUA_REGISTRYINDEX);
 	LuaAPI *api = (LuaAPI *)lua_touserdata(state, -1);
 	lua_pop(state, 1);
 
 	return api;
+#endif
+}
+
+// Creates a metatable registered under name and references it by index. Leaves it on the stack.
+void LuaState::newMetatable(lua_State *state, LuaMetatable metatable, const char *name) {
+	luaL_newmetatable(state, name);
+	lua_pushvalue(state, -1);
+	getAPI(state)->setMetatableRef(metatable, luaL_ref(state, LUA_REGISTRYINDEX));
+}
+
+// Sets the metatable of the value on the top of the stack
+void LuaState::setMetatable(lua_State *state, LuaMetatable metatable) {
+	lua_rawgeti(state, LUA_REGISTRYINDEX, getAPI(state)->getMetatableRef(metatable));
+	lua_setmetatable(state, -2);
+}
+
+// Returns the userdata at index if it has the metatable, nullptr otherwise
+void *LuaState::testUserdata(lua_State *state, int index, LuaMetatable metatable) {
+	void *userdata = lua_touserdata(state, index);
+	if (userdata == nullptr || !lua_getmetatable(state, index)) {
+		return nullptr;
+	}
+
+	lua_rawgeti(state, LUA_REGISTRYINDEX, getAPI(state)->getMetatableRef(metatable));
+	bool matches = lua_rawequal(state, -1, -2);
+	lua_pop(state, 2);
+	return matches ? userdata : nullptr;
+}
+
+// Pushes a String as UTF-8 with an explicit length
+void LuaState::pushString(lua_State *state, const String &str) {
+	CharString utf8 = str.utf8();
+	lua_pushlstring(state, utf8.get_data(), utf8.length());
+}
+
+// Reads the string at index as UTF-8 with an explicit length
+String LuaState::toString(lua_State *state, int index) {
+	size_t len = 0;
+	const char *str = lua_tolstring(state, index, &len);
+	if (str == nullptr) {
+		return String();
+	}
+
+	return String::utf8(str, len);
 }
 
 // Push a GD Variant to the lua stack and returns a error if the type is not supported
@@ -225,7 +831,7 @@ LuaError *LuaState::pushVariant(lua_State *state, Variant var) {
 			lua_pushnil(state);
 			break;
 		case Variant::Type::STRING:
-			lua_pushstring(state, (var.operator String()).ascii().get_data());
+			pushString(state, var.operator String());
 			break;
 		case Variant::Type::INT:
 			lua_pushinteger(state, (int64_t)var);
@@ -245,98 +851,59 @@ LuaError *LuaState::pushVariant(lua_State *state, Variant var) {
 		case Variant::Type::PACKED_VECTOR2_ARRAY:
 		case Variant::Type::PACKED_VECTOR3_ARRAY:
 		case Variant::Type::PACKED_COLOR_ARRAY:
+			// Packed arrays are not converted to a table, lua gets a view sharing the same buffer.
+			pushPackedArray(state, var);
+			break;
 		case Variant::Type::ARRAY: {
 			Array array = var.operator Array();
-			lua_createtable(state, 0, array.size());
-
-			for (int i = 0; i < array.size(); i++) {
-				Variant key = i + 1;
-				Variant value = array[i];
+			int size = array.size();
+			// Presize the array part of the table, integer keys never touch the hash part.
+			lua_createtable(state, size, 0);
 
-				LuaError *err = pushVariant(state, key);
+			for (int i = 0; i < size; i++) {
+				LuaError *err = pushVariant(state, array[i]);
 				if (err != nullptr) {
 					return err;
 				}
 
-				err = pushVariant(state, value);
-				if (err != nullptr) {
-					return err;
-				}
-
-				lua_settable(state, -3);
+				lua_rawseti(state, -2, i + 1);
 			}
 			break;
 		}
 		case Variant::Type::DICTIONARY: {
 			Dictionary dict = var.operator Dictionary();
-			lua_createtable(state, 0, dict.size());
-
-			for (int i = 0; i < dict.size(); i++) {
-				Variant key = dict.keys()[i];
-				Variant value = dict[key];
+			// keys() and values() are built once and share the same order.
+			Array keys = dict.keys();
+			Array values = dict.values();
+			int size = keys.size();
+			lua_createtable(state, 0, size);
+
+			for (int i = 0; i < size; i++) {
+				// lua tables can not hold nil keys
+				if (keys[i].get_type() == Variant::NIL) {
+					continue;
+				}
 
-				LuaError *err = pushVariant(state, key);
+				LuaError *err = pushVariant(state, keys[i]);
 				if (err != nullptr) {
 					return err;
 				}
 
-				err = pushVariant(state, value);
+				err = pushVariant(state, values[i]);
 				if (err != nullptr) {
 					return err;
 				}
 
-				lua_settable(state, -3);
+				lua_rawset(state, -3);
 			}
 			break;
 		}
-		case Variant::Type::VECTOR2: {
-			Variant *userdata = (Variant *)lua_newuserdata(state, sizeof(Variant));
-#ifndef LAPI_GDEXTENSION
-			*userdata = var;
-#else
-			memmove(userdata, (void *)&var, sizeof(Variant));
-#endif
-			luaL_setmetatable(state, "mt_Vector2");
-			break;
-		}
-		case Variant::Type::VECTOR3: {
-			Variant *userdata = (Variant *)lua_newuserdata(state, sizeof(Variant));
-#ifndef LAPI_GDEXTENSION
-			*userdata = var;
-#else
-			memmove(userdata, (void *)&var, sizeof(Variant));
-#endif
-			luaL_setmetatable(state, "mt_Vector3");
-			break;
-		}
-		case Variant::Type::COLOR: {
-			Variant *userdata = (Variant *)lua_newuserdata(state, sizeof(Variant));
-#ifndef LAPI_GDEXTENSION
-			*userdata = var;
-#else
-			memmove(userdata, (void *)&var, sizeof(Variant));
-#endif
-			luaL_setmetatable(state, "mt_Color");
-			break;
-		}
-		case Variant::Type::RECT2: {
-			Variant *userdata = (Variant *)lua_newuserdata(state, sizeof(Variant));
-#ifndef LAPI_GDEXTENSION
-			*userdata = var;
-#else
-			memmove(userdata, (void *)&var, sizeof(Variant));
-#endif
-			luaL_setmetatable(state, "mt_Rect2");
-			break;
-		}
+		case Variant::Type::VECTOR2:
+		case Variant::Type::VECTOR3:
+		case Variant::Type::COLOR:
+		case Variant::Type::RECT2:
 		case Variant::Type::PLANE: {
-			Variant *userdata = (Variant *)lua_newuserdata(state, sizeof(Variant));
-#ifndef LAPI_GDEXTENSION
-			*userdata = var;
-#else
-			memmove(userdata, (void *)&var, sizeof(Variant));
-#endif
-			luaL_setmetatable(state, "mt_Plane");
+			pushValueType(state, var);
 			break;
 		}
 		case Variant::Type::SIGNAL: {
@@ -346,7 +913,7 @@ LuaError *LuaState::pushVariant(lua_State *state, Variant var) {
 #else
 			memmove(userdata, (void *)&var, sizeof(Variant));
 #endif
-			luaL_setmetatable(state, "mt_Signal");
+			setMetatable(state, METATABLE_SIGNAL);
 			break;
 		}
 		case Variant::Type::OBJECT: {
@@ -361,7 +928,7 @@ LuaError *LuaState::pushVariant(lua_State *state, Variant var) {
 			// blame this on https://github.com/godotengine/godot-cpp/issues/995
 			if (LuaError *err = dynamic_cast<LuaError *>(var.operator Object *()); err != nullptr) {
 #endif
-				lua_pushstring(state, err->getMessage().ascii().get_data());
+				pushString(state, err->getMessage());
 				lua_error(state);
 				break;
 			}
@@ -391,6 +958,33 @@ LuaError *LuaState::pushVariant(lua_State *state, Variant var) {
 				break;
 			}
 
+// If the type being pushed is a LuaFunction, push the function it references.
+#ifndef LAPI_GDEXTENSION
+			if (LuaFunction *func = Object::cast_to<LuaFunction>(var.operator Object *()); func != nullptr) {
+#else
+			// blame this on https://github.com/godotengine/godot-cpp/issues/995
+			if (LuaFunction *func = dynamic_cast<LuaFunction *>(var.operator Object *()); func != nullptr) {
+#endif
+				if (!func->belongsTo(getAPI(state))) {
+					return LuaError::newError("can not push a LuaFunction to a different LuaAPI than the one it was pulled from.", LuaError::ERR_TYPE);
+				}
+				lua_rawgeti(state, LUA_REGISTRYINDEX, func->getRef());
+				break;
+			}
+
+// If the type being pushed is a LuaChannel, use mt_Channel for its native methods.
+#ifndef LAPI_GDEXTENSION
+			if (LuaChannel *channel = Object::cast_to<LuaChannel>(var.operator Object *()); channel != nullptr) {
+#else
+			// blame this on https://github.com/godotengine/godot-cpp/issues/995
+			if (LuaChannel *channel = dynamic_cast<LuaChannel *>(var.operator Object *()); channel != nullptr) {
+#endif
+				// Constructed in place, the Variant keeps the channel alive until __gc destroys it
+				memnew_placement(lua_newuserdata(state, sizeof(Variant)), Variant(var));
+				setMetatable(state, METATABLE_CHANNEL);
+				break;
+			}
+
 #ifdef LAPI_GDEXTENSION
 			// If the type being pushed is a RefCounted, increase its refcount.
 			if (RefCounted *ref = Object::cast_to<RefCounted>(var.operator Object *()); ref != nullptr) {
@@ -411,7 +1005,7 @@ LuaError *LuaState::pushVariant(lua_State *state, Variant var) {
 #else
 				memmove(userdata, (void *)&var, sizeof(Variant));
 #endif
-				luaL_setmetatable(state, "mt_CallableExtra");
+				setMetatable(state, METATABLE_CALLABLE_EXTRA);
 				break;
 			}
 
@@ -421,21 +1015,12 @@ LuaError *LuaState::pushVariant(lua_State *state, Variant var) {
 #else
 			memmove(userdata, (void *)&var, sizeof(Variant));
 #endif
-			luaL_setmetatable(state, "mt_Object");
+			setMetatable(state, METATABLE_OBJECT);
 			break;
 		}
 		case Variant::Type::CALLABLE: {
 			Callable callable = var.operator Callable();
 			if (callable.is_custom()) {
-				// If the type being pushed is a lua function ref, push the ref instead.
-				if (LuaAPI *callObj = Object::cast_to<LuaAPI>(callable.get_object()); callObj != nullptr && (String)callable.get_method() == "call_function_ref") {
-					Array argBinds = callable.get_bound_arguments();
-					if (argBinds.size() == 1) {
-						lua_rawgeti(state, LUA_REGISTRYINDEX, (int)argBinds[0]);
-						break;
-					}
-				}
-
 				Ref<LuaCallableExtra> callableCustom;
 				callableCustom.instantiate();
 				callableCustom->setInfo(callable, 0, false, false);
@@ -449,7 +1034,7 @@ LuaError *LuaState::pushVariant(lua_State *state, Variant var) {
 #else
 			memmove(userdata, (void *)&var, sizeof(Variant));
 #endif
-			luaL_setmetatable(state, "mt_Callable");
+			setMetatable(state, METATABLE_CALLABLE);
 			break;
 		}
 		default:
@@ -465,7 +1050,7 @@ Variant LuaState::getVariant(lua_State *state, int index, LuaAPI *api) {
 	int type = lua_type(state, index);
 	switch (type) {
 		case LUA_TSTRING:
-			result = lua_tostring(state, index);
+			result = toString(state, index);
 			break;
 		case LUA_TNUMBER:
 			result = lua_tonumber(state, index);
@@ -473,28 +1058,44 @@ Variant LuaState::getVariant(lua_State *state, int index, LuaAPI *api) {
 		case LUA_TBOOLEAN:
 			result = (bool)lua_toboolean(state, index);
 			break;
-		case LUA_TUSERDATA:
-			result = *(Variant *)lua_touserdata(state, index);
+		case LUA_TUSERDATA: {
+			Variant::Type udType = getUserdataType(state, index);
+			switch (udType) {
+				case Variant::NIL:
+					result = *(Variant *)lua_touserdata(state, index);
+					break;
+				case Variant::VECTOR2:
+				case Variant::VECTOR3:
+				case Variant::COLOR:
+				case Variant::RECT2:
+				case Variant::PLANE:
+					result = getValueType(state, index, udType);
+					break;
+				case Variant::STRING_NAME:
+					result = *(StringName *)lua_touserdata(state, index);
+					break;
+				case Variant::VARIANT_MAX:
+					break;
+				default:
+					result = getPackedArray(state, index, udType);
+					break;
+			}
 			break;
+		}
 		case LUA_TTABLE: {
 #ifndef LAPI_LUAJIT
-			lua_len(state, index);
+			lua_Integer len = lua_rawlen(state, index);
 #else
-			lua_objlen(state, index);
+			lua_Integer len = lua_objlen(state, index);
 #endif
 
-			int len = lua_tointeger(state, -1);
-			lua_pop(state, 1);
 			// len should be 0 if the type is table and not a array
 			if (len) {
 				Array array;
-				for (int i = 1; i <= len; i++) {
-#ifndef LAPI_LUAJIT
-					lua_geti(state, index, i);
-#else
-					lua_rawgeti(state, index, i);
-#endif
-					array.push_back(getVariant(state, -1, api));
+				array.resize(len);
+				for (lua_Integer i = 0; i < len; i++) {
+					lua_rawgeti(state, index, i + 1);
+					array[i] = getVariant(state, -1, api);
 					lua_pop(state, 1);
 				}
 				result = array;
@@ -513,10 +1114,7 @@ Variant LuaState::getVariant(lua_State *state, int index, LuaAPI *api) {
 			break;
 		}
 		case LUA_TFUNCTION: {
-			lua_pushvalue(state, index);
-			Array binds;
-			binds.push_back(luaL_ref(state, LUA_REGISTRYINDEX));
-			result = Callable(api, "call_function_ref").bindv(binds);
+			result = LuaFunction::fromStack(api, state, index);
 			break;
 		}
 		case LUA_TTHREAD: {
@@ -536,26 +1134,53 @@ Variant LuaState::getVariant(lua_State *state, int index, LuaAPI *api) {
 	return result;
 }
 
+// Returns the type stored on the userdata's metatable at LAPI_METATABLE_TYPE_INDEX.
+// Variant::NIL means the userdata holds a boxed Variant, Variant::VARIANT_MAX that it holds no Variant at all.
+// A userdata without a metatable was never ours or has already been finalized.
+Variant::Type LuaState::getUserdataType(lua_State *state, int index) {
+	if (!lua_getmetatable(state, index)) {
+		return Variant::VARIANT_MAX;
+	}
+
+	lua_rawgeti(state, -1, LAPI_METATABLE_TYPE_INDEX);
+	Variant::Type type = Variant::NIL;
+	if (lua_type(state, -1) == LUA_TNUMBER) {
+		type = (Variant::Type)lua_tointeger(state, -1);
+	}
+	lua_pop(state, 2);
+	return type;
+}
+
 // Assumes there is a error in the top of the stack. Pops it.
 LuaError *LuaState::handleError(lua_State *state, int lua_error) {
 	String msg;
 	switch (lua_error) {
 		case LUA_ERRRUN: {
+			if (LuaState *active = getAPI(state)->getActiveState(); active != nullptr && active->limitExceeded) {
+				msg += "[ERR_EXECUTION_LIMIT - execution limit exceeded ]\n";
+				msg += toString(state, -1);
+				msg += "\n";
+				lua_pop(state, 1);
+				return LuaError::newError(msg, LuaError::ERR_EXECUTION_LIMIT);
+			}
+
 			msg += "[LUA_ERRRUN - runtime error ]\n";
-			msg += lua_tostring(state, -1);
+			msg += toString(state, -1);
 			msg += "\n";
 			lua_pop(state, 1);
 			break;
 		}
 		case LUA_ERRSYNTAX: {
 			msg += "[LUA_ERRSYNTAX - syntax error ]\n";
-			msg += lua_tostring(state, -1);
+			msg += toString(state, -1);
 			msg += "\n";
 			lua_pop(state, 1);
 			break;
 		}
 		case LUA_ERRMEM: {
 			msg += "[LUA_ERRMEM - memory allocation error ]\n";
+			// the error handler is not called for memory errors, the message is lua's preallocated one
+			lua_pop(state, 1);
 			break;
 		}
 		case LUA_ERRERR: {
@@ -679,6 +1304,12 @@ int LuaState::luaErrorHandler(lua_State *state) {
 	return 1;
 }
 
+// Called on a error outside of a protected call, lua aborts once it returns
+int LuaState::luaPanic(lua_State *state) {
+	print_error(vformat("Unprotected error in Lua: %s", toString(state, -1)));
+	return 0;
+}
+
 // Change lua's print function to print to the Godot console by default
 int LuaState::luaPrint(lua_State *state) {
 	int args = lua_gettop(state);
@@ -688,7 +1319,7 @@ int LuaState::luaPrint(lua_State *state) {
 
 		switch (lua_type(state, n)) {
 			case LUA_TUSERDATA: {
-				Variant var = *(Variant *)lua_touserdata(state, n);
+				Variant var = LuaState::getVariant(state, n, getAPI(state));
 				it_string = var.operator String();
 				break;
 			}
@@ -697,7 +1328,7 @@ int LuaState::luaPrint(lua_State *state) {
 				break;
 			}
 			default: {
-				it_string = lua_tostring(state, n);
+				it_string = toString(state, n);
 				break;
 			}
 		}
@@ -735,7 +1366,7 @@ int LuaState::luaCallableCall(lua_State *state) {
 		args[i] = LuaState::getVariant(state, index++, api);
 		if (args[i].get_type() != Variant::Type::OBJECT) {
 			if (LuaError *err = Object::cast_to<LuaError>(args[i].operator Object *()); err != nullptr) {
-				lua_pushstring(state, err->getMessage().ascii().get_data());
+				pushString(state, err->getMessage());
 				lua_error(state);
 				return 0;
 			}
@@ -749,9 +1380,12 @@ int LuaState::luaCallableCall(lua_State *state) {
 	Variant returned;
 	Callable::CallError error;
 	callable.callp(p_args, argc, returned, error);
+	while (LuaFunction::isCallableMismatch(error, argc) && LuaFunction::toCallableArgument(args[error.argument])) {
+		callable.callp(p_args, argc, returned, error);
+	}
 	if (error.error != error.CALL_OK) {
 		LuaError *err = LuaState::handleError(callable.get_method(), error, p_args, argc);
-		lua_pushstring(state, err->getMessage().ascii().get_data());
+		pushString(state, err->getMessage());
 		lua_error(state);
 		return 0;
 	}
@@ -763,7 +1397,7 @@ int LuaState::luaCallableCall(lua_State *state) {
 
 	LuaError *err = LuaState::pushVariant(state, returned);
 	if (err != nullptr) {
-		lua_pushstring(state, err->getMessage().ascii().get_data());
+		pushString(state, err->getMessage());
 		lua_error(state);
 		return 0;
 	}
@@ -792,7 +1426,7 @@ int LuaState::luaCallableCall(lua_State *state) {
 		Variant var = LuaState::getVariant(state, index++, api);
 		if (var.get_type() == Variant::Type::OBJECT) {
 			if (LuaError *err = dynamic_cast<LuaError *>(var.operator Object *()); err != nullptr) {
-				lua_pushstring(state, err->getMessage().ascii().get_data());
+				pushString(state, err->getMessage());
 				lua_error(state);
 				return 0;
 			}
@@ -809,7 +1443,7 @@ int LuaState::luaCallableCall(lua_State *state) {
 
 	LuaError *err = LuaState::pushVariant(state, returned);
 	if (err != nullptr) {
-		lua_pushstring(state, err->getMessage().ascii().get_data());
+		pushString(state, err->getMessage());
 		lua_error(state);
 		return 0;
 	}
@@ -823,42 +1457,125 @@ int LuaState::luaCallableCall(lua_State *state) {
 
 #endif
 
-// This function is invoked whenever a function is called on one of the userdata types
-// excluding mt_Callable or mt_Object if __index is overwritten
-int LuaState::luaUserdataFuncCall(lua_State *state) {
-	LuaAPI *api = getAPI(state);
+static void pushBuiltinMethod(lua_State *state, Variant::Type type, const StringName &name) {
+	LuaBuiltinMethod *method = memnew_placement(lua_newuserdata(state, sizeof(LuaBuiltinMethod)), LuaBuiltinMethod);
+	LuaState::setMetatable(state, METATABLE_BUILTIN_METHOD);
+	method->name = name;
+	method->type = type;
 
-	Variant *obj = (Variant *)lua_touserdata(state, lua_upvalueindex(1));
-	String fName = LuaState::getVariant(state, lua_upvalueindex(2), api);
+#ifndef LAPI_GDEXTENSION
+	if (Variant::has_builtin_method(type, name) && !Variant::is_builtin_method_vararg(type, name)) {
+		int argc = Variant::get_builtin_method_argument_count(type, name);
+		if (argc <= LAPI_MAX_STACK_ARGS) {
+			method->method = Variant::get_validated_builtin_method(type, name);
+			method->argc = argc;
+			for (int i = 0; i < argc; i++) {
+				method->argTypes[i] = Variant::get_builtin_method_argument_type(type, name, i);
+			}
+			method->defaults = Variant::get_builtin_method_default_arguments(type, name);
+			method->hasReturn = Variant::has_builtin_method_return_value(type, name);
+			method->returnType = Variant::get_builtin_method_return_type(type, name);
+		}
+	}
+#endif
 
-	int argc = lua_gettop(state);
-	Array args;
-	args.resize(argc);
-	Vector<const Variant *> mem_args;
-	mem_args.resize(argc);
-	for (int i = 0; i < argc; i++) {
-		args[i] = LuaState::getVariant(state, i + 1, api);
-		mem_args.write[i] = &args[i];
+	lua_pushcclosure(state, LuaState::luaBuiltinMethodCall, 1);
+}
+
+// Pushes the method closure for the name at nameIndex, cached on the metatable of the userdata at index.
+// The closure is shared by every receiver with that metatable and takes the receiver as its first argument.
+// Value types get a builtin method closure, everything else goes through luaUserdataFuncCall.
+// Both indexes must be absolute.
+void LuaState::pushMethod(lua_State *state, int index, int nameIndex) {
+	lua_getmetatable(state, index);
+	lua_rawgeti(state, -1, LAPI_METATABLE_METHODS_INDEX);
+	lua_pushvalue(state, nameIndex);
+	lua_rawget(state, -2);
+	if (lua_isnil(state, -1)) {
+		lua_pop(state, 1);
+
+		lua_rawgeti(state, -2, LAPI_METATABLE_TYPE_INDEX);
+		Variant::Type type = lua_type(state, -1) == LUA_TNUMBER ? (Variant::Type)lua_tointeger(state, -1) : Variant::NIL;
+		lua_pop(state, 1);
+
+		StringName name = toString(state, nameIndex);
+		if (type != Variant::NIL) {
+			pushBuiltinMethod(state, type, name);
+		} else {
+			// The closure only accepts receivers with the metatable it is cached on
+			LuaAPI *api = getAPI(state);
+			int owner = METATABLE_OBJECT;
+			for (int i = 0; i < METATABLE_MAX; i++) {
+				lua_rawgeti(state, LUA_REGISTRYINDEX, api->getMetatableRef((LuaMetatable)i));
+				bool matches = lua_rawequal(state, -1, -3);
+				lua_pop(state, 1);
+				if (matches) {
+					owner = i;
+					break;
+				}
+			}
+
+			memnew_placement(lua_newuserdata(state, sizeof(StringName)), StringName(name));
+			setMetatable(state, METATABLE_STRING_NAME);
+			lua_pushinteger(state, owner);
+			lua_pushcclosure(state, luaUserdataFuncCall, 2);
+		}
+
+		lua_pushvalue(state, nameIndex);
+		lua_pushvalue(state, -2);
+		lua_rawset(state, -4);
 	}
 
-	const Variant **p_args = (const Variant **)mem_args.ptr();
+	// Leave only the closure on the stack
+	lua_insert(state, -3);
+	lua_pop(state, 2);
+}
+
+// Calls name on base with the arguments from firstArg to the top of the stack. Pushes the results and returns their count.
+static int callMethodFromStack(lua_State *state, LuaAPI *api, Variant &base, const StringName &name, int firstArg) {
+	int argc = lua_gettop(state) - firstArg + 1;
+
+	Variant localArgs[LAPI_MAX_STACK_ARGS];
+	const Variant *localPtrs[LAPI_MAX_STACK_ARGS];
+	Vector<Variant> heapArgs;
+	Vector<const Variant *> heapPtrs;
+
+	Variant *args = localArgs;
+	const Variant **p_args = localPtrs;
+	if (argc > LAPI_MAX_STACK_ARGS) {
+		heapArgs.resize(argc);
+		heapPtrs.resize(argc);
+		args = heapArgs.ptrw();
+		p_args = heapPtrs.ptrw();
+	}
+
+	for (int i = 0; i < argc; i++) {
+		args[i] = LuaState::getVariant(state, firstArg + i, api);
+		p_args[i] = &args[i];
+	}
 
 	Variant returned;
 #ifndef LAPI_GDEXTENSION
 	Callable::CallError error;
-	obj->callp(fName.ascii().get_data(), p_args, argc, returned, error);
+	base.callp(name, p_args, argc, returned, error);
+	while (LuaFunction::isCallableMismatch(error, argc) && LuaFunction::toCallableArgument(args[error.argument])) {
+		base.callp(name, p_args, argc, returned, error);
+	}
 	if (error.error != error.CALL_OK) {
-		LuaError *err = LuaState::handleError(fName, error, p_args, argc);
-		lua_pushstring(state, err->getMessage().ascii().get_data());
+		LuaError *err = LuaState::handleError(name, error, p_args, argc);
+		LuaState::pushString(state, err->getMessage());
 		lua_error(state);
 		return 0;
 	}
 #else
 	GDExtensionCallError error;
-	obj->callp(fName.ascii().get_data(), p_args, argc, returned, error);
+	base.callp(name, p_args, argc, returned, error);
+	while (LuaFunction::isCallableMismatch(error, argc) && LuaFunction::toCallableArgument(args[error.argument])) {
+		base.callp(name, p_args, argc, returned, error);
+	}
 	if (error.error != GDEXTENSION_CALL_OK) {
-		LuaError *err = LuaState::handleError(fName, error, p_args, argc);
-		lua_pushstring(state, err->getMessage().ascii().get_data());
+		LuaError *err = LuaState::handleError(name, error, p_args, argc);
+		LuaState::pushString(state, err->getMessage());
 		lua_error(state);
 		return 0;
 	}
@@ -880,15 +1597,189 @@ int LuaState::luaUserdataFuncCall(lua_State *state) {
 	return 1;
 }
 
+// This function is invoked whenever a method is called on mt_Object or mt_Signal
+// Upvalue 1 is the method name, upvalue 2 the LuaMetatable the closure is cached on.
+int LuaState::luaUserdataFuncCall(lua_State *state) {
+	LuaAPI *api = getAPI(state);
+
+	const StringName &fName = *(StringName *)lua_touserdata(state, lua_upvalueindex(1));
+	LuaMetatable owner = (LuaMetatable)lua_tointeger(state, lua_upvalueindex(2));
+	if (testUserdata(state, 1, owner) == nullptr) {
+		pushString(state, vformat("method '%s' must be called with a receiver, use ':' instead of '.'", fName));
+		return lua_error(state);
+	}
+
+	Variant obj = LuaState::getVariant(state, 1, api);
+
+	// The closure is shared, so the receiver's access has to be checked on every call
+	if (obj.get_type() == Variant::Type::OBJECT) {
+#ifndef LAPI_GDEXTENSION
+		Object *receiver = obj.get_validated_object();
+#else
+		Object *receiver = obj.operator Object *();
+#endif
+		if (receiver == nullptr) {
+			pushString(state, vformat("attempt to call method '%s' on a freed object", fName));
+			return lua_error(state);
+		}
+
+		// Classes overriding __index decide what lua sees, a closure taken from another object must not get around that
+		LuaBindingCache *cache = api->getBindingCache();
+		LuaBindingCache::ClassBindings *bindings = cache->getClass(receiver, api);
+		if (bindings->overridesIndex || cache->getBinding(bindings, receiver, fName, api->getPermissive()).kind != LuaBindingCache::BINDING_METHOD) {
+			pushString(state, vformat("method '%s' is not accessible from lua", fName));
+			return lua_error(state);
+		}
+	}
+
+	return callMethodFromStack(state, api, obj, fName, 2);
+}
+
+#ifndef LAPI_GDEXTENSION
+// Converts the lua value at index to type. Variant::NIL accepts any type.
+static bool getBuiltinArgument(lua_State *state, int index, LuaAPI *api, Variant::Type type, Variant &r_arg) {
+	r_arg = LuaState::getVariant(state, index, api);
+	if (type == Variant::NIL || r_arg.get_type() == type) {
+		return true;
+	}
+
+	if (type == Variant::CALLABLE) {
+		return LuaFunction::toCallableArgument(r_arg);
+	}
+
+	if (!Variant::can_convert_strict(r_arg.get_type(), type)) {
+		return false;
+	}
+
+	const Variant *from = &r_arg;
+	Variant converted;
+	Callable::CallError error;
+	Variant::construct(type, converted, &from, 1, error);
+	if (error.error != Callable::CallError::CALL_OK) {
+		return false;
+	}
+
+	r_arg = converted;
+	return true;
+}
+#endif
+
+// This function is invoked whenever a method is called on one of the value types.
+// In the module build the method is called through its validated pointer with the arguments converted
+// straight into a local buffer. Anything the validated call can't handle falls back to callp.
+int LuaState::luaBuiltinMethodCall(lua_State *state) {
+	LuaAPI *api = getAPI(state);
+
+	LuaBuiltinMethod *method = (LuaBuiltinMethod *)lua_touserdata(state, lua_upvalueindex(1));
+	int argc = lua_gettop(state) - 1;
+	if (argc < 0) {
+		pushString(state, vformat("method '%s' must be called with a receiver, use ':' instead of '.'", method->name));
+		return lua_error(state);
+	}
+
+	Variant base = LuaState::getVariant(state, 1, api);
+
+#ifndef LAPI_GDEXTENSION
+	int required = method->argc - method->defaults.size();
+	if (method->method != nullptr && base.get_type() == method->type && argc >= required && argc <= method->argc) {
+		Variant args[LAPI_MAX_STACK_ARGS];
+		const Variant *p_args[LAPI_MAX_STACK_ARGS];
+		bool valid = true;
+		for (int i = 0; i < method->argc && valid; i++) {
+			if (i < argc) {
+				valid = getBuiltinArgument(state, i + 2, api, method->argTypes[i], args[i]);
+			} else {
+				args[i] = method->defaults[i - required];
+			}
+			p_args[i] = &args[i];
+		}
+
+		if (valid) {
+			Variant returned;
+			if (method->hasReturn) {
+				VariantInternal::initialize(&returned, method->returnType);
+			}
+
+			method->method(&base, p_args, method->argc, &returned);
+			LuaState::pushVariant(state, returned);
+			return 1;
+		}
+	}
+#endif
+
+	return callMethodFromStack(state, api, base, method->name, 2);
+}
+
+// package.searchers entry resolving modules with LuaAPI.module_path. Returns the loader and the file it came from.
+int LuaState::luaModuleSearcher(lua_State *state) {
+	LuaAPI *api = getAPI(state);
+
+	// The error is raised outside of the scope, the strings must be freed first
+	{
+		String name = toString(state, 1);
+		String path = LuaModuleCache::resolve(name, api->getModulePath());
+		if (path.is_empty()) {
+			pushString(state, vformat("\n\tno module '%s' in LuaAPI.module_path '%s'", name, api->getModulePath()));
+			return 1;
+		}
+
+		LuaError *err = LuaModuleCache::load(state, path);
+		if (err == nullptr) {
+			pushString(state, path);
+			return 2;
+		}
+
+		pushString(state, vformat("error loading module '%s' from file '%s':\n\t%s", name, path, err->getMessage()));
+		memdelete(err);
+	}
+	return lua_error(state);
+}
+
 void LuaState::luaHook(lua_State *state, lua_Debug *ar) {
 	LuaAPI *api = getAPI(state);
 
-	lua_pushstring(state, "__HOOK");
-	lua_rawget(state, LUA_REGISTRYINDEX);
-	Callable hook = LuaState::getVariant(state, -1, api);
-	lua_pop(state, 1);
+	int event;
+	switch (ar->event) {
+		case LUA_HOOKCOUNT: {
+			// Threads inherit the hook, so the budget charged is the one of the state Lua was entered through
+			LuaState *active = api->getActiveState();
+			if (active != nullptr) {
+				int count = lua_gethookcount(state);
+				if (!active->chargeBudget(count)) {
+					// Check every instruction from now on, so a pcall in Lua can't catch the error and keep running
+					lua_sethook(state, luaHook, lua_gethookmask(state), 1);
+					luaL_error(state, "execution limit exceeded");
+					return;
+				}
 
-	if (hook.is_null()) {
+				// A fresh budget after the thread ran out of one, go back to the normal interval
+				if (int normal = active->getHookCount(); count == 1 && normal > 1) {
+					lua_sethook(state, luaHook, lua_gethookmask(state), normal);
+				}
+			}
+			event = LUA_MASKCOUNT;
+			break;
+		}
+		case LUA_HOOKLINE:
+			event = LUA_MASKLINE;
+			break;
+		case LUA_HOOKRET:
+			event = LUA_MASKRET;
+			break;
+		default:
+			event = LUA_MASKCALL;
+			break;
+	}
+
+	// Count events may only be there for the execution limit.
+	// Coroutines created from Lua inherit the hook of the state they were created in, so the hook of the state Lua was entered through is used.
+	LuaState *owner = api->getActiveState();
+	if (owner == nullptr) {
+		owner = api->getMainState();
+	}
+
+	Callable hook = owner->hookCallable;
+	if (hook.is_null() || !(owner->hookMask & event)) {
 		return;
 	}
 
@@ -909,7 +1800,7 @@ void LuaState::luaHook(lua_State *state, lua_Debug *ar) {
 	hook.callp(p_args, argc, returned, error);
 	if (error.error != error.CALL_OK) {
 		LuaError *err = LuaState::handleError(hook.get_method(), error, p_args, argc);
-		lua_pushstring(state, err->getMessage().ascii().get_data());
+		pushString(state, err->getMessage());
 		lua_error(state);
 		return;
 	}
@@ -920,7 +1811,7 @@ void LuaState::luaHook(lua_State *state, lua_Debug *ar) {
 
 	LuaError *err = LuaState::pushVariant(state, returned);
 	if (err != nullptr) {
-		lua_pushstring(state, err->getMessage().ascii().get_data());
+		pushString(state, err->getMessage());
 		lua_error(state);
 	}
 #else
@@ -933,7 +1824,7 @@ void LuaState::luaHook(lua_State *state, lua_Debug *ar) {
 
 	LuaError *err = LuaState::pushVariant(state, returned);
 	if (err != nullptr) {
-		lua_pushstring(state, err->getMessage().ascii().get_data());
+		pushString(state, err->getMessage());
 		lua_error(state);
 	}
 #endif
@@ -13,13 +13,74 @@
 #include <classes/luaError.h>
 #include <lua/lua.hpp>
 
+// Metatables for userdata that is not a boxed Variant store the Variant::Type of their payload at this index.
+#define LAPI_METATABLE_TYPE_INDEX 1
+// Metatables with methods cache one closure per method name in a table at this index.
+#define LAPI_METATABLE_METHODS_INDEX 2
+
+// Calls with up to this many arguments convert them into a fixed-size local buffer instead of allocating.
+#define LAPI_MAX_STACK_ARGS 8
+
+// Instructions between two checks of the execution limit, unless a count hook is set.
+#define LAPI_LIMIT_CHECK_INTERVAL 1000
+
 class LuaAPI;
 
+// Every metatable is also referenced by an integer registry index, stored on the LuaAPI.
+// Setting or checking a metatable is a lua_rawgeti instead of a lookup by name.
+enum LuaMetatable {
+	METATABLE_VECTOR2,
+	METATABLE_VECTOR3,
+	METATABLE_COLOR,
+	METATABLE_RECT2,
+	METATABLE_PLANE,
+	METATABLE_SIGNAL,
+	METATABLE_OBJECT,
+	METATABLE_CALLABLE,
+	METATABLE_CALLABLE_EXTRA,
+	METATABLE_PACKED_BYTE_ARRAY,
+	METATABLE_PACKED_INT32_ARRAY,
+	METATABLE_PACKED_INT64_ARRAY,
+	METATABLE_PACKED_FLOAT32_ARRAY,
+	METATABLE_PACKED_FLOAT64_ARRAY,
+	METATABLE_PACKED_STRING_ARRAY,
+	METATABLE_PACKED_VECTOR2_ARRAY,
+	METATABLE_PACKED_VECTOR3_ARRAY,
+	METATABLE_PACKED_COLOR_ARRAY,
+	METATABLE_STRING_NAME,
+	METATABLE_BUILTIN_METHOD,
+	METATABLE_CHANNEL,
+	METATABLE_MAX,
+};
+
+// A builtin method of a value type, resolved once per metatable and held as the upvalue of its closure.
+struct LuaBuiltinMethod {
+	StringName name;
+	Variant::Type type = Variant::NIL;
+#ifndef LAPI_GDEXTENSION
+	// nullptr if the method can't be called validated, in which case callp is used
+	Variant::ValidatedBuiltInMethod method = nullptr;
+	int argc = 0;
+	Variant::Type argTypes[LAPI_MAX_STACK_ARGS];
+	Vector<Variant> defaults;
+	bool hasReturn = false;
+	Variant::Type returnType = Variant::NIL;
+#endif
+};
+
 class LuaState {
 public:
 	void setState(lua_State *state, LuaAPI *lua, bool bindAPI);
 	void bindLibraries(Array libs);
 	void setHook(Callable hook, int mask, int count);
+	void setExecutionLimit(int64_t instructions, int64_t usec);
+
+	void snapshotGlobals();
+	bool restoreGlobals();
+
+	LuaState *beginExecution();
+	void endExecution(LuaState *previous);
+	bool setEnforcingLimit(bool value);
 
 	bool luaFunctionExists(String functionName);
 
@@ -28,28 +89,52 @@ public:
 	Variant getVar(int index = -1) const;
 	Variant pullVariant(String name);
 	Variant callFunction(String functionName, Array args);
+	LuaError *callFunctionMulti(const String &functionName, const Array &args, Array &results);
+	void callFunctionBatch(const String &functionName, const Array &argSets, int from, int to, Variant *results);
+	void callFunctionBatchPacked(const String &functionName, const Variant &args, Variant *results);
 
 	LuaError *pushVariant(Variant var) const;
 	LuaError *pushGlobalVariant(String name, Variant var);
 	LuaError *exposeObjectConstructor(String name, Object *obj);
 	LuaError *handleError(int lua_error) const;
 
+	void getGlobal(const String &name);
+	void setGlobal(const String &name);
+
 	static LuaAPI *getAPI(lua_State *state);
 
+	static void newMetatable(lua_State *state, LuaMetatable metatable, const char *name);
+	static void setMetatable(lua_State *state, LuaMetatable metatable);
+	static void *testUserdata(lua_State *state, int index, LuaMetatable metatable);
+
+	static void pushString(lua_State *state, const String &str);
+	static String toString(lua_State *state, int index);
+
+	static LuaError *loadFile(lua_State *state, const String &fileName);
 	static LuaError *pushVariant(lua_State *state, Variant var);
+	static void pushPackedArray(lua_State *state, const Variant &var);
+	static void pushValueType(lua_State *state, const Variant &var);
+	static void pushMethod(lua_State *state, int index, int nameIndex);
 	static LuaError *handleError(lua_State *state, int lua_error);
+	static LuaError *pcallMulti(lua_State *state, int argc, Array &results, LuaAPI *api);
 #ifndef LAPI_GDEXTENSION
 	static LuaError *handleError(const StringName &func, Callable::CallError error, const Variant **p_arguments, int argc);
 #else
 	static LuaError *handleError(const StringName &func, GDExtensionCallError error, const Variant **p_arguments, int argc);
 #endif
 	static Variant getVariant(lua_State *state, int index, LuaAPI *api);
+	static Variant getPackedArray(lua_State *state, int index, Variant::Type type);
+	static Variant getValueType(lua_State *state, int index, Variant::Type type);
+	static Variant::Type getUserdataType(lua_State *state, int index);
 
 	// Lua functions
 	static int luaErrorHandler(lua_State *state);
+	static int luaPanic(lua_State *state);
 	static int luaPrint(lua_State *state);
 	static int luaUserdataFuncCall(lua_State *state);
+	static int luaBuiltinMethodCall(lua_State *state);
 	static int luaCallableCall(lua_State *state);
+	static int luaModuleSearcher(lua_State *state);
 
 	static void luaHook(lua_State *state, lua_Debug *ar);
 
@@ -58,6 +143,27 @@ private:
 
 	lua_State *L = nullptr;
 
+	// Registry reference to what snapshotGlobals recorded
+	int snapshotRef = LUA_NOREF;
+
+	// The hook requested through setHook, combined with the count hook used by the execution limit.
+	Callable hookCallable;
+	int hookMask = 0;
+	int hookCount = 0;
+
+	// Execution limit, 0 means unlimited. The budget is charged by the count hook.
+	int64_t instructionLimit = 0;
+	int64_t usecLimit = 0;
+	int64_t instructionsLeft = 0;
+	uint64_t deadline = 0;
+	int executionDepth = 0;
+	bool limitExceeded = false;
+
+	void updateHook();
+	int getHookCount() const;
+	bool chargeBudget(int instructions);
+
+	void installModuleSearcher();
 	void exposeConstructors();
 	void createVector2Metatable();
 	void createVector3Metatable();
@@ -68,6 +174,44 @@ private:
 	void createObjectMetatable();
 	void createCallableMetatable();
 	void createCallableExtraMetatable();
+	void createPackedArrayMetatables();
+	void createMethodMetatables();
+	void createChannelMetatable();
+};
+
+// Marks a call into Lua from Godot. The outermost scope of a state starts its execution budget.
+class LuaExecutionScope {
+public:
+	inline LuaExecutionScope(LuaState *state) :
+			state(state) {
+		previous = state->beginExecution();
+	}
+
+	inline ~LuaExecutionScope() {
+		state->endExecution(previous);
+	}
+
+private:
+	LuaState *state;
+	LuaState *previous;
+};
+
+// Wraps a lua_pcall or lua_resume, the memory limit is only enforced inside of one.
+// Anywhere else a failed allocation makes lua panic and abort.
+class LuaProtectedScope {
+public:
+	inline LuaProtectedScope(LuaState *state) :
+			state(state) {
+		enforcing = state->setEnforcingLimit(true);
+	}
+
+	inline ~LuaProtectedScope() {
+		state->setEnforcingLimit(enforcing);
+	}
+
+private:
+	LuaState *state;
+	bool enforcing;
 };
 
 #endif
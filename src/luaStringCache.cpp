@@ -0,0 +1,38 @@
+#include "luaStringCache.h"
+
+#include <luaState.h>
+
+// Pushes str onto the stack, reusing the registry pinned copy if there is one.
+void LuaStringCache::push(lua_State *state, const String &str) {
+	if (Entry *entry = entries.getptr(str); entry != nullptr) {
+		uses.move_to_front(entry->use);
+		lua_rawgeti(state, LUA_REGISTRYINDEX, entry->ref);
+		return;
+	}
+
+	LuaState::pushString(state, str);
+	if ((int)entries.size() >= CAPACITY) {
+		evict(state);
+	}
+
+	lua_pushvalue(state, -1);
+	Entry entry;
+	entry.ref = luaL_ref(state, LUA_REGISTRYINDEX);
+	entry.use = uses.push_front(str);
+	entries.insert(str, entry);
+}
+
+// Removes the least recently used string
+void LuaStringCache::evict(lua_State *state) {
+	List<String>::Element *oldest = uses.back();
+	if (oldest == nullptr) {
+		return;
+	}
+
+	String key = oldest->get();
+	if (Entry *entry = entries.getptr(key); entry != nullptr) {
+		luaL_unref(state, LUA_REGISTRYINDEX, entry->ref);
+	}
+	entries.erase(key);
+	uses.erase(oldest);
+}
@@ -0,0 +1,41 @@
+#ifndef LUASTRINGCACHE_H
+#define LUASTRINGCACHE_H
+
+#ifndef LAPI_GDEXTENSION
+#include "core/string/ustring.h"
+#include "core/templates/hash_map.h"
+#include "core/templates/list.h"
+#else
+#include <godot_cpp/templates/hash_map.hpp>
+#include <godot_cpp/templates/list.hpp>
+#include <godot_cpp/variant/string.hpp>
+#endif
+
+#include <lua/lua.hpp>
+
+#ifdef LAPI_GDEXTENSION
+using namespace godot;
+#endif
+
+// LRU cache of hot strings (global names, method names, property keys) pinned in the registry.
+// Pushing a cached string is a hash lookup and a lua_rawgeti, it skips the UTF-8 conversion and lua's interning.
+// Shared by every LuaState bound to the same LuaAPI, since they share the registry.
+class LuaStringCache {
+public:
+	void push(lua_State *state, const String &str);
+
+private:
+	struct Entry {
+		int ref = LUA_NOREF;
+		List<String>::Element *use = nullptr;
+	};
+
+	HashMap<String, Entry> entries;
+	// Most recently used first
+	List<String> uses;
+	static const int CAPACITY = 256;
+
+	void evict(lua_State *state);
+};
+
+#endif
@@ -2,25 +2,47 @@
 
 #include <classes/luaAPI.h>
 #include <classes/luaCallableExtra.h>
+#include <classes/luaChannel.h>
 #include <classes/luaTuple.h>
 
+// Arguments of a metamethod. Each stack slot is only converted to a Variant the first time it is used.
+// N is the arity declared by the metamethod, slots above it must not be accessed.
+template <int N>
+class LuaArgs {
+public:
+	LuaArgs(lua_State *state, LuaAPI *api) :
+			state(state), api(api) {}
+
+	// Indexed from 1, the same as the lua stack.
+	Variant &operator[](int index) {
+		uint32_t bit = 1 << (index - 1);
+		if (!(converted & bit)) {
+			values[index - 1] = LuaState::getVariant(state, index, api);
+			converted |= bit;
+		}
+		return values[index - 1];
+	}
+
+private:
+	lua_State *state;
+	LuaAPI *api;
+	Variant values[N > 0 ? N : 1];
+	uint32_t converted = 0;
+};
+
 // These 2 macros helps us in constructing general metamethods.
-// We can use "lua" as a "Lua" pointer and arg1, arg2, ..., arg5 as Variants objects
-// Check examples in createVector2Metatable
-#define LUA_LAMBDA_TEMPLATE(_f_)                                  \
-	[](lua_State *inner_state) -> int {                           \
-		LuaAPI *api = LuaState::getAPI(inner_state);              \
-		Variant arg1 = LuaState::getVariant(inner_state, 1, api); \
-		Variant arg2 = LuaState::getVariant(inner_state, 2, api); \
-		Variant arg3 = LuaState::getVariant(inner_state, 3, api); \
-		Variant arg4 = LuaState::getVariant(inner_state, 4, api); \
-		Variant arg5 = LuaState::getVariant(inner_state, 5, api); \
-		_f_                                                       \
+// We can use "api" as a LuaAPI pointer and args[1], ..., args[_argc_] as Variants
+// Check examples in createObjectMetatable
+#define LUA_LAMBDA_TEMPLATE(_argc_, _f_)                 \
+	[](lua_State *inner_state) -> int {                 \
+		LuaAPI *api = LuaState::getAPI(inner_state);    \
+		LuaArgs<_argc_> args(inner_state, api);         \
+		_f_                                             \
 	}
 
-#define LUA_METAMETHOD_TEMPLATE(lua_state, metatable_index, metamethod_name, _f_) \
-	lua_pushstring(lua_state, metamethod_name);                                   \
-	lua_pushcfunction(lua_state, LUA_LAMBDA_TEMPLATE(_f_));                       \
+#define LUA_METAMETHOD_TEMPLATE(lua_state, metatable_index, metamethod_name, _argc_, _f_) \
+	lua_pushstring(lua_state, metamethod_name);                                           \
+	lua_pushcfunction(lua_state, LUA_LAMBDA_TEMPLATE(_argc_, _f_));                       \
 	lua_settable(lua_state, metatable_index - 2);
 
 // Expose the constructor for a object to lua
@@ -33,7 +55,7 @@ LuaError *LuaState::exposeObjectConstructor(String name, Object *obj) {
 
 #ifndef LAPI_GDEXTENSION
 
-	lua_pushcclosure(L, LUA_LAMBDA_TEMPLATE({
+	lua_pushcclosure(L, LUA_LAMBDA_TEMPLATE(0, {
 		Object *inner_obj = (Object *)lua_touserdata(inner_state, lua_upvalueindex(1));
 
 		Variant *userdata = (Variant *)lua_newuserdata(inner_state, sizeof(Variant));
@@ -41,7 +63,7 @@ LuaError *LuaState::exposeObjectConstructor(String name, Object *obj) {
 
 		*userdata = ret;
 
-		luaL_setmetatable(inner_state, "mt_Object");
+		LuaState::setMetatable(inner_state, METATABLE_OBJECT);
 
 		return 1;
 	}),
@@ -49,7 +71,7 @@ LuaError *LuaState::exposeObjectConstructor(String name, Object *obj) {
 
 #else
 
-	lua_pushcclosure(L, LUA_LAMBDA_TEMPLATE({
+	lua_pushcclosure(L, LUA_LAMBDA_TEMPLATE(0, {
 		Object *inner_obj = (Object *)lua_touserdata(inner_state, lua_upvalueindex(1));
 
 		Variant *userdata = (Variant *)lua_newuserdata(inner_state, sizeof(Variant));
@@ -62,697 +84,824 @@ LuaError *LuaState::exposeObjectConstructor(String name, Object *obj) {
 
 		memmove(userdata, (void *)&ret, sizeof(Variant));
 
-		luaL_setmetatable(inner_state, "mt_Object");
+		LuaState::setMetatable(inner_state, METATABLE_OBJECT);
 
 		return 1;
 	}),
 			1);
 #endif
 
-	lua_setglobal(L, name.ascii().get_data());
+	setGlobal(name);
 	return nullptr;
 }
 
-// Expose the default constructors
-void LuaState::exposeConstructors() {
-	lua_pushcfunction(L, LUA_LAMBDA_TEMPLATE({
-		int argc = lua_gettop(inner_state);
-		if (argc == 0) {
-			LuaState::pushVariant(inner_state, Vector2());
-		} else {
-			LuaState::pushVariant(inner_state, Vector2(arg1.operator double(), arg2.operator double()));
-		}
-		return 1;
-	}));
-	lua_setglobal(L, "Vector2");
+// Value types (Vector2, Vector3, Color, Rect2 and Plane) are stored in userdata as the raw struct instead of a boxed Variant.
+// Their metamethods read and write the struct directly and only go through Variant for methods and derived properties.
+enum ValueFieldType {
+	VALUE_FIELD_REAL,
+	VALUE_FIELD_FLOAT,
+	VALUE_FIELD_VECTOR2,
+	VALUE_FIELD_VECTOR3,
+};
+
+// A component of a value type which can be read and written without a Variant.
+struct ValueField {
+	const char *name;
+	size_t offset;
+	ValueFieldType type;
+};
+
+static const ValueField vector2Fields[] = {
+	{ "x", offsetof(Vector2, x), VALUE_FIELD_REAL },
+	{ "y", offsetof(Vector2, y), VALUE_FIELD_REAL },
+};
+
+static const ValueField vector3Fields[] = {
+	{ "x", offsetof(Vector3, x), VALUE_FIELD_REAL },
+	{ "y", offsetof(Vector3, y), VALUE_FIELD_REAL },
+	{ "z", offsetof(Vector3, z), VALUE_FIELD_REAL },
+};
+
+static const ValueField colorFields[] = {
+	{ "r", offsetof(Color, r), VALUE_FIELD_FLOAT },
+	{ "g", offsetof(Color, g), VALUE_FIELD_FLOAT },
+	{ "b", offsetof(Color, b), VALUE_FIELD_FLOAT },
+	{ "a", offsetof(Color, a), VALUE_FIELD_FLOAT },
+};
+
+static const ValueField rect2Fields[] = {
+	{ "position", offsetof(Rect2, position), VALUE_FIELD_VECTOR2 },
+	{ "size", offsetof(Rect2, size), VALUE_FIELD_VECTOR2 },
+};
+
+static const ValueField planeFields[] = {
+	{ "normal", offsetof(Plane, normal), VALUE_FIELD_VECTOR3 },
+	{ "d", offsetof(Plane, d), VALUE_FIELD_REAL },
+};
+
+template <typename T>
+struct ValueTypeInfo;
+
+#define VALUE_TYPE_INFO(m_type, m_variant_type, m_fields)                   \
+	template <>                                                             \
+	struct ValueTypeInfo<m_type> {                                          \
+		static constexpr const char *metatableName = "mt_" #m_type;         \
+		static constexpr const char *name = #m_type;                        \
+		static constexpr LuaMetatable metatable = METATABLE_##m_variant_type; \
+		static constexpr Variant::Type type = Variant::m_variant_type;      \
+		static constexpr const ValueField *fields = m_fields;               \
+		static constexpr int fieldCount = sizeof(m_fields) / sizeof(ValueField); \
+	};
+
+VALUE_TYPE_INFO(Vector2, VECTOR2, vector2Fields)
+VALUE_TYPE_INFO(Vector3, VECTOR3, vector3Fields)
+VALUE_TYPE_INFO(Color, COLOR, colorFields)
+VALUE_TYPE_INFO(Rect2, RECT2, rect2Fields)
+VALUE_TYPE_INFO(Plane, PLANE, planeFields)
+
+template <typename T>
+static void pushValueUserdata(lua_State *state, const T &value) {
+	*(T *)lua_newuserdata(state, sizeof(T)) = value;
+	LuaState::setMetatable(state, ValueTypeInfo<T>::metatable);
+}
 
-	lua_pushcfunction(L, LUA_LAMBDA_TEMPLATE({
-		int argc = lua_gettop(inner_state);
-		if (argc == 0) {
-			LuaState::pushVariant(inner_state, Vector3());
-		} else {
-			LuaState::pushVariant(inner_state, Vector3(arg1.operator double(), arg2.operator double(), arg3.operator double()));
-		}
-		return 1;
-	}));
-	lua_setglobal(L, "Vector3");
+// Returns the value held by the userdata at index, or nullptr if it is not a T.
+template <typename T>
+static T *toValue(lua_State *state, int index) {
+	return (T *)LuaState::testUserdata(state, index, ValueTypeInfo<T>::metatable);
+}
 
-	lua_pushcfunction(L, LUA_LAMBDA_TEMPLATE({
-		int argc = lua_gettop(inner_state);
-		if (argc == 3) {
-			LuaState::pushVariant(inner_state, Color(arg1.operator double(), arg2.operator double(), arg3.operator double()));
-		} else if (argc == 4) {
-			LuaState::pushVariant(inner_state, Color(arg1.operator double(), arg2.operator double(), arg3.operator double(), arg4.operator double()));
-		} else {
-			LuaState::pushVariant(inner_state, Color());
+// Returns the value held by the userdata at index, raises an error if it is not a T.
+// The metamethods can be fetched with getmetatable and called with any receiver.
+template <typename T>
+static T *checkValue(lua_State *state, int index) {
+	T *value = toValue<T>(state, index);
+	if (value == nullptr) {
+		luaL_argerror(state, index, lua_pushfstring(state, "%s expected", ValueTypeInfo<T>::name));
+	}
+	return value;
+}
+
+template <typename T>
+static const ValueField *findValueField(lua_State *state, int index) {
+	if (lua_type(state, index) != LUA_TSTRING) {
+		return nullptr;
+	}
+
+	const char *key = lua_tostring(state, index);
+	for (int i = 0; i < ValueTypeInfo<T>::fieldCount; i++) {
+		if (strcmp(ValueTypeInfo<T>::fields[i].name, key) == 0) {
+			return &ValueTypeInfo<T>::fields[i];
 		}
-		return 1;
-	}));
-	lua_setglobal(L, "Color");
+	}
+	return nullptr;
+}
 
-	lua_pushcfunction(L, LUA_LAMBDA_TEMPLATE({
-		int argc = lua_gettop(inner_state);
-		if (argc == 2) {
-			LuaState::pushVariant(inner_state, Rect2(arg1.operator Vector2(), arg2.operator Vector2()));
-		} else if (argc == 4) {
-			LuaState::pushVariant(inner_state, Rect2(arg1.operator double(), arg2.operator double(), arg3.operator double(), arg4.operator double()));
-		} else {
-			LuaState::pushVariant(inner_state, Rect2());
+static void pushValueField(lua_State *state, const uint8_t *base, const ValueField *field) {
+	const uint8_t *ptr = base + field->offset;
+	switch (field->type) {
+		case VALUE_FIELD_REAL:
+			lua_pushnumber(state, *(const real_t *)ptr);
+			break;
+		case VALUE_FIELD_FLOAT:
+			lua_pushnumber(state, *(const float *)ptr);
+			break;
+		case VALUE_FIELD_VECTOR2:
+			pushValueUserdata(state, *(const Vector2 *)ptr);
+			break;
+		case VALUE_FIELD_VECTOR3:
+			pushValueUserdata(state, *(const Vector3 *)ptr);
+			break;
+	}
+}
+
+static void setValueField(lua_State *state, uint8_t *base, const ValueField *field, int index) {
+	uint8_t *ptr = base + field->offset;
+	switch (field->type) {
+		case VALUE_FIELD_REAL:
+			*(real_t *)ptr = (real_t)luaL_checknumber(state, index);
+			break;
+		case VALUE_FIELD_FLOAT:
+			*(float *)ptr = (float)luaL_checknumber(state, index);
+			break;
+		case VALUE_FIELD_VECTOR2: {
+			Vector2 *value = toValue<Vector2>(state, index);
+			if (value == nullptr) {
+				luaL_error(state, "expected a Vector2 for field '%s'", field->name);
+				return;
+			}
+			*(Vector2 *)ptr = *value;
+			break;
 		}
+		case VALUE_FIELD_VECTOR3: {
+			Vector3 *value = toValue<Vector3>(state, index);
+			if (value == nullptr) {
+				luaL_error(state, "expected a Vector3 for field '%s'", field->name);
+				return;
+			}
+			*(Vector3 *)ptr = *value;
+			break;
+		}
+	}
+}
+
+template <typename T>
+static int luaValueTypeIndex(lua_State *state) {
+	T *value = checkValue<T>(state, 1);
+	if (const ValueField *field = findValueField<T>(state, 2); field != nullptr) {
+		pushValueField(state, (const uint8_t *)value, field);
 		return 1;
-	}));
-	lua_setglobal(L, "Rect2");
+	}
 
-	lua_pushcfunction(L, LUA_LAMBDA_TEMPLATE({
-		int argc = lua_gettop(inner_state);
-		if (argc == 4) {
-			LuaState::pushVariant(inner_state, Plane(arg1.operator double(), arg2.operator double(), arg3.operator double(), arg4.operator double()));
-		} else if (argc == 3) {
-			LuaState::pushVariant(inner_state, Plane(arg1.operator Vector3(), arg2.operator Vector3(), arg3.operator Vector3()));
-		} else {
-			LuaState::pushVariant(inner_state, Plane(arg1.operator Vector3(), arg1.operator double()));
-		}
+	// Not a component, so check to see if there is a matching function or a derived property
+	Variant var = *value;
+	Variant key = LuaState::getVariant(state, 2, LuaState::getAPI(state));
+	if (var.has_method(key.operator String())) {
+		LuaState::pushMethod(state, 1, 2);
 		return 1;
-	}));
-	lua_setglobal(L, "Plane");
+	}
+
+	LuaState::pushVariant(state, var.get(key));
+	return 1;
 }
 
-// Create metatable for Vector2 and saves it at LUA_REGISTRYINDEX with name "mt_Vector2"
-void LuaState::createVector2Metatable() {
-	luaL_newmetatable(L, "mt_Vector2");
+template <typename T>
+static int luaValueTypeNewIndex(lua_State *state) {
+	T *value = checkValue<T>(state, 1);
+	if (const ValueField *field = findValueField<T>(state, 2); field != nullptr) {
+		setValueField(state, (uint8_t *)value, field, 3);
+		return 0;
+	}
 
-	LUA_METAMETHOD_TEMPLATE(L, -1, "__index", {
-		if (arg1.has_method(arg2.operator String())) {
-			lua_pushlightuserdata(inner_state, lua_touserdata(inner_state, 1));
-			LuaState::pushVariant(inner_state, arg2);
-			lua_pushcclosure(inner_state, luaUserdataFuncCall, 2);
-			return 1;
-		}
+	LuaAPI *api = LuaState::getAPI(state);
+	Variant var = *value;
+	var.set(LuaState::getVariant(state, 2, api), LuaState::getVariant(state, 3, api));
+	*value = var.operator T();
+	return 0;
+}
 
-		LuaState::pushVariant(inner_state, arg1.get(arg2));
-		return 1;
-	});
+template <typename T>
+static int luaValueTypeAdd(lua_State *state) {
+	T *a = toValue<T>(state, 1);
+	T *b = toValue<T>(state, 2);
+	if (a == nullptr || b == nullptr) {
+		return 0;
+	}
 
-	LUA_METAMETHOD_TEMPLATE(L, -1, "__newindex", {
-		// We can't use arg1 here because we need to reference the userdata
-		((Variant *)lua_touserdata(inner_state, 1))->set(arg2, arg3);
+	pushValueUserdata(state, *a + *b);
+	return 1;
+}
+
+template <typename T>
+static int luaValueTypeSub(lua_State *state) {
+	T *a = toValue<T>(state, 1);
+	T *b = toValue<T>(state, 2);
+	if (a == nullptr || b == nullptr) {
 		return 0;
-	});
+	}
 
-	LUA_METAMETHOD_TEMPLATE(L, -1, "__add", {
-		LuaState::pushVariant(inner_state, arg1.operator Vector2() + arg2.operator Vector2());
-		return 1;
-	});
+	pushValueUserdata(state, *a - *b);
+	return 1;
+}
 
-	LUA_METAMETHOD_TEMPLATE(L, -1, "__sub", {
-		LuaState::pushVariant(inner_state, arg1.operator Vector2() - arg2.operator Vector2());
-		return 1;
-	});
+// Supports T * T, T * number and number * T
+template <typename T>
+static int luaValueTypeMul(lua_State *state) {
+	T *a = toValue<T>(state, 1);
+	T *b = toValue<T>(state, 2);
+	if (a != nullptr && b != nullptr) {
+		pushValueUserdata(state, *a * *b);
+	} else if (a != nullptr && lua_type(state, 2) == LUA_TNUMBER) {
+		pushValueUserdata(state, *a * (real_t)lua_tonumber(state, 2));
+	} else if (b != nullptr && lua_type(state, 1) == LUA_TNUMBER) {
+		pushValueUserdata(state, *b * (real_t)lua_tonumber(state, 1));
+	} else {
+		return 0;
+	}
+	return 1;
+}
 
-	LUA_METAMETHOD_TEMPLATE(L, -1, "__mul", {
-		switch (arg2.get_type()) {
-			case Variant::Type::VECTOR2:
-				LuaState::pushVariant(inner_state, arg1.operator Vector2() * arg2.operator Vector2());
-				return 1;
-			case Variant::Type::INT:
-			case Variant::Type::FLOAT:
-				LuaState::pushVariant(inner_state, arg1.operator Vector2() * arg2.operator double());
-				return 1;
-			default:
-				return 0;
-		}
-	});
+// Supports T / T and T / number
+template <typename T>
+static int luaValueTypeDiv(lua_State *state) {
+	T *a = toValue<T>(state, 1);
+	if (a == nullptr) {
+		return 0;
+	}
 
-	LUA_METAMETHOD_TEMPLATE(L, -1, "__div", {
-		switch (arg2.get_type()) {
-			case Variant::Type::VECTOR2:
-				LuaState::pushVariant(inner_state, arg1.operator Vector2() / arg2.operator Vector2());
-				return 1;
-			case Variant::Type::INT:
-			case Variant::Type::FLOAT:
-				LuaState::pushVariant(inner_state, arg1.operator Vector2() / arg2.operator double());
-				return 1;
-			default:
-				return 0;
-		}
-	});
+	if (T *b = toValue<T>(state, 2); b != nullptr) {
+		pushValueUserdata(state, *a / *b);
+	} else if (lua_type(state, 2) == LUA_TNUMBER) {
+		pushValueUserdata(state, *a / (real_t)lua_tonumber(state, 2));
+	} else {
+		return 0;
+	}
+	return 1;
+}
 
-	LUA_METAMETHOD_TEMPLATE(L, -1, "__eq", {
-		LuaState::pushVariant(inner_state, arg1.operator Vector2() == arg2.operator Vector2());
-		return 1;
-	});
+template <typename T>
+static int luaValueTypeEq(lua_State *state) {
+	T *a = toValue<T>(state, 1);
+	T *b = toValue<T>(state, 2);
+	lua_pushboolean(state, a != nullptr && b != nullptr && *a == *b);
+	return 1;
+}
 
-	LUA_METAMETHOD_TEMPLATE(L, -1, "__lt", {
-		LuaState::pushVariant(inner_state, arg1.operator Vector2() < arg2.operator Vector2());
-		return 1;
-	});
+template <typename T>
+static int luaValueTypeLt(lua_State *state) {
+	T *a = toValue<T>(state, 1);
+	T *b = toValue<T>(state, 2);
+	lua_pushboolean(state, a != nullptr && b != nullptr && *a < *b);
+	return 1;
+}
 
-	LUA_METAMETHOD_TEMPLATE(L, -1, "__le", {
-		LuaState::pushVariant(inner_state, arg1.operator Vector2() <= arg2.operator Vector2());
-		return 1;
-	});
+template <typename T>
+static int luaValueTypeLe(lua_State *state) {
+	T *a = toValue<T>(state, 1);
+	T *b = toValue<T>(state, 2);
+	lua_pushboolean(state, a != nullptr && b != nullptr && *a <= *b);
+	return 1;
+}
 
-	lua_pop(L, 1); // Stack is now unmodified
+// Creates the metatable for a value type with __index, __newindex and __eq. Leaves it on the stack.
+template <typename T>
+static void newValueTypeMetatable(lua_State *L) {
+	LuaState::newMetatable(L, ValueTypeInfo<T>::metatable, ValueTypeInfo<T>::metatableName);
+
+	lua_pushinteger(L, ValueTypeInfo<T>::type);
+	lua_rawseti(L, -2, LAPI_METATABLE_TYPE_INDEX);
+
+	lua_pushstring(L, "__index");
+	lua_pushcfunction(L, luaValueTypeIndex<T>);
+	lua_settable(L, -3);
+
+	lua_pushstring(L, "__newindex");
+	lua_pushcfunction(L, luaValueTypeNewIndex<T>);
+	lua_settable(L, -3);
+
+	lua_pushstring(L, "__eq");
+	lua_pushcfunction(L, luaValueTypeEq<T>);
+	lua_settable(L, -3);
+
+	lua_newtable(L);
+	lua_rawseti(L, -2, LAPI_METATABLE_METHODS_INDEX);
 }
 
-// Create metatable for Vector3 and saves it at LUA_REGISTRYINDEX with name "mt_Vector3"
-void LuaState::createVector3Metatable() {
-	luaL_newmetatable(L, "mt_Vector3");
+// Adds __add, __sub, __mul and __div to the metatable on the top of the stack.
+template <typename T>
+static void addValueTypeArithmetic(lua_State *L) {
+	lua_pushstring(L, "__add");
+	lua_pushcfunction(L, luaValueTypeAdd<T>);
+	lua_settable(L, -3);
 
-	LUA_METAMETHOD_TEMPLATE(L, -1, "__index", {
-		if (arg1.has_method(arg2.operator String())) {
-			lua_pushlightuserdata(inner_state, lua_touserdata(inner_state, 1));
-			LuaState::pushVariant(inner_state, arg2);
-			lua_pushcclosure(inner_state, luaUserdataFuncCall, 2);
-			return 1;
-		}
+	lua_pushstring(L, "__sub");
+	lua_pushcfunction(L, luaValueTypeSub<T>);
+	lua_settable(L, -3);
 
-		LuaState::pushVariant(inner_state, arg1.get(arg2));
-		return 1;
-	});
+	lua_pushstring(L, "__mul");
+	lua_pushcfunction(L, luaValueTypeMul<T>);
+	lua_settable(L, -3);
 
-	LUA_METAMETHOD_TEMPLATE(L, -1, "__newindex", {
-		// We can't use arg1 here because we need to reference the userdata
-		((Variant *)lua_touserdata(inner_state, 1))->set(arg2, arg3);
-		return 0;
-	});
+	lua_pushstring(L, "__div");
+	lua_pushcfunction(L, luaValueTypeDiv<T>);
+	lua_settable(L, -3);
+}
 
-	LUA_METAMETHOD_TEMPLATE(L, -1, "__add", {
-		LuaState::pushVariant(inner_state, arg1.operator Vector3() + arg2.operator Vector3());
+// Expose the default constructors
+void LuaState::exposeConstructors() {
+	lua_pushcfunction(L, [](lua_State *inner_state) -> int {
+		pushValueUserdata(inner_state, Vector2(luaL_optnumber(inner_state, 1, 0), luaL_optnumber(inner_state, 2, 0)));
 		return 1;
 	});
+	lua_setglobal(L, "Vector2");
 
-	LUA_METAMETHOD_TEMPLATE(L, -1, "__sub", {
-		LuaState::pushVariant(inner_state, arg1.operator Vector3() - arg2.operator Vector3());
+	lua_pushcfunction(L, [](lua_State *inner_state) -> int {
+		pushValueUserdata(inner_state, Vector3(luaL_optnumber(inner_state, 1, 0), luaL_optnumber(inner_state, 2, 0), luaL_optnumber(inner_state, 3, 0)));
 		return 1;
 	});
+	lua_setglobal(L, "Vector3");
 
-	LUA_METAMETHOD_TEMPLATE(L, -1, "__mul", {
-		switch (arg2.get_type()) {
-			case Variant::Type::VECTOR3:
-				LuaState::pushVariant(inner_state, arg1.operator Vector3() * arg2.operator Vector3());
-				return 1;
-			case Variant::Type::INT:
-			case Variant::Type::FLOAT:
-				LuaState::pushVariant(inner_state, arg1.operator Vector3() * arg2.operator double());
-				return 1;
-			default:
-				return 0;
+	lua_pushcfunction(L, [](lua_State *inner_state) -> int {
+		int argc = lua_gettop(inner_state);
+		if (argc == 3) {
+			pushValueUserdata(inner_state, Color(luaL_checknumber(inner_state, 1), luaL_checknumber(inner_state, 2), luaL_checknumber(inner_state, 3)));
+		} else if (argc == 4) {
+			pushValueUserdata(inner_state, Color(luaL_checknumber(inner_state, 1), luaL_checknumber(inner_state, 2), luaL_checknumber(inner_state, 3), luaL_checknumber(inner_state, 4)));
+		} else {
+			pushValueUserdata(inner_state, Color());
 		}
+		return 1;
 	});
+	lua_setglobal(L, "Color");
 
-	LUA_METAMETHOD_TEMPLATE(L, -1, "__div", {
-		switch (arg2.get_type()) {
-			case Variant::Type::VECTOR3:
-				LuaState::pushVariant(inner_state, arg1.operator Vector3() / arg2.operator Vector3());
-				return 1;
-			case Variant::Type::INT:
-			case Variant::Type::FLOAT:
-				LuaState::pushVariant(inner_state, arg1.operator Vector3() / arg2.operator double());
-				return 1;
-			default:
-				return 0;
+	lua_pushcfunction(L, [](lua_State *inner_state) -> int {
+		int argc = lua_gettop(inner_state);
+		if (argc == 2) {
+			Vector2 *position = toValue<Vector2>(inner_state, 1);
+			Vector2 *size = toValue<Vector2>(inner_state, 2);
+			if (position == nullptr || size == nullptr) {
+				return luaL_error(inner_state, "Rect2 expects 2 Vector2 or 4 numbers");
+			}
+			pushValueUserdata(inner_state, Rect2(*position, *size));
+		} else if (argc == 4) {
+			pushValueUserdata(inner_state, Rect2(luaL_checknumber(inner_state, 1), luaL_checknumber(inner_state, 2), luaL_checknumber(inner_state, 3), luaL_checknumber(inner_state, 4)));
+		} else {
+			pushValueUserdata(inner_state, Rect2());
 		}
+		return 1;
 	});
+	lua_setglobal(L, "Rect2");
 
-	LUA_METAMETHOD_TEMPLATE(L, -1, "__eq", {
-		LuaState::pushVariant(inner_state, arg1.operator Vector3() == arg2.operator Vector3());
+	lua_pushcfunction(L, [](lua_State *inner_state) -> int {
+		int argc = lua_gettop(inner_state);
+		if (argc == 4) {
+			pushValueUserdata(inner_state, Plane(luaL_checknumber(inner_state, 1), luaL_checknumber(inner_state, 2), luaL_checknumber(inner_state, 3), luaL_checknumber(inner_state, 4)));
+		} else if (argc == 3) {
+			Vector3 *p1 = toValue<Vector3>(inner_state, 1);
+			Vector3 *p2 = toValue<Vector3>(inner_state, 2);
+			Vector3 *p3 = toValue<Vector3>(inner_state, 3);
+			if (p1 == nullptr || p2 == nullptr || p3 == nullptr) {
+				return luaL_error(inner_state, "Plane expects 3 Vector3 points");
+			}
+			pushValueUserdata(inner_state, Plane(*p1, *p2, *p3));
+		} else if (Vector3 *normal = toValue<Vector3>(inner_state, 1); normal != nullptr) {
+			pushValueUserdata(inner_state, Plane(*normal, luaL_optnumber(inner_state, 2, 0)));
+		} else {
+			pushValueUserdata(inner_state, Plane());
+		}
 		return 1;
 	});
-
-	lua_pop(L, 1); // Stack is now unmodified
+	lua_setglobal(L, "Plane");
 }
 
-// Create metatable for Rect2 and saves it at LUA_REGISTRYINDEX with name "mt_Rect2"
-void LuaState::createRect2Metatable() {
-	luaL_newmetatable(L, "mt_Rect2");
-
-	LUA_METAMETHOD_TEMPLATE(L, -1, "__index", {
-		// Index was not found, so check to see if there is a matching function
-		if (arg1.has_method(arg2.operator String())) {
-			lua_pushlightuserdata(inner_state, lua_touserdata(inner_state, 1));
-			LuaState::pushVariant(inner_state, arg2);
-			lua_pushcclosure(inner_state, luaUserdataFuncCall, 2);
-			return 1;
-		}
+// Create metatable for Vector2 and saves it at LUA_REGISTRYINDEX with name "mt_Vector2"
+void LuaState::createVector2Metatable() {
+	newValueTypeMetatable<Vector2>(L);
+	addValueTypeArithmetic<Vector2>(L);
 
-		LuaState::pushVariant(inner_state, arg1.get(arg2));
-		return 1;
-	});
+	lua_pushstring(L, "__lt");
+	lua_pushcfunction(L, luaValueTypeLt<Vector2>);
+	lua_settable(L, -3);
 
-	LUA_METAMETHOD_TEMPLATE(L, -1, "__newindex", {
-		// We can't use arg1 here because we need to reference the userdata
-		((Variant *)lua_touserdata(inner_state, 1))->set(arg2, arg3);
-		return 0;
-	});
+	lua_pushstring(L, "__le");
+	lua_pushcfunction(L, luaValueTypeLe<Vector2>);
+	lua_settable(L, -3);
 
-	LUA_METAMETHOD_TEMPLATE(L, -1, "__eq", {
-		LuaState::pushVariant(inner_state, arg1.operator Rect2() == arg2.operator Rect2());
-		return 1;
-	});
+	lua_pop(L, 1); // Stack is now unmodified
+}
+
+// Create metatable for Vector3 and saves it at LUA_REGISTRYINDEX with name "mt_Vector3"
+void LuaState::createVector3Metatable() {
+	newValueTypeMetatable<Vector3>(L);
+	addValueTypeArithmetic<Vector3>(L);
+	lua_pop(L, 1); // Stack is now unmodified
+}
 
+// Create metatable for Rect2 and saves it at LUA_REGISTRYINDEX with name "mt_Rect2"
+void LuaState::createRect2Metatable() {
+	newValueTypeMetatable<Rect2>(L);
 	lua_pop(L, 1); // Stack is now unmodified
 }
 
 // Create metatable for Plane and saves it at LUA_REGISTRYINDEX with name "mt_Plane"
 void LuaState::createPlaneMetatable() {
-	luaL_newmetatable(L, "mt_Plane");
-
-	LUA_METAMETHOD_TEMPLATE(L, -1, "__index", {
-		if (arg1.has_method(arg2.operator String())) {
-			lua_pushlightuserdata(inner_state, lua_touserdata(inner_state, 1));
-			LuaState::pushVariant(inner_state, arg2);
-			lua_pushcclosure(inner_state, luaUserdataFuncCall, 2);
-			return 1;
-		}
-
-		LuaState::pushVariant(inner_state, arg1.get(arg2));
-		return 1;
-	});
-
-	LUA_METAMETHOD_TEMPLATE(L, -1, "__newindex", {
-		// We can't use arg1 here because we need to reference the userdata
-		((Variant *)lua_touserdata(inner_state, 1))->set(arg2, arg3);
-		return 0;
-	});
-
-	LUA_METAMETHOD_TEMPLATE(L, -1, "__eq", {
-		LuaState::pushVariant(inner_state, arg1.operator Plane() == arg2.operator Plane());
-		return 1;
-	});
-
+	newValueTypeMetatable<Plane>(L);
 	lua_pop(L, 1); // Stack is now unmodified
 }
 
 // Create metatable for Color and saves it at LUA_REGISTRYINDEX with name "mt_Color"
 void LuaState::createColorMetatable() {
-	luaL_newmetatable(L, "mt_Color");
-
-	LUA_METAMETHOD_TEMPLATE(L, -1, "__index", {
-		if (arg1.has_method(arg2.operator String())) {
-			lua_pushlightuserdata(inner_state, lua_touserdata(inner_state, 1));
-			LuaState::pushVariant(inner_state, arg2);
-			lua_pushcclosure(inner_state, luaUserdataFuncCall, 2);
-			return 1;
-		}
-
-		LuaState::pushVariant(inner_state, arg1.get(arg2));
-		return 1;
-	});
-
-	LUA_METAMETHOD_TEMPLATE(L, -1, "__newindex", {
-		// We can't use arg1 here because we need to reference the userdata
-		((Variant *)lua_touserdata(inner_state, 1))->set(arg2, arg3);
-		return 0;
-	});
-
-	LUA_METAMETHOD_TEMPLATE(L, -1, "__add", {
-		LuaState::pushVariant(inner_state, arg1.operator Color() + arg2.operator Color());
-		return 1;
-	});
-
-	LUA_METAMETHOD_TEMPLATE(L, -1, "__sub", {
-		LuaState::pushVariant(inner_state, arg1.operator Color() - arg2.operator Color());
-		return 1;
-	});
-
-	LUA_METAMETHOD_TEMPLATE(L, -1, "__mul", {
-		switch (arg2.get_type()) {
-			case Variant::Type::COLOR:
-				LuaState::pushVariant(inner_state, arg1.operator Color() * arg2.operator Color());
-				return 1;
-			case Variant::Type::INT:
-			case Variant::Type::FLOAT:
-				LuaState::pushVariant(inner_state, arg1.operator Color() * arg2.operator double());
-				return 1;
-			default:
-				return 0;
-		}
-	});
-
-	LUA_METAMETHOD_TEMPLATE(L, -1, "__div", {
-		switch (arg2.get_type()) {
-			case Variant::Type::COLOR:
-				LuaState::pushVariant(inner_state, arg1.operator Color() / arg2.operator Color());
-				return 1;
-			case Variant::Type::INT:
-			case Variant::Type::FLOAT:
-				LuaState::pushVariant(inner_state, arg1.operator Color() / arg2.operator double());
-				return 1;
-			default:
-				return 0;
-		}
-	});
+	newValueTypeMetatable<Color>(L);
+	addValueTypeArithmetic<Color>(L);
+	lua_pop(L, 1); // Stack is now unmodified
+}
 
-	LUA_METAMETHOD_TEMPLATE(L, -1, "__eq", {
-		LuaState::pushVariant(inner_state, arg1.operator Color() == arg2.operator Color());
-		return 1;
-	});
+// Pushes a value type as its raw struct
+void LuaState::pushValueType(lua_State *state, const Variant &var) {
+	switch (var.get_type()) {
+		case Variant::Type::VECTOR2:
+			pushValueUserdata(state, var.operator Vector2());
+			break;
+		case Variant::Type::VECTOR3:
+			pushValueUserdata(state, var.operator Vector3());
+			break;
+		case Variant::Type::COLOR:
+			pushValueUserdata(state, var.operator Color());
+			break;
+		case Variant::Type::RECT2:
+			pushValueUserdata(state, var.operator Rect2());
+			break;
+		case Variant::Type::PLANE:
+			pushValueUserdata(state, var.operator Plane());
+			break;
+		default:
+			lua_pushnil(state);
+			break;
+	}
+}
 
-	lua_pop(L, 1); // Stack is now unmodified
+// Returns the value type held by the userdata at index
+Variant LuaState::getValueType(lua_State *state, int index, Variant::Type type) {
+	void *userdata = lua_touserdata(state, index);
+	switch (type) {
+		case Variant::Type::VECTOR2:
+			return *(Vector2 *)userdata;
+		case Variant::Type::VECTOR3:
+			return *(Vector3 *)userdata;
+		case Variant::Type::COLOR:
+			return *(Color *)userdata;
+		case Variant::Type::RECT2:
+			return *(Rect2 *)userdata;
+		case Variant::Type::PLANE:
+			return *(Plane *)userdata;
+		default:
+			return Variant();
+	}
 }
 
 // Create metatable for Signal and saves it at LUA_REGISTRYINDEX with name "mt_Signal"
 void LuaState::createSignalMetatable() {
-	luaL_newmetatable(L, "mt_Signal");
+	newMetatable(L, METATABLE_SIGNAL, "mt_Signal");
 
-	LUA_METAMETHOD_TEMPLATE(L, -1, "__index", {
-		if (arg1.has_method(arg2.operator String())) {
-			lua_pushlightuserdata(inner_state, lua_touserdata(inner_state, 1));
-			LuaState::pushVariant(inner_state, arg2);
-			lua_pushcclosure(inner_state, luaUserdataFuncCall, 2);
+	lua_newtable(L);
+	lua_rawseti(L, -2, LAPI_METATABLE_METHODS_INDEX);
+
+	LUA_METAMETHOD_TEMPLATE(L, -1, "__index", 2, {
+		if (args[1].has_method(args[2].operator String())) {
+			LuaState::pushMethod(inner_state, 1, 2);
 			return 1;
 		}
 
-		LuaState::pushVariant(inner_state, arg1.get(arg2));
+		LuaState::pushVariant(inner_state, args[1].get(args[2]));
 		return 1;
 	});
 
 	lua_pop(L, 1); // Stack is now unmodified
 }
 
+// Returns the object held by var, or nullptr if it has been freed.
+static Object *toObject(Variant &var) {
+#ifndef LAPI_GDEXTENSION
+	return var.get_validated_object();
+#else
+	return var.operator Object *();
+#endif
+}
+
 // Create metatable for any Object and saves it at LUA_REGISTRYINDEX with name "mt_Object"
 void LuaState::createObjectMetatable() {
-	luaL_newmetatable(L, "mt_Object");
+	newMetatable(L, METATABLE_OBJECT, "mt_Object");
+
+	lua_newtable(L);
+	lua_rawseti(L, -2, LAPI_METATABLE_METHODS_INDEX);
+
+	LUA_METAMETHOD_TEMPLATE(L, -1, "__index", 2, {
+		Object *obj = toObject(args[1]);
+		if (obj == nullptr) {
+			return 0;
+		}
+
+		LuaBindingCache *cache = api->getBindingCache();
+		LuaBindingCache::ClassBindings *bindings = cache->getClass(obj, api);
 
-	LUA_METAMETHOD_TEMPLATE(L, -1, "__index", {
 		// If object overrides
-		if (arg1.has_method("__index")) {
-			LuaState::pushVariant(inner_state, arg1.call("__index", Ref<LuaAPI>(api), arg2));
+		if (bindings->overridesIndex) {
+			LuaState::pushVariant(inner_state, args[1].call("__index", Ref<LuaAPI>(api), args[2]));
 			return 1;
 		}
 
-		bool permissive = api->getPermissive();
-		Array allowedFields = Array();
-		if (arg1.has_method("lua_fields")) {
-			allowedFields = arg1.call("lua_fields");
+		if (lua_type(inner_state, 2) != LUA_TSTRING) {
+			return 0;
 		}
 
-		// In permissive mode, allowedFields beomces a blacklist.
-		if (permissive) {
-			if (!allowedFields.has(arg2) && arg1.has_method(arg2.operator String())) {
-				lua_pushlightuserdata(inner_state, lua_touserdata(inner_state, 1));
-				LuaState::pushVariant(inner_state, arg2);
-				lua_pushcclosure(inner_state, luaUserdataFuncCall, 2);
+		const LuaBindingCache::Binding &binding = cache->getBinding(bindings, obj, LuaState::toString(inner_state, 2), api->getPermissive());
+		switch (binding.kind) {
+			case LuaBindingCache::BINDING_METHOD:
+				LuaState::pushMethod(inner_state, 1, 2);
 				return 1;
-			}
-
-			if (!allowedFields.has(arg2)) {
-				Variant var = arg1.get(arg2);
-				LuaState::pushVariant(inner_state, var);
+			case LuaBindingCache::BINDING_PROPERTY:
+				LuaState::pushVariant(inner_state, obj->get(binding.name));
 				return 1;
-			}
-			return 0;
-		}
-
-		// If the functions is allowed and exists
-		if (allowedFields.has(arg2) && arg1.has_method(arg2.operator String())) {
-			lua_pushlightuserdata(inner_state, lua_touserdata(inner_state, 1));
-			LuaState::pushVariant(inner_state, arg2);
-			lua_pushcclosure(inner_state, luaUserdataFuncCall, 2);
-			return 1;
+			default:
+				return 0;
 		}
+	});
 
-		// If the field is allowed
-		if (allowedFields.has(arg2)) {
-			Variant var = arg1.get(arg2);
-			LuaState::pushVariant(inner_state, var);
-			return 1;
+	LUA_METAMETHOD_TEMPLATE(L, -1, "__newindex", 3, {
+		Object *obj = toObject(args[1]);
+		if (obj == nullptr) {
+			return 0;
 		}
 
-		return 0;
-	});
+		LuaBindingCache *cache = api->getBindingCache();
+		LuaBindingCache::ClassBindings *bindings = cache->getClass(obj, api);
 
-	LUA_METAMETHOD_TEMPLATE(L, -1, "__newindex", {
 		// If object overrides
-		if (arg1.has_method("__newindex")) {
-			LuaState::pushVariant(inner_state, arg1.call("__newindex", Ref<LuaAPI>(api), arg2, arg3));
+		if (bindings->overridesNewIndex) {
+			LuaState::pushVariant(inner_state, args[1].call("__newindex", Ref<LuaAPI>(api), args[2], args[3]));
 			return 1;
 		}
 
-		bool permissive = api->getPermissive();
-		Array allowedFields = Array();
-		if (arg1.has_method("lua_fields")) {
-			allowedFields = arg1.call("lua_fields");
+		if (lua_type(inner_state, 2) != LUA_TSTRING) {
+			return 0;
 		}
 
-		if (!permissive && allowedFields.has(arg2)) {
-			// We can't use arg1 here because we need to reference the userdata
-			((Variant *)lua_touserdata(inner_state, 1))->set(arg2, arg3);
-		} else if (permissive && !allowedFields.has(arg2)) { // In permissive mode, allowedFields beomces a blacklist.
-			((Variant *)lua_touserdata(inner_state, 1))->set(arg2, arg3);
+		const LuaBindingCache::Binding &binding = cache->getBinding(bindings, obj, LuaState::toString(inner_state, 2), api->getPermissive());
+		if (binding.kind != LuaBindingCache::BINDING_DENIED) {
+			obj->set(binding.name, args[3]);
 		}
 		return 0;
 	});
 
-	LUA_METAMETHOD_TEMPLATE(L, -1, "__call", {
-		if (!arg1.has_method("__call")) {
+	LUA_METAMETHOD_TEMPLATE(L, -1, "__call", 1, {
+		if (!args[1].has_method("__call")) {
 			return 0;
 		}
 		int argc = lua_gettop(inner_state);
 
-		Array args;
+		Array callArgs;
+		callArgs.resize(argc - 1);
 		for (int i = 1; i < argc; i++) {
-			args.push_back(LuaState::getVariant(inner_state, i + 1, api));
+			callArgs[i - 1] = LuaState::getVariant(inner_state, i + 1, api);
 		}
 
-		LuaState::pushVariant(inner_state, arg1.call("__call", Ref<LuaAPI>(api), LuaTuple::fromArray(args)));
+		LuaState::pushVariant(inner_state, args[1].call("__call", Ref<LuaAPI>(api), LuaTuple::fromArray(callArgs)));
 		return 1;
 	});
 
 #ifndef LAPI_GDEXTENSION
-	LUA_METAMETHOD_TEMPLATE(L, -1, "__gc", {
-		if (!arg1.has_method("__gc")) {
+	LUA_METAMETHOD_TEMPLATE(L, -1, "__gc", 1, {
+		if (!args[1].has_method("__gc")) {
 			return 0;
 		}
 
-		LuaState::pushVariant(inner_state, arg1.call("__gc", api));
+		LuaState::pushVariant(inner_state, args[1].call("__gc", api));
 		return 1;
 	});
 #else
-	LUA_METAMETHOD_TEMPLATE(L, -1, "__gc", {
+	LUA_METAMETHOD_TEMPLATE(L, -1, "__gc", 1, {
 		// If object is a RefCounted
-		Ref<RefCounted> ref = Object::cast_to<RefCounted>(arg1);
+		Ref<RefCounted> ref = Object::cast_to<RefCounted>(args[1]);
 		if (ref != nullptr) {
 			ref->unreference();
 		}
 
-		if (!arg1.has_method("__gc")) {
+		if (!args[1].has_method("__gc")) {
 			return 0;
 		}
 
-		LuaState::pushVariant(inner_state, arg1.call("__gc", api));
+		LuaState::pushVariant(inner_state, args[1].call("__gc", api));
 		return 1;
 	});
 #endif
 
-	LUA_METAMETHOD_TEMPLATE(L, -1, "__tostring", {
+	LUA_METAMETHOD_TEMPLATE(L, -1, "__tostring", 1, {
 		// If object overrides
-		if (!arg1.has_method("__tostring")) {
+		if (!args[1].has_method("__tostring")) {
 			return 0;
 		}
 
-		LuaState::pushVariant(inner_state, arg1.call("__tostring", api));
+		LuaState::pushVariant(inner_state, args[1].call("__tostring", api));
 		return 1;
 	});
 
-	LUA_METAMETHOD_TEMPLATE(L, -1, "__metatable", {
+	LUA_METAMETHOD_TEMPLATE(L, -1, "__metatable", 2, {
 		// If object overrides
-		if (!arg1.has_method("__metatable")) {
+		if (!args[1].has_method("__metatable")) {
 			return 0;
 		}
 
-		LuaState::pushVariant(inner_state, arg1.call("__metatable", Ref<LuaAPI>(api), arg2));
+		LuaState::pushVariant(inner_state, args[1].call("__metatable", Ref<LuaAPI>(api), args[2]));
 		return 1;
 	});
 
-	LUA_METAMETHOD_TEMPLATE(L, -1, "__len", {
+	LUA_METAMETHOD_TEMPLATE(L, -1, "__len", 1, {
 		// If object overrides
-		if (!arg1.has_method("__len")) {
+		if (!args[1].has_method("__len")) {
 			return 0;
 		}
 
-		LuaState::pushVariant(inner_state, arg1.call("__len", api));
+		LuaState::pushVariant(inner_state, args[1].call("__len", api));
 		return 1;
 	});
 
-	LUA_METAMETHOD_TEMPLATE(L, -1, "__unm", {
+	LUA_METAMETHOD_TEMPLATE(L, -1, "__unm", 1, {
 		// If object overrides
-		if (!arg1.has_method("__unm")) {
+		if (!args[1].has_method("__unm")) {
 			return 0;
 		}
 
-		LuaState::pushVariant(inner_state, arg1.call("__unm", api));
+		LuaState::pushVariant(inner_state, args[1].call("__unm", api));
 		return 1;
 	});
 
-	LUA_METAMETHOD_TEMPLATE(L, -1, "__add", {
+	LUA_METAMETHOD_TEMPLATE(L, -1, "__add", 2, {
 		// If object overrides
-		if (!arg1.has_method("__add")) {
+		if (!args[1].has_method("__add")) {
 			return 0;
 		}
 
-		LuaState::pushVariant(inner_state, arg1.call("__add", Ref<LuaAPI>(api), arg2));
+		LuaState::pushVariant(inner_state, args[1].call("__add", Ref<LuaAPI>(api), args[2]));
 		return 1;
 	});
 
-	LUA_METAMETHOD_TEMPLATE(L, -1, "__sub", {
+	LUA_METAMETHOD_TEMPLATE(L, -1, "__sub", 2, {
 		// If object overrides
-		if (!arg1.has_method("__sub")) {
+		if (!args[1].has_method("__sub")) {
 			return 0;
 		}
 
-		LuaState::pushVariant(inner_state, arg1.call("__sub", Ref<LuaAPI>(api), arg2));
+		LuaState::pushVariant(inner_state, args[1].call("__sub", Ref<LuaAPI>(api), args[2]));
 		return 1;
 	});
 
-	LUA_METAMETHOD_TEMPLATE(L, -1, "__mul", {
+	LUA_METAMETHOD_TEMPLATE(L, -1, "__mul", 2, {
 		// If object overrides
-		if (!arg1.has_method("__mul")) {
+		if (!args[1].has_method("__mul")) {
 			return 0;
 		}
 
-		LuaState::pushVariant(inner_state, arg1.call("__mul", Ref<LuaAPI>(api), arg2));
+		LuaState::pushVariant(inner_state, args[1].call("__mul", Ref<LuaAPI>(api), args[2]));
 		return 1;
 	});
 
-	LUA_METAMETHOD_TEMPLATE(L, -1, "__div", {
+	LUA_METAMETHOD_TEMPLATE(L, -1, "__div", 2, {
 		// If object overrides
-		if (!arg1.has_method("__div")) {
+		if (!args[1].has_method("__div")) {
 			return 0;
 		}
 
-		LuaState::pushVariant(inner_state, arg1.call("__div", Ref<LuaAPI>(api), arg2));
+		LuaState::pushVariant(inner_state, args[1].call("__div", Ref<LuaAPI>(api), args[2]));
 		return 1;
 	});
 
-	LUA_METAMETHOD_TEMPLATE(L, -1, "__idiv", {
+	LUA_METAMETHOD_TEMPLATE(L, -1, "__idiv", 2, {
 		// If object overrides
-		if (!arg1.has_method("__idiv")) {
+		if (!args[1].has_method("__idiv")) {
 			return 0;
 		}
 
-		LuaState::pushVariant(inner_state, arg1.call("__idiv", Ref<LuaAPI>(api), arg2));
+		LuaState::pushVariant(inner_state, args[1].call("__idiv", Ref<LuaAPI>(api), args[2]));
 		return 1;
 	});
 
-	LUA_METAMETHOD_TEMPLATE(L, -1, "__mod", {
+	LUA_METAMETHOD_TEMPLATE(L, -1, "__mod", 2, {
 		// If object overrides
-		if (!arg1.has_method("__mod")) {
+		if (!args[1].has_method("__mod")) {
 			return 0;
 		}
 
-		LuaState::pushVariant(inner_state, arg1.call("__mod", Ref<LuaAPI>(api), arg2));
+		LuaState::pushVariant(inner_state, args[1].call("__mod", Ref<LuaAPI>(api), args[2]));
 		return 1;
 	});
 
-	LUA_METAMETHOD_TEMPLATE(L, -1, "__pow", {
+	LUA_METAMETHOD_TEMPLATE(L, -1, "__pow", 2, {
 		// If object overrides
-		if (!arg1.has_method("__pow")) {
+		if (!args[1].has_method("__pow")) {
 			return 0;
 		}
 
-		LuaState::pushVariant(inner_state, arg1.call("__pow", Ref<LuaAPI>(api), arg2));
+		LuaState::pushVariant(inner_state, args[1].call("__pow", Ref<LuaAPI>(api), args[2]));
 		return 1;
 	});
 
-	LUA_METAMETHOD_TEMPLATE(L, -1, "__concat", {
+	LUA_METAMETHOD_TEMPLATE(L, -1, "__concat", 2, {
 		// If object overrides
-		if (!arg1.has_method("__concat")) {
+		if (!args[1].has_method("__concat")) {
 			return 0;
 		}
 
-		LuaState::pushVariant(inner_state, arg1.call("__concat", Ref<LuaAPI>(api), arg2));
+		LuaState::pushVariant(inner_state, args[1].call("__concat", Ref<LuaAPI>(api), args[2]));
 		return 1;
 	});
 
-	LUA_METAMETHOD_TEMPLATE(L, -1, "__band", {
+	LUA_METAMETHOD_TEMPLATE(L, -1, "__band", 2, {
 		// If object overrides
-		if (!arg1.has_method("__band")) {
+		if (!args[1].has_method("__band")) {
 			return 0;
 		}
 
-		LuaState::pushVariant(inner_state, arg1.call("__band", Ref<LuaAPI>(api), arg2));
+		LuaState::pushVariant(inner_state, args[1].call("__band", Ref<LuaAPI>(api), args[2]));
 		return 1;
 	});
 
-	LUA_METAMETHOD_TEMPLATE(L, -1, "__bor", {
+	LUA_METAMETHOD_TEMPLATE(L, -1, "__bor", 2, {
 		// If object overrides
-		if (!arg1.has_method("__bor")) {
+		if (!args[1].has_method("__bor")) {
 			return 0;
 		}
 
-		LuaState::pushVariant(inner_state, arg1.call("__bor", Ref<LuaAPI>(api), arg2));
+		LuaState::pushVariant(inner_state, args[1].call("__bor", Ref<LuaAPI>(api), args[2]));
 		return 1;
 	});
 
-	LUA_METAMETHOD_TEMPLATE(L, -1, "__bxor", {
+	LUA_METAMETHOD_TEMPLATE(L, -1, "__bxor", 2, {
 		// If object overrides
-		if (!arg1.has_method("__bxor")) {
+		if (!args[1].has_method("__bxor")) {
 			return 0;
 		}
 
-		LuaState::pushVariant(inner_state, arg1.call("__bxor", Ref<LuaAPI>(api), arg2));
+		LuaState::pushVariant(inner_state, args[1].call("__bxor", Ref<LuaAPI>(api), args[2]));
 		return 1;
 	});
 
-	LUA_METAMETHOD_TEMPLATE(L, -1, "__bnot", {
+	LUA_METAMETHOD_TEMPLATE(L, -1, "__bnot", 2, {
 		// If object overrides
-		if (!arg1.has_method("__bnot")) {
+		if (!args[1].has_method("__bnot")) {
 			return 0;
 		}
 
-		LuaState::pushVariant(inner_state, arg1.call("__bnot", Ref<LuaAPI>(api), arg2));
+		LuaState::pushVariant(inner_state, args[1].call("__bnot", Ref<LuaAPI>(api), args[2]));
 		return 1;
 	});
 
-	LUA_METAMETHOD_TEMPLATE(L, -1, "__shl", {
+	LUA_METAMETHOD_TEMPLATE(L, -1, "__shl", 2, {
 		// If object overrides
-		if (!arg1.has_method("__shl")) {
+		if (!args[1].has_method("__shl")) {
 			return 0;
 		}
 
-		LuaState::pushVariant(inner_state, arg1.call("__shl", Ref<LuaAPI>(api), arg2));
+		LuaState::pushVariant(inner_state, args[1].call("__shl", Ref<LuaAPI>(api), args[2]));
 		return 1;
 	});
 
-	LUA_METAMETHOD_TEMPLATE(L, -1, "__shr", {
+	LUA_METAMETHOD_TEMPLATE(L, -1, "__shr", 2, {
 		// If object overrides
-		if (!arg1.has_method("__shr")) {
+		if (!args[1].has_method("__shr")) {
 			return 0;
 		}
 
-		LuaState::pushVariant(inner_state, arg1.call("__shr", Ref<LuaAPI>(api), arg2));
+		LuaState::pushVariant(inner_state, args[1].call("__shr", Ref<LuaAPI>(api), args[2]));
 		return 1;
 	});
 
-	LUA_METAMETHOD_TEMPLATE(L, -1, "__eq", {
+	LUA_METAMETHOD_TEMPLATE(L, -1, "__eq", 2, {
 		// If object overrides
-		if (!arg1.has_method("__eq")) {
+		if (!args[1].has_method("__eq")) {
 			return 0;
 		}
 
-		LuaState::pushVariant(inner_state, arg1.call("__eq", Ref<LuaAPI>(api), arg2));
+		LuaState::pushVariant(inner_state, args[1].call("__eq", Ref<LuaAPI>(api), args[2]));
 		return 1;
 	});
 
-	LUA_METAMETHOD_TEMPLATE(L, -1, "__lt", {
+	LUA_METAMETHOD_TEMPLATE(L, -1, "__lt", 2, {
 		// If object overrides
-		if (!arg1.has_method("__lt")) {
+		if (!args[1].has_method("__lt")) {
 			return 0;
 		}
 
-		LuaState::pushVariant(inner_state, arg1.call("__lt", Ref<LuaAPI>(api), arg2));
+		LuaState::pushVariant(inner_state, args[1].call("__lt", Ref<LuaAPI>(api), args[2]));
 		return 1;
 	});
 
-	LUA_METAMETHOD_TEMPLATE(L, -1, "__le", {
+	LUA_METAMETHOD_TEMPLATE(L, -1, "__le", 2, {
 		// If object overrides
-		if (!arg1.has_method("__le")) {
+		if (!args[1].has_method("__le")) {
 			return 0;
 		}
 
-		LuaState::pushVariant(inner_state, arg1.call("__le", Ref<LuaAPI>(api), arg2));
+		LuaState::pushVariant(inner_state, args[1].call("__le", Ref<LuaAPI>(api), args[2]));
 		return 1;
 	});
 
@@ -761,7 +910,7 @@ void LuaState::createObjectMetatable() {
 
 // Create metatable for any Callable and saves it at LUA_REGISTRYINDEX with name "mt_Callable"
 void LuaState::createCallableMetatable() {
-	luaL_newmetatable(L, "mt_Callable");
+	newMetatable(L, METATABLE_CALLABLE, "mt_Callable");
 
 	lua_pushstring(L, "__call");
 	lua_pushcfunction(L, luaCallableCall);
@@ -772,11 +921,11 @@ void LuaState::createCallableMetatable() {
 
 // Create metatable for any Callable and saves it at LUA_REGISTRYINDEX with name "mt_Callable"
 void LuaState::createCallableExtraMetatable() {
-	luaL_newmetatable(L, "mt_CallableExtra");
+	newMetatable(L, METATABLE_CALLABLE_EXTRA, "mt_CallableExtra");
 
 #ifdef LAPI_GDEXTENSION
-	LUA_METAMETHOD_TEMPLATE(L, -1, "__gc", {
-		Ref<RefCounted> ref = Object::cast_to<RefCounted>(arg1);
+	LUA_METAMETHOD_TEMPLATE(L, -1, "__gc", 1, {
+		Ref<RefCounted> ref = Object::cast_to<RefCounted>(args[1]);
 		if (ref != nullptr) {
 			ref->unreference();
 		}
@@ -791,3 +940,380 @@ void LuaState::createCallableExtraMetatable() {
 
 	lua_pop(L, 1);
 }
+
+// Create metatables for the upvalues held by method closures and saves them at LUA_REGISTRYINDEX with names "mt_StringName" and "mt_BuiltinMethod"
+void LuaState::createMethodMetatables() {
+	newMetatable(L, METATABLE_STRING_NAME, "mt_StringName");
+
+	lua_pushinteger(L, Variant::STRING_NAME);
+	lua_rawseti(L, -2, LAPI_METATABLE_TYPE_INDEX);
+
+	lua_pushstring(L, "__gc");
+	lua_pushcfunction(L, [](lua_State *inner_state) -> int {
+		StringName *name = (StringName *)lua_touserdata(inner_state, 1);
+		name->~StringName();
+		return 0;
+	});
+	lua_settable(L, -3);
+
+	lua_pop(L, 1);
+
+	newMetatable(L, METATABLE_BUILTIN_METHOD, "mt_BuiltinMethod");
+
+	// Not a Variant, pulling it returns nil
+	lua_pushinteger(L, Variant::VARIANT_MAX);
+	lua_rawseti(L, -2, LAPI_METATABLE_TYPE_INDEX);
+
+	lua_pushstring(L, "__gc");
+	lua_pushcfunction(L, [](lua_State *inner_state) -> int {
+		LuaBuiltinMethod *method = (LuaBuiltinMethod *)lua_touserdata(inner_state, 1);
+		method->~LuaBuiltinMethod();
+		return 0;
+	});
+	lua_settable(L, -3);
+
+	lua_pop(L, 1);
+}
+
+// Create metatable for LuaChannel and saves it at LUA_REGISTRYINDEX with name "mt_Channel".
+// The userdata is a boxed Variant, so pulling it returns the LuaChannel.
+void LuaState::createChannelMetatable() {
+	newMetatable(L, METATABLE_CHANNEL, "mt_Channel");
+
+	lua_pushstring(L, "__index");
+	lua_newtable(L);
+	lua_pushcfunction(L, LuaChannel::luaSend);
+	lua_setfield(L, -2, "send");
+	lua_pushcfunction(L, LuaChannel::luaTryRecv);
+	lua_setfield(L, -2, "try_recv");
+	lua_settable(L, -3);
+
+	lua_pushstring(L, "__gc");
+	lua_pushcfunction(L, [](lua_State *inner_state) -> int {
+		Variant *channel = (Variant *)lua_touserdata(inner_state, 1);
+		channel->~Variant();
+		return 0;
+	});
+	lua_settable(L, -3);
+
+	lua_pop(L, 1);
+}
+
+// Packed arrays are stored in userdata as the packed array itself instead of a boxed Variant.
+// The userdata shares the COW buffer with Godot, so pushing and pulling them is O(1)
+// and lua reads and writes the elements directly.
+template <typename T>
+struct PackedArrayInfo;
+
+#define PACKED_ARRAY_INFO(m_type, m_element, m_variant_type)      \
+	template <>                                                   \
+	struct PackedArrayInfo<m_type> {                              \
+		typedef m_element Element;                                \
+		static constexpr const char *metatableName = "mt_" #m_type; \
+		static constexpr LuaMetatable metatable = METATABLE_##m_variant_type; \
+		static constexpr const char *name = #m_type;              \
+		static constexpr Variant::Type type = Variant::m_variant_type; \
+	};
+
+PACKED_ARRAY_INFO(PackedByteArray, uint8_t, PACKED_BYTE_ARRAY)
+PACKED_ARRAY_INFO(PackedInt32Array, int32_t, PACKED_INT32_ARRAY)
+PACKED_ARRAY_INFO(PackedInt64Array, int64_t, PACKED_INT64_ARRAY)
+PACKED_ARRAY_INFO(PackedFloat32Array, float, PACKED_FLOAT32_ARRAY)
+PACKED_ARRAY_INFO(PackedFloat64Array, double, PACKED_FLOAT64_ARRAY)
+PACKED_ARRAY_INFO(PackedStringArray, String, PACKED_STRING_ARRAY)
+PACKED_ARRAY_INFO(PackedVector2Array, Vector2, PACKED_VECTOR2_ARRAY)
+PACKED_ARRAY_INFO(PackedVector3Array, Vector3, PACKED_VECTOR3_ARRAY)
+PACKED_ARRAY_INFO(PackedColorArray, Color, PACKED_COLOR_ARRAY)
+
+// Converts a single packed array element to and from the lua stack.
+// Numeric elements never go through a Variant.
+template <typename E>
+struct PackedElement {
+	static void push(lua_State *state, const E &value) {
+		LuaState::pushVariant(state, value);
+	}
+
+	static E get(lua_State *state, int index) {
+		return LuaState::getVariant(state, index, LuaState::getAPI(state)).operator E();
+	}
+};
+
+#define PACKED_ELEMENT_INTEGER(m_element)                         \
+	template <>                                                   \
+	struct PackedElement<m_element> {                             \
+		static void push(lua_State *state, const m_element &value) { \
+			lua_pushinteger(state, value);                        \
+		}                                                         \
+		static m_element get(lua_State *state, int index) {       \
+			return (m_element)luaL_checkinteger(state, index);    \
+		}                                                         \
+	};
+
+#define PACKED_ELEMENT_NUMBER(m_element)                          \
+	template <>                                                   \
+	struct PackedElement<m_element> {                             \
+		static void push(lua_State *state, const m_element &value) { \
+			lua_pushnumber(state, value);                         \
+		}                                                         \
+		static m_element get(lua_State *state, int index) {       \
+			return (m_element)luaL_checknumber(state, index);     \
+		}                                                         \
+	};
+
+PACKED_ELEMENT_INTEGER(uint8_t)
+PACKED_ELEMENT_INTEGER(int32_t)
+PACKED_ELEMENT_INTEGER(int64_t)
+PACKED_ELEMENT_NUMBER(float)
+PACKED_ELEMENT_NUMBER(double)
+
+template <typename T>
+static T *pushPackedArrayUserdata(lua_State *state, const T &array) {
+	T *userdata = memnew_placement(lua_newuserdata(state, sizeof(T)), T(array));
+	LuaState::setMetatable(state, PackedArrayInfo<T>::metatable);
+	return userdata;
+}
+
+// Returns the packed array held by the userdata at index, raises an error if it is not a T.
+// The metamethods can be fetched with getmetatable and called with any receiver.
+template <typename T>
+static T *checkPackedArray(lua_State *state, int index) {
+	T *array = (T *)LuaState::testUserdata(state, index, PackedArrayInfo<T>::metatable);
+	if (array == nullptr) {
+		luaL_argerror(state, index, lua_pushfstring(state, "%s expected", PackedArrayInfo<T>::name));
+	}
+	return array;
+}
+
+// The buffer of a packed array is allocated by Godot, so the memory limit never sees it.
+// Raises an error if size elements would not fit under the limit.
+template <typename T>
+static void checkPackedArraySize(lua_State *state, lua_Integer size) {
+	if (size < 0) {
+		luaL_error(state, "%s size must not be negative", PackedArrayInfo<T>::name);
+		return;
+	}
+
+	if (!LuaState::getAPI(state)->fitsMemoryLimit(size, sizeof(typename PackedArrayInfo<T>::Element))) {
+		luaL_error(state, "%s of size %f exceeds the memory limit", PackedArrayInfo<T>::name, (lua_Number)size);
+	}
+}
+
+// __index, lua indexes from 1. Non integer keys and out of range indexes return nil.
+template <typename T>
+static int luaPackedArrayIndex(lua_State *state) {
+	T *array = checkPackedArray<T>(state, 1);
+	if (lua_type(state, 2) != LUA_TNUMBER) {
+		return 0;
+	}
+
+	lua_Integer index = lua_tointeger(state, 2);
+	if (index < 1 || index > array->size()) {
+		return 0;
+	}
+
+	PackedElement<typename PackedArrayInfo<T>::Element>::push(state, array->ptr()[index - 1]);
+	return 1;
+}
+
+// __newindex, writing to #array + 1 appends.
+template <typename T>
+static int luaPackedArrayNewIndex(lua_State *state) {
+	typedef typename PackedArrayInfo<T>::Element E;
+
+	T *array = checkPackedArray<T>(state, 1);
+	lua_Integer index = luaL_checkinteger(state, 2);
+	int64_t size = array->size();
+	if (index < 1 || index > size + 1) {
+		return luaL_error(state, "index %d is out of bounds for %s of size %d", (int)index, PackedArrayInfo<T>::name, (int)size);
+	}
+
+	E value = PackedElement<E>::get(state, 3);
+	if (index == size + 1) {
+		checkPackedArraySize<T>(state, size + 1);
+		array->push_back(value);
+		return 0;
+	}
+
+	// ptrw() only copies the buffer if it is still shared with Godot.
+	array->ptrw()[index - 1] = value;
+	return 0;
+}
+
+template <typename T>
+static int luaPackedArrayLen(lua_State *state) {
+	T *array = checkPackedArray<T>(state, 1);
+	lua_pushinteger(state, array->size());
+	return 1;
+}
+
+template <typename T>
+static int luaPackedArrayToString(lua_State *state) {
+	T *array = checkPackedArray<T>(state, 1);
+	LuaState::pushVariant(state, Variant(*array).operator String());
+	return 1;
+}
+
+template <typename T>
+static int luaPackedArrayGC(lua_State *state) {
+	T *array = checkPackedArray<T>(state, 1);
+	array->~T();
+
+	// __gc can also be called by a script, without a metatable the userdata is no longer a T and is not finalized again
+	lua_pushnil(state);
+	lua_setmetatable(state, 1);
+	return 0;
+}
+
+// Constructor exposed to lua. Accepts nothing, a size or a table of elements.
+// The userdata is pushed first so the buffer is released by __gc if filling it raises an error.
+template <typename T>
+static int luaPackedArrayNew(lua_State *state) {
+	typedef typename PackedArrayInfo<T>::Element E;
+
+	switch (lua_type(state, 1)) {
+		case LUA_TNUMBER: {
+			lua_Integer size = luaL_checkinteger(state, 1);
+			checkPackedArraySize<T>(state, size);
+
+			T *array = pushPackedArrayUserdata(state, T());
+			if (array->resize(size) != OK) {
+				return luaL_error(state, "not enough memory");
+			}
+			array->fill(E());
+			return 1;
+		}
+		case LUA_TTABLE: {
+#ifndef LAPI_LUAJIT
+			lua_Integer len = lua_rawlen(state, 1);
+#else
+			lua_Integer len = lua_objlen(state, 1);
+#endif
+			checkPackedArraySize<T>(state, len);
+
+			T *array = pushPackedArrayUserdata(state, T());
+			if (array->resize(len) != OK) {
+				return luaL_error(state, "not enough memory");
+			}
+			E *ptrw = array->ptrw();
+			for (lua_Integer i = 0; i < len; i++) {
+				lua_rawgeti(state, 1, i + 1);
+				ptrw[i] = PackedElement<E>::get(state, -1);
+				lua_pop(state, 1);
+			}
+			return 1;
+		}
+		default:
+			pushPackedArrayUserdata(state, T());
+			return 1;
+	}
+}
+
+template <typename T>
+static void createPackedArrayMetatable(lua_State *L) {
+	LuaState::newMetatable(L, PackedArrayInfo<T>::metatable, PackedArrayInfo<T>::metatableName);
+
+	lua_pushinteger(L, PackedArrayInfo<T>::type);
+	lua_rawseti(L, -2, LAPI_METATABLE_TYPE_INDEX);
+
+	lua_pushstring(L, "__index");
+	lua_pushcfunction(L, luaPackedArrayIndex<T>);
+	lua_settable(L, -3);
+
+	lua_pushstring(L, "__newindex");
+	lua_pushcfunction(L, luaPackedArrayNewIndex<T>);
+	lua_settable(L, -3);
+
+	lua_pushstring(L, "__len");
+	lua_pushcfunction(L, luaPackedArrayLen<T>);
+	lua_settable(L, -3);
+
+	lua_pushstring(L, "__tostring");
+	lua_pushcfunction(L, luaPackedArrayToString<T>);
+	lua_settable(L, -3);
+
+	lua_pushstring(L, "__gc");
+	lua_pushcfunction(L, luaPackedArrayGC<T>);
+	lua_settable(L, -3);
+
+	lua_pop(L, 1);
+
+	// Expose the constructor
+	lua_pushcfunction(L, luaPackedArrayNew<T>);
+	lua_setglobal(L, PackedArrayInfo<T>::name);
+}
+
+// Create metatables for all packed array types and saves them at LUA_REGISTRYINDEX with name "mt_<PackedArrayType>"
+void LuaState::createPackedArrayMetatables() {
+	createPackedArrayMetatable<PackedByteArray>(L);
+	createPackedArrayMetatable<PackedInt32Array>(L);
+	createPackedArrayMetatable<PackedInt64Array>(L);
+	createPackedArrayMetatable<PackedFloat32Array>(L);
+	createPackedArrayMetatable<PackedFloat64Array>(L);
+	createPackedArrayMetatable<PackedStringArray>(L);
+	createPackedArrayMetatable<PackedVector2Array>(L);
+	createPackedArrayMetatable<PackedVector3Array>(L);
+	createPackedArrayMetatable<PackedColorArray>(L);
+}
+
+// Pushes a packed array as a userdata view sharing the Variant's buffer
+void LuaState::pushPackedArray(lua_State *state, const Variant &var) {
+	switch (var.get_type()) {
+		case Variant::Type::PACKED_BYTE_ARRAY:
+			pushPackedArrayUserdata(state, var.operator PackedByteArray());
+			break;
+		case Variant::Type::PACKED_INT32_ARRAY:
+			pushPackedArrayUserdata(state, var.operator PackedInt32Array());
+			break;
+		case Variant::Type::PACKED_INT64_ARRAY:
+			pushPackedArrayUserdata(state, var.operator PackedInt64Array());
+			break;
+		case Variant::Type::PACKED_FLOAT32_ARRAY:
+			pushPackedArrayUserdata(state, var.operator PackedFloat32Array());
+			break;
+		case Variant::Type::PACKED_FLOAT64_ARRAY:
+			pushPackedArrayUserdata(state, var.operator PackedFloat64Array());
+			break;
+		case Variant::Type::PACKED_STRING_ARRAY:
+			pushPackedArrayUserdata(state, var.operator PackedStringArray());
+			break;
+		case Variant::Type::PACKED_VECTOR2_ARRAY:
+			pushPackedArrayUserdata(state, var.operator PackedVector2Array());
+			break;
+		case Variant::Type::PACKED_VECTOR3_ARRAY:
+			pushPackedArrayUserdata(state, var.operator PackedVector3Array());
+			break;
+		case Variant::Type::PACKED_COLOR_ARRAY:
+			pushPackedArrayUserdata(state, var.operator PackedColorArray());
+			break;
+		default:
+			lua_pushnil(state);
+			break;
+	}
+}
+
+// Returns the packed array held by the userdata at index. Does not copy the buffer.
+Variant LuaState::getPackedArray(lua_State *state, int index, Variant::Type type) {
+	void *userdata = lua_touserdata(state, index);
+	switch (type) {
+		case Variant::Type::PACKED_BYTE_ARRAY:
+			return *(PackedByteArray *)userdata;
+		case Variant::Type::PACKED_INT32_ARRAY:
+			return *(PackedInt32Array *)userdata;
+		case Variant::Type::PACKED_INT64_ARRAY:
+			return *(PackedInt64Array *)userdata;
+		case Variant::Type::PACKED_FLOAT32_ARRAY:
+			return *(PackedFloat32Array *)userdata;
+		case Variant::Type::PACKED_FLOAT64_ARRAY:
+			return *(PackedFloat64Array *)userdata;
+		case Variant::Type::PACKED_STRING_ARRAY:
+			return *(PackedStringArray *)userdata;
+		case Variant::Type::PACKED_VECTOR2_ARRAY:
+			return *(PackedVector2Array *)userdata;
+		case Variant::Type::PACKED_VECTOR3_ARRAY:
+			return *(PackedVector3Array *)userdata;
+		case Variant::Type::PACKED_COLOR_ARRAY:
+			return *(PackedColorArray *)userdata;
+		default:
+			return Variant();
+	}
+}
@@ -10,5 +10,9 @@ using namespace godot;
 inline void print_line(const Variant &v) {
 	UtilityFunctions::print(v);
 }
+
+inline void print_error(const Variant &v) {
+	UtilityFunctions::printerr(v);
+}
 #endif
 #endif